@@ -47,7 +47,7 @@
 /** ARP table entry contents */
 struct arpEntry
 {
-    uchar   ipAddr[IP_ADDR_LEN];
+    ipaddr  ipAddr;
     uchar   hwAddr[ETH_ADDR_LEN];
     ushort  osFlags;
     ushort  timeout;
@@ -82,6 +82,22 @@ struct arpPkt
     uchar addrs[1]; 
 };
 
+/** ARP header accessors, in host byte order */
+NET_INLINE ushort arpGetHwType(const struct arpPkt *arp)
+{
+    return ntohs(arp->hwType);
+}
+
+NET_INLINE ushort arpGetPrType(const struct arpPkt *arp)
+{
+    return ntohs(arp->prType);
+}
+
+NET_INLINE ushort arpGetOp(const struct arpPkt *arp)
+{
+    return ntohs(arp->op);
+}
+
 /** ARP information struct - includes the ARP table*/
 struct arpInfo
 {
@@ -101,15 +117,15 @@ syscall arpInit(void);
 void arpWatcher(void);
 
 /** ARP request, reply, and receive **/
-syscall arpSendRequest(uchar *);
+syscall arpSendRequest(ipaddr);
 syscall arpSendReply(struct arpPkt *);
 syscall arpRecv(struct arpPkt *);
 
 /** Resolving mac address from an IP **/
-syscall arpResolve(uchar *ipAddr, uchar *hwAddr);
+syscall arpResolve(ipaddr ipAddr, uchar *hwAddr);
 
 /** ARP Table manipulation **/
-syscall arpAddEntry(uchar *ipAddr, uchar *hwAddr);
-int arpFindEntry(uchar *ipAddr);
+syscall arpAddEntry(ipaddr ipAddr, uchar *hwAddr);
+int arpFindEntry(ipaddr ipAddr);
 
 #endif                          /* _ARP_H_ */
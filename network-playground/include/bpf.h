@@ -0,0 +1,99 @@
+/**
+ * @file bpf.h
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#ifndef _BPF_H_
+#define _BPF_H_
+
+#include <kernel.h>
+
+/* Program limits */
+#define BPF_MAXINSNS    64          /** Instructions in a program */
+#define BPF_MEMWORDS    16          /** Scratch memory words */
+#define BPF_USES_MEM    0x0001      /** Program loads scratch memory */
+
+/* Instruction classes, encoded as in classic BPF so tcpdump -ddd output */
+/* loads unchanged                                                       */
+#define BPF_CLASS(code) ((code) & 0x07)
+#define BPF_LD          0x00
+#define BPF_LDX         0x01
+#define BPF_ST          0x02
+#define BPF_STX         0x03
+#define BPF_ALU         0x04
+#define BPF_JMP         0x05
+#define BPF_RET         0x06
+#define BPF_MISC        0x07
+
+/* Load sizes */
+#define BPF_SIZE(code)  ((code) & 0x18)
+#define BPF_W           0x00
+#define BPF_H           0x08
+#define BPF_B           0x10
+
+/* Load modes */
+#define BPF_MODE(code)  ((code) & 0xe0)
+#define BPF_IMM         0x00
+#define BPF_ABS         0x20
+#define BPF_IND         0x40
+#define BPF_MEM         0x60
+#define BPF_LEN         0x80
+#define BPF_MSH         0xa0
+
+/* ALU and jump operations */
+#define BPF_OP(code)    ((code) & 0xf0)
+#define BPF_ADD         0x00
+#define BPF_SUB         0x10
+#define BPF_MUL         0x20
+#define BPF_DIV         0x30
+#define BPF_OR          0x40
+#define BPF_AND         0x50
+#define BPF_LSH         0x60
+#define BPF_RSH         0x70
+#define BPF_NEG         0x80
+#define BPF_JA          0x00
+#define BPF_JEQ         0x10
+#define BPF_JGT         0x20
+#define BPF_JGE         0x30
+#define BPF_JSET        0x40
+
+/* Operand sources */
+#define BPF_SRC(code)   ((code) & 0x08)
+#define BPF_K           0x00
+#define BPF_X           0x08
+
+/* Return values */
+#define BPF_RVAL(code)  ((code) & 0x18)
+#define BPF_A           0x10
+
+/* Register transfers */
+#define BPF_MISCOP(code) ((code) & 0xf8)
+#define BPF_TAX         0x00
+#define BPF_TXA         0x80
+
+/** A BPF instruction */
+struct bpfInsn
+{
+    ushort  code;                   /** Class, size, mode and operation */
+    uchar   jt;                     /** Instructions skipped if true */
+    uchar   jf;                     /** Instructions skipped if false */
+    ulong   k;                      /** Constant operand */
+};
+
+/** A verified BPF program */
+struct bpfProg
+{
+    ushort  len;                    /** Instructions in the program */
+    ushort  flags;                  /** BPF_USES_MEM */
+    struct bpfInsn insns[BPF_MAXINSNS];
+};
+
+/** BPF functions */
+syscall bpfVerify(const struct bpfInsn *insns, int len);
+syscall bpfLoad(struct bpfProg *prog, const struct bpfInsn *insns, int len);
+ulong bpfRun(const struct bpfProg *prog, const uchar *pkt, ulong len);
+
+#endif                          /* _BPF_H_ */
@@ -0,0 +1,96 @@
+/**
+ * @file capture.h
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <network.h>
+#include <ether.h>
+#include <bpf.h>
+
+/* Capture ring defines */
+#define CAPTURE_RING_LEN    (64 * 1024) /** Ring size in bytes, power of 2 */
+#define CAPTURE_SNAPLEN     96      /** Bytes kept per frame by default */
+#define CAPTURE_SNAPLEN_MAX ETH_MAX_PKT_LEN /** Most bytes kept per frame */
+#define CAPTURE_IDLE        2000    /** ms of empty ring that ends a dump */
+
+/* Capture record types */
+#define CAPTURE_PAD         0       /** Fills the ring up to its end */
+#define CAPTURE_RX          1       /** Frame read by netDaemon */
+#define CAPTURE_TX          2       /** Frame sent by netFrameSend */
+
+/* libpcap file format */
+#define PCAP_MAGIC          0xA1B2C3D4  /** Written in host byte order */
+#define PCAP_VERSION_MAJOR  2
+#define PCAP_VERSION_MINOR  4
+#define PCAP_LINKTYPE_ETHERNET 1
+
+/** A record in the capture ring, followed by the frame's first bytes */
+struct captureRecord
+{
+    ushort  len;                    /** Record length, word aligned */
+    uchar   ready;                  /** Set once the frame is copied in */
+    uchar   type;                   /** CAPTURE_* */
+    ulong   sec;                    /** Seconds since boot */
+    ulong   usec;                   /** and microseconds */
+    ushort  capLen;                 /** Bytes of the frame kept */
+    ushort  origLen;                /** Length of the frame */
+    uchar   data[1];                /** The frame's first capLen bytes */
+};
+
+#define CAPTURE_HDR_LEN     16      /** Bytes before data in a record */
+
+/** libpcap global header */
+struct pcapHdr
+{
+    ulong   magic;
+    ushort  versionMajor;
+    ushort  versionMinor;
+    long    thiszone;
+    ulong   sigfigs;
+    ulong   snaplen;
+    ulong   linktype;
+};
+
+/** libpcap record header */
+struct pcapRecHdr
+{
+    ulong   sec;
+    ulong   usec;
+    ulong   inclLen;
+    ulong   origLen;
+};
+
+/** Packet capture information struct */
+struct captureInfo
+{
+    bool        on;                 /** Frames are being captured */
+    ushort      snaplen;            /** Bytes kept per frame */
+    uchar       *ring;              /** CAPTURE_RING_LEN bytes */
+    ulong       head;               /** Bytes ever reserved */
+    ulong       tail;               /** Bytes ever consumed */
+    ulong       frames;             /** Frames captured */
+    ulong       drops;              /** Frames that found the ring full */
+    ulong       dumped;             /** Frames written out as pcap */
+    ulong       filtered;           /** Frames the filter rejected */
+    struct bpfProg *filter;         /** Filter run on each frame, or NULL */
+    struct bpfProg progs[2];        /** The filter and the one before it */
+};
+
+extern struct captureInfo capture;
+
+/** Capture control */
+syscall captureStart(int snaplen);
+syscall captureStop(void);
+syscall captureFilter(const struct bpfInsn *insns, int len);
+int captureDump(int dev);
+
+/** Capture hook, for the receive and transmit paths */
+syscall captureFrame(const void *frame, int len, int type);
+
+#endif                          /* _CAPTURE_H_ */
@@ -0,0 +1,49 @@
+/**
+ * @file dcache.h
+ *
+ * $Id:$
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#ifndef _DCACHE_H_
+#define _DCACHE_H_
+
+#include <kernel.h>
+#include <mips.h>
+#include <ether.h>
+
+/* How packet buffers are kept coherent with the DMA engine */
+#define DCACHE_UNCACHED     0   /** Frames read and built through KSEG1 */
+#define DCACHE_PERBUF       1   /** Whole buffer maintained per frame */
+#define DCACHE_BATCHED      2   /** Occupied lines maintained per frame */
+
+/** dcacheKseg1 - uncached alias of a KSEG0 address
+ *  @param p address
+ */
+#define dcacheKseg1(p) ((void *) ((ulong) (p) | KSEG1_BASE))
+
+/** D-cache maintenance information struct */
+struct dcacheInfo
+{
+    int             mode;           /** DCACHE_UNCACHED, _PERBUF or _BATCHED */
+    ulong           rxFrames;       /** Received buffers invalidated */
+    ulong           rxLines;        /** Lines touched for them */
+    ulong           txFrames;       /** Sent frames written back */
+    ulong           txLines;        /** Lines written back for them */
+};
+
+extern struct dcacheInfo dcache;
+
+/** D-cache maintenance functions */
+syscall dcacheMode(int mode);
+ulong dcacheInvalidate(void *addr, ulong len);
+ulong dcacheWriteback(void *addr, ulong len);
+ulong dcacheRxInit(struct ether *ethptr);
+int dcacheRxRefill(struct ether *ethptr, ulong first);
+ulong dcacheRxReturn(struct ethPktBuffer *pkt);
+void *dcacheRxFrame(struct ethPktBuffer *pkt);
+ulong dcacheTxFrame(struct ethPktBuffer *pkt, ulong len);
+
+#endif                          /* _DCACHE_H_ */
@@ -0,0 +1,86 @@
+/**
+ * @file dhcp.h
+ *
+ * $Id:$
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/10/2016       */
+
+#ifndef _DHCP_H_
+#define _DHCP_H_
+
+#include <network.h>
+#include <ether.h>
+
+/* DHCP ports */
+#define DHCP_SERVER_PORT    67
+#define DHCP_CLIENT_PORT    68
+
+/* DHCP message sizes */
+#define DHCP_HDR_LEN        236     /** Fixed part, up to the options */
+#define DHCP_OPTS_LEN       64      /** Options we send, cookie included */
+#define DHCP_PKT_LEN        (DHCP_HDR_LEN + DHCP_OPTS_LEN)
+#define DHCP_RECV_LEN       NET_CTL_LEN /** Largest message we take */
+#define DHCP_HTYPE_ETHER    1
+#define DHCP_FLAG_BROADCAST 0x8000  /** Ask the server to broadcast replies */
+
+/* Client states (RFC 2131, figure 5) */
+#define DHCP_INIT           0
+#define DHCP_INIT_REBOOT    1
+#define DHCP_SELECTING      2
+#define DHCP_REQUESTING     3
+#define DHCP_BOUND          4
+#define DHCP_RENEWING       5
+#define DHCP_REBINDING      6
+
+/* Retransmission, in ms */
+#define DHCP_RETRY_FIRST    4000    /** First retransmit, doubled after */
+#define DHCP_RETRY_MAX      64000
+#define DHCP_TRIES          4       /** Sends before a state gives up */
+#define DHCP_RENEW_MIN      60      /** Seconds between RENEWING retries */
+
+/* Client flags */
+#define DHCP_FLAG_RENEW     0x01    /** Renew now, from the shell */
+
+/* NVRAM variables holding the last lease */
+#define DHCP_NVRAM_IPADDR   "dhcp_ipaddr"
+#define DHCP_NVRAM_NETMASK  "dhcp_netmask"
+#define DHCP_NVRAM_GATEWAY  "dhcp_gateway"
+#define DHCP_NVRAM_SERVER   "dhcp_server"
+
+/** Configuration handed out by a DHCP server */
+struct dhcpLease
+{
+    ipaddr  addr;                   /** Our address (yiaddr) */
+    ipaddr  server;                 /** Server identifier */
+    ipaddr  netmask;                /** Subnet mask, 0 if not given */
+    ipaddr  gateway;                /** First router, 0 if not given */
+    ulong   leaseTime;              /** Lease length in seconds */
+};
+
+/** DHCP client information struct */
+struct dhcpInfo
+{
+    int                 cId;        /** DHCP client process id */
+    semaphore           sema;       /** Client information semaphore */
+    uchar               state;      /** DHCP_INIT ... DHCP_REBINDING */
+    uchar               flags;      /** DHCP_FLAG_* */
+    ulong               xid;        /** Transaction id of the exchange */
+    struct dhcpLease    lease;      /** Lease in use or on offer */
+    ipaddr              cached;     /** Address from NVRAM, 0 if none */
+    ulong               boundAt;    /** clocktime the lease began */
+    ulong               t1;         /** clocktime to start renewing */
+    ulong               t2;         /** clocktime to start rebinding */
+    ulong               expires;    /** clocktime the lease runs out */
+    ulong               startMs;    /** netTime the client started */
+    ulong               bootMs;     /** ms from start to first bind */
+};
+
+extern struct dhcpInfo dhcp;
+
+/** DHCP client initialization and process */
+syscall dhcpInit(void);
+void dhcpClient(void);
+
+#endif                          /* _DHCP_H_ */
@@ -157,6 +157,49 @@ struct ether
 
 extern struct ether ethertab[];
 
+/** Interrupt-then-poll receive state, see etherPoll.c */
+struct etherPollInfo
+{
+    struct ether *ethptr;       /**< Device being polled, NULL if none  */
+    bool masked;                /**< Rx interrupts masked, polling      */
+    int credit;                 /**< Frames read since the last harvest */
+    ulong irqs;                 /**< Rx interrupts taken                */
+    ulong irqFrames;            /**< Frames harvested by interrupts     */
+    ulong polls;                /**< Harvests made by etherPoll         */
+    ulong polledFrames;         /**< Frames harvested by etherPoll      */
+    ulong rearms;               /**< Times Rx interrupts were unmasked  */
+};
+
+extern struct etherPollInfo ethPoll;
+
+/* Transmit completion batching, see etherWriteBuf.c */
+#define ETH_TX_IOC_EVERY    16  /**< Frames per completion interrupt    */
+#define ETH_TX_IOC_SLACK    32  /**< Free descriptors that force IOC    */
+
+/** Transmit completion state for frames sent with etherWriteBuf */
+struct etherTxInfo
+{
+    ulong sinceIoc;             /**< Frames posted since the last IOC   */
+    ulong posted;               /**< Frames posted by etherWriteBuf     */
+    ulong iocs;                 /**< Frames posted with IOC             */
+    ulong reclaims;             /**< etherTxReclaim calls that freed    */
+    ulong reclaimed;            /**< Buffers freed by etherTxReclaim    */
+    ulong limit;                /**< Frames callers keep in flight      */
+    void (*txDone)(void);       /**< Called after Tx interrupts, or NULL */
+};
+
+extern struct etherTxInfo ethTx;
+
+/** Spare receive buffers added by etherReserveBufs, see etherReadBuf.c */
+struct etherSpareInfo
+{
+    void *mem;                  /**< Block holding the spares, or NULL  */
+    ulong size;                 /**< Bytes in mem                       */
+    int count;                  /**< Buffers carved from mem            */
+};
+
+extern struct etherSpareInfo ethSpare;
+
 /* Driver functions */
 devcall etherInit(device *);
 devcall etherOpen(device *);
@@ -164,10 +207,25 @@ devcall etherClose(device *);
 devcall etherRead(device *, void *, ulong);
 devcall etherWrite(device *, void *, ulong);
 devcall etherControl(device *, int, long, long);
+devcall etherReadBuf(device *, struct ethPktBuffer **);
+devcall etherReturnBuf(device *, struct ethPktBuffer *);
+devcall etherRxAlign(device *, int);
+devcall etherReserveBufs(device *, int);
+devcall etherCloseBufs(device *);
+struct ethPktBuffer *etherGetBuf(device *, int);
+devcall etherWriteBuf(device *, struct ethPktBuffer *, ulong);
+int etherTxReclaim(device *);
+devcall etherTxLimit(device *, int);
+int etherTxSpace(device *);
 interrupt etherInterrupt(void);
+devcall etherPollInit(device *);
+interrupt etherPollInterrupt(void);
+int etherPoll(device *, int);
 
 int colon2mac(char *, uchar *);
 int allocRxBuffer(struct ether *, int);
+void rxPackets(struct ether *, struct bcm4713 *);
+void txPackets(struct ether *, struct bcm4713 *);
 int waitOnBit(volatile ulong *, ulong, const int, int);
 
 /* Network helper functions */
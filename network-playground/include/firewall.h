@@ -0,0 +1,101 @@
+/**
+ * @file firewall.h
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#ifndef _FIREWALL_H_
+#define _FIREWALL_H_
+
+#include <network.h>
+
+/* Firewall defines */
+#define FW_RULES            1024    /** Most rules; 32 bitmap words at most */
+#define FW_WORDS            (FW_RULES / 32) /** Bitmap words for FW_RULES */
+#define FW_PORT_MAX         0xFFFF
+
+/* Rule actions */
+#define FW_ACCEPT           0
+#define FW_DROP             1
+
+/* Packet fields rules match on, each compiled as one dimension */
+#define FW_DIM_SRC          0       /** Source address */
+#define FW_DIM_DST          1       /** Destination address */
+#define FW_DIM_PROTO        2       /** IPv4 protocol */
+#define FW_DIM_SPORT        3       /** TCP or UDP source port */
+#define FW_DIM_DPORT        4       /** TCP or UDP destination port, or
+                                        ICMP type */
+#define FW_DIMS             5
+
+/** A firewall rule; the first rule a packet matches decides its fate */
+struct fwRule
+{
+    ipaddr  src;                    /** Source prefix */
+    ipaddr  srcMask;                /** Its netmask, contiguous */
+    ipaddr  dst;                    /** Destination prefix */
+    ipaddr  dstMask;                /** Its netmask, contiguous */
+    uchar   proto;                  /** IPv4_PROTO_*, or 0 for any */
+    uchar   action;                 /** FW_ACCEPT or FW_DROP */
+    ushort  sportLo;                /** Source ports, TCP and UDP only */
+    ushort  sportHi;
+    ushort  dportLo;                /** Destination ports, or ICMP types */
+    ushort  dportHi;
+    ulong   packets;                /** Packets this rule decided */
+    ulong   bytes;                  /** and their IPv4 lengths */
+};
+
+/**
+ * One field of the compiled rules. Its values are cut into elementary
+ * intervals at every rule's range ends; every value in an interval
+ * matches the same rules, marked in the interval's bitmap.
+ */
+struct fwDim
+{
+    int     count;                  /** Elementary intervals */
+    ulong   *starts;                /** First value of each, ascending */
+    ulong   *aggs;                  /** Bit w set if bitmap word w is nonzero */
+    ulong   *maps;                  /** count bitmaps of words words each */
+};
+
+/** A rule set compiled for bitmap intersection, in one allocation */
+struct fwTable
+{
+    int     count;                  /** Rules */
+    int     words;                  /** Words in each bitmap */
+    ulong   size;                   /** Bytes allocated */
+    struct fwRule *rules;           /** Rules, in match order */
+    struct fwDim dims[FW_DIMS];     /** FW_DIM_* */
+};
+
+/** Firewall information struct */
+struct fwInfo
+{
+    struct fwTable *table;          /** Compiled rules, NULL if none */
+    uchar       policy;             /** Action when no rule matches */
+    ulong       missed;             /** Packets no rule matched */
+    ulong       dropped;            /** Packets dropped, by rule or policy */
+    semaphore   lock;               /** Serializes rule changes */
+};
+
+extern struct fwInfo fw;
+
+/** Firewall initialization */
+syscall fwInit(void);
+
+/** Rule set changes, each compiled before it takes effect */
+syscall fwAdd(const struct fwRule *rule, int pos);
+syscall fwRemove(int pos);
+syscall fwLoad(const struct fwRule *rules, int count);
+syscall fwPolicy(uchar action);
+
+/** Receive path, used by ipRecv */
+int fwMatch(const struct ipgram *pkt);
+
+/** Lookups on a private table, without the counters (used by netbench) */
+void fwKeys(const struct ipgram *pkt, ulong *keys);
+int fwLookup(const struct fwTable *t, const ulong *keys);
+syscall fwCompile(const struct fwRule *rules, int count, struct fwTable **table);
+
+#endif                          /* _FIREWALL_H_ */
@@ -16,11 +16,27 @@
 /* ICMP message Types */
 #define ICMP_ECHO_RQST_T 0x08
 #define ICMP_ECHO_RPLY_T 0x00
+#define ICMP_UNREACH_T   0x03
+#define ICMP_TIMEX_T     0x0B
+#define ICMP_PARAMPROB_T 0x0C
 
 /* ICMP message codes */
 #define ICMP_ECHO_RQST_C  0
 #define ICMP_ECHO_RPLY_C  0
 
+/* ICMP destination unreachable codes */
+#define ICMP_NET_UNREACH_C   0
+#define ICMP_HOST_UNREACH_C  1
+#define ICMP_PROTO_UNREACH_C 2
+#define ICMP_PORT_UNREACH_C  3
+
+/* ICMP time exceeded codes */
+#define ICMP_TTL_EXCEEDED_C  0
+#define ICMP_FRAG_EXCEEDED_C 1
+
+/* ICMP parameter problem codes */
+#define ICMP_PARAM_PTR_C     0
+
 /* ICMP header length */
 #define ICMP_HEADER_LEN 8
 
@@ -33,6 +49,21 @@
 #define ICMP_ENTRY_INVALID 0x00
 #define ICMP_RQST_SENT     0x01
 #define ICMP_GOT_RPLY      0x02
+#define ICMP_PROBES_SENT   0x03   /* Entry is tracing with TTL probes */
+
+/* Probes that may be outstanding per ICMP table entry */
+#define ICMP_MAX_PROBES       3
+
+/** Outstanding TTL-limited echo probe (used by traceroute) */
+struct icmpProbe
+{
+    uchar flag;                     /** ICMP_RQST_SENT or ICMP_GOT_RPLY */
+    uchar type;                     /** ICMP type of the answer */
+    ushort seqNum;                  /** Sequence number of the probe */
+    ulong sentTime;                 /** Time (ms) the probe was sent */
+    ulong rtt;                      /** Round trip time (ms) */
+    ipaddr ipAddr;                  /** Address that answered the probe */
+};
 
 struct icmpTblEntry
 {
@@ -43,11 +74,30 @@ struct icmpTblEntry
     ushort recvdBytes;
     ulong recvdTime;
     ushort seqNum;
-    uchar ipAddr[IPv4_ADDR_LEN];
+    ipaddr ipAddr;
+    struct icmpProbe probes[ICMP_MAX_PROBES];
 };
 
 extern struct icmpTblEntry icmpTbl[ICMP_TBL_LEN];
 
+/* ICMP error messages quote the IP header plus 8 bytes of its data */
+#define ICMP_ERR_QUOTE_LEN  8
+
+/* ICMP error token bucket: burst size and milliseconds per token */
+#define ICMP_ERR_BURST     10
+#define ICMP_ERR_INTERVAL 100
+
+/** ICMP error rate limiter (token bucket) */
+struct icmpErrLimit
+{
+    ulong tokens;           /** Error messages we may send right now */
+    ulong lastRefill;       /** Time (ms) the bucket was last refilled */
+    ulong sent;             /** Error messages sent */
+    ulong suppressed;       /** Error messages dropped by the limiter */
+};
+
+extern struct icmpErrLimit icmpErr;
+
 /*
  * ICMP HEADER
  *
@@ -71,6 +121,17 @@ struct icmpPkt
     uchar data[1]; 
 };
 
+/** ICMP header accessors, in host byte order */
+NET_INLINE ushort icmpGetId(const struct icmpPkt *icmp)
+{
+    return ntohs(icmp->id);
+}
+
+NET_INLINE ushort icmpGetSeqNum(const struct icmpPkt *icmp)
+{
+    return ntohs(icmp->seqNum);
+}
+
 /** ICMP table initializations */
 syscall icmpInit(void);
 
@@ -83,12 +144,21 @@ syscall icmpHandleRequest(struct ipgram *, uchar *);
 /** Handle an ICMP echo reply (used by netDaemon) **/
 syscall icmpHandleReply(struct ipgram *);
 
+/** Handle an ICMP time exceeded or unreachable error (used by netDaemon) **/
+syscall icmpHandleError(struct ipgram *);
+
+/** Send an ICMP error about a received packet (used by netDaemon) **/
+syscall icmpSendError(struct ipgram *, uchar type, uchar code, uchar param);
+
 /** Send an ICMP echo request (used by ping) */
-syscall icmpSendRequest(uchar *ipAddr, 
+syscall icmpSendRequest(ipaddr ipAddr, 
 //                        uchar *hwAddr, 
                         ushort id,
                         ushort seqNum);
 
+/** Send a TTL-limited ICMP echo probe without waiting (used by traceroute) */
+syscall icmpSendProbe(ipaddr ipAddr, ushort id, ushort seqNum, uchar ttl);
+
 /** ICMP Helper functions */
 #define LITTLE_ENDIAN 0
 #define BIG_ENDIAN 1
@@ -163,11 +163,18 @@
 #define CONFIG1_DA     7
 #define CONFIG1_MASK   7       /**< value mask                           */
 
+/**
+ * Data cache line size in bytes, as read from the Config1 DL field
+ */
+#define D_CACHE_LINE  16
+
 /**
  * Cache functions 
  */
 #define INDEX_STORE_TAG_I  0x8  /**< invalidate instruction cache tag    */
 #define FILL_I_CACHE       0x14 /**< fill instruction cache              */
 #define INDEX_STORE_TAG_D  0x9  /**< invalidate data cache tag           */
+#define HIT_INVALIDATE_D   0x11 /**< invalidate data cache line at addr  */
+#define HIT_WRITEBACK_INV_D 0x15 /**< write back and invalidate at addr  */
 
 #endif	/* _MIPS_H */
@@ -12,12 +12,59 @@
 
 #include <kernel.h>
 
-/* Little Endian converters */
-# define htons(x) ((((x)>>8) &0xff) | (((x) & 0xff)<<8))
-# define ntohs(x) htons(x)
-# define htonl(x) ((((x)& 0xff)<<24) | (((x)>>24) & 0xff) | \
-                           (((x) & 0xff0000)>>8) | (((x) & 0xff00)<<8))
-# define ntohl(x) htonl(x)
+/* Small helpers that must be inlined even at -O0 */
+#define NET_INLINE static inline __attribute__((always_inline))
+
+/* Target byte order, selected at build time (mips vs. mipsel) */
+#if defined(__MIPSEB__) || defined(__MIPSEB)
+#   define NET_BIG_ENDIAN 1
+#endif
+
+/* Byte swaps of constants, folded by the compiler */
+#define SWAP16_CONST(x) ((ushort) ((((x) >> 8) & 0xff) | (((x) & 0xff) << 8)))
+#define SWAP32_CONST(x) ((ulong) ((((x) & 0xff) << 24) | (((x) >> 24) & 0xff) | \
+                         (((x) & 0xff0000) >> 8) | (((x) & 0xff00) << 8)))
+
+/**
+ * Swap the bytes of a halfword, with wsbh on MIPS32r2 and later
+ */
+NET_INLINE ushort netSwap16(ushort x)
+{
+#if defined(__mips_isa_rev) && __mips_isa_rev >= 2
+    ulong r;
+    
+    asm ("wsbh %0, %1" : "=r" (r) : "r" (x));
+    return (ushort) r;
+#else
+    return (ushort) ((x >> 8) | (x << 8));
+#endif
+}
+
+/**
+ * Swap the bytes of a word, with wsbh/rotr on MIPS32r2 and later
+ */
+NET_INLINE ulong netSwap32(ulong x)
+{
+#if defined(__mips_isa_rev) && __mips_isa_rev >= 2
+    ulong r;
+    
+    asm ("wsbh %0, %1\n\trotr %0, %0, 16" : "=r" (r) : "r" (x));
+    return r;
+#else
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x & 0xff00) << 8) | (x << 24);
+#endif
+}
+
+/* Host/network byte order converters. Each evaluates its argument once */
+#ifdef NET_BIG_ENDIAN
+#   define htons(x) ((ushort) (x))
+#   define htonl(x) ((ulong) (x))
+#else
+#   define htons(x) (__builtin_constant_p(x) ? SWAP16_CONST(x) : netSwap16(x))
+#   define htonl(x) (__builtin_constant_p(x) ? SWAP32_CONST(x) : netSwap32(x))
+#endif
+#define ntohs(x) htons(x)
+#define ntohl(x) htonl(x)
 
 
 /* Networking Constants */
@@ -26,13 +73,92 @@
 #endif
 
 #define IP_ADDR_LEN  4          /* IP address length        */
+
+/* An IPv4 address held in one 32-bit word, in network byte order, so   */
+/* its bytes in memory are the same as on the wire                      */
+typedef ulong ipaddr;
+
+#define IPv4_ADDR_ANY   0x00000000UL    /* 0.0.0.0                  */
+#define IPv4_ADDR_BCAST 0xFFFFFFFFUL    /* 255.255.255.255          */
+
+/* Byte i (0 = first on the wire) of an ipaddr, and an ipaddr loaded */
+/* from a byte array that may be unaligned                            */
+#ifdef NET_BIG_ENDIAN
+#   define IP_BYTE(a, i)   ((uchar) ((a) >> (24 - (i) * 8)))
+#   define IP_LOAD(p)      (((ipaddr) (p)[0] << 24) | ((ipaddr) (p)[1] << 16) | \
+                            ((ipaddr) (p)[2] << 8) | (ipaddr) (p)[3])
+#else
+#   define IP_BYTE(a, i)   ((uchar) ((a) >> ((i) * 8)))
+#   define IP_LOAD(p)      ((ipaddr) (p)[0] | ((ipaddr) (p)[1] << 8) | \
+                            ((ipaddr) (p)[2] << 16) | ((ipaddr) (p)[3] << 24))
+#endif
+
+/* Store an ipaddr to a byte array that may be unaligned */
+#define IP_STORE(p, a)  do { (p)[0] = IP_BYTE(a, 0); (p)[1] = IP_BYTE(a, 1); \
+                             (p)[2] = IP_BYTE(a, 2); (p)[3] = IP_BYTE(a, 3); \
+                        } while (0)
+
 #define PKTSZ        ETH_HEADER_LEN + ETH_MTU   /* Maximum packet size      */
 
+/* Frame buffers start NET_IP_ALIGN bytes into a word aligned buffer, so   */
+/* the IPv4 header after the 14 byte Ethernet header is word aligned too  */
+#define NET_IP_ALIGN 2
+#define NET_BUF_WORDS ((NET_IP_ALIGN + PKTSZ + 3) / 4) /* Frame buffer size */
+
+/* Payload of a frame from netFrameGet, and the IPv4 payload behind a     */
+/* header without options                                                 */
+#define netFramePayload(f)  ((f)->data + ETH_HEADER_LEN)
+#define ipFramePayload(f)   (netFramePayload(f) + IPv4_HDR_LEN)
+
+/* Network buffer pools, made with bfpalloc by netInit                    */
+#define NET_POOL_RX     0           /* Received frames left unaligned     */
+#define NET_POOL_TX     1           /* Packets built before ipWrite       */
+#define NET_POOL_CTL    2           /* ARP, ICMP errors, resets, DHCP     */
+#define NET_POOLS       3
+#define NET_FRAME_LEN   (NET_BUF_WORDS * 4)
+#define NET_CTL_LEN     576         /* Datagram every host must accept    */
+#define NET_RX_BUFS     4
+#define NET_TX_BUFS     4
+#define NET_CTL_BUFS    16
+#define NET_RX_LOANS    1           /* Driver buffers netDaemon holds     */
+#define NET_RX_BUDGET   16          /* Frames read between ring harvests  */
+
 /* Ethernet packet types */
 #define ETYPE_IPv4 0x0800
 #define ETYPE_ARP  0x0806
 #define ETYPE_FISH 0x3250
 
+/* Early receive filter drop reasons, indexes into net.rxDrops           */
+#define NET_DROP_RUNT   0           /* Shorter than an Ethernet header    */
+#define NET_DROP_MAC    1           /* Unicast for another station        */
+#define NET_DROP_MCAST  2           /* Multicast group not joined         */
+#define NET_DROP_ETYPE  3           /* Not IPv4 or ARP                    */
+#define NET_DROP_REASONS 4
+#define NET_MCAST_HASH  64          /* Multicast hash buckets, CRC-32 bits */
+
+/* Receive load shedding classes, least valuable first; index net.rxShed */
+#define NET_CLASS_ECHO  0           /* ICMP echo requests                 */
+#define NET_CLASS_ARP   1           /* ARP requests and replies           */
+#define NET_CLASS_NEW   2           /* Datagrams, connection requests     */
+#define NET_CLASS_SESSION 3         /* Segments of open TCP connections   */
+#define NET_CLASSES     4
+#define NET_SHED_ECHO   (ETH_IBLEN / 8) /* Input queue depth shedding echo */
+#define NET_SHED_ARP    (ETH_IBLEN / 4) /* ... shedding ARP as well       */
+#define NET_SHED_NEW    (ETH_IBLEN / 2) /* ... and all but sessions       */
+#define NET_RX_SLICE    10          /* ms netDaemon runs without blocking */
+#define NET_RX_REST     10          /* ms it then sleeps, so 50% of CPU   */
+
+/* Transmit queues in front of the TX DMA ring, indexes into netTx.queues */
+#define NET_TXQ_HIGH    0           /* Internetwork and network control   */
+#define NET_TXQ_MID     1           /* Precedence 1 to 5                  */
+#define NET_TXQ_LOW     2           /* Routine                            */
+#define NET_TXQS        3
+#define NET_TXQ_LEN     64          /* Frames each queue holds            */
+#define NET_TXQ_WEIGHT_MID 4        /* MID frames sent per turn           */
+#define NET_TXQ_WEIGHT_LOW 1        /* LOW frames sent per turn           */
+#define NET_TX_RING_LIMIT 8         /* Frames let into the TX DMA ring    */
+#define NET_TX_HIST     16          /* Wait histogram buckets, log2 us    */
+
 /* Ethergram header size    */
 #define ETHER_SIZE   (ETH_ADDR_LEN * 2 + 2)
 
@@ -60,6 +186,12 @@ struct ethergram             /**< Ethernet Packet Variables             */
     char data[1];            /**< Dummy field that refers to payload    */
 };
 
+/** Ethernet header accessors, in host byte order */
+NET_INLINE ushort etherGetType(const struct ethergram *eg)
+{
+    return ntohs(eg->type);
+}
+
 /* Maximum length of an IPv4 address in dot-decimal notation */
 #define IPv4_DOTDEC_MAXLEN    15
 
@@ -99,6 +231,7 @@ struct ethergram             /**< Ethernet Packet Variables             */
 #define IPv4_TOS_IM        0x2
 #define IPv4_TOS_PRIO        0x1
 #define IPv4_TOS_ROUTINE    0x0
+#define IPv4_TOS_PREC_SHIFT  5      /* Precedence is the top 3 bits */
 
 /*
  * IPv4 HEADER
@@ -134,11 +267,49 @@ struct ipgram                /**< IPv4 Packet Variables                 */
     uchar  ttl;              /**< IPv4 time to live                     */
     uchar  proto;            /**< IPv4 protocol                         */
     ushort chksum;           /**< IPv4 checksum                         */
-    uchar  src[IPv4_ADDR_LEN];  /**< IPv4 source                        */
-    uchar  dst[IPv4_ADDR_LEN];  /**< IPv4 destination                   */
+    ipaddr src;              /**< IPv4 source                           */
+    ipaddr dst;              /**< IPv4 destination                      */
     uchar  opts[1];          /**< Options and padding is variable       */
 };
 
+/** IPv4 header accessors, in host byte order */
+NET_INLINE ushort ipGetHdrLen(const struct ipgram *ip)
+{
+    return (ip->ver_ihl & IPv4_IHL) << 2;
+}
+
+NET_INLINE ushort ipGetLen(const struct ipgram *ip)
+{
+    return ntohs(ip->len);
+}
+
+NET_INLINE ushort ipGetId(const struct ipgram *ip)
+{
+    return ntohs(ip->id);
+}
+
+/* Flags and fragment offset share a field; decode it once with
+ * ipGetFlagsFroff and split it with IPv4_FLAGS and IPv4_FROFF */
+NET_INLINE ushort ipGetFlagsFroff(const struct ipgram *ip)
+{
+    return ntohs(ip->flags_froff);
+}
+
+NET_INLINE ulong ipGetFroff(const struct ipgram *ip)
+{
+    return (ulong) (ntohs(ip->flags_froff) & IPv4_FROFF) << 3;
+}
+
+/** IPv4 pseudo-header covered by the UDP and TCP checksums */
+struct ipPseudo
+{
+    ipaddr src;              /**< IPv4 source                           */
+    ipaddr dst;              /**< IPv4 destination                      */
+    uchar  zero;             /**< Always zero                           */
+    uchar  proto;            /**< IPv4 protocol                         */
+    ushort len;              /**< Transport length, header included     */
+};
+
 /*
  * UDP HEADER
  *
@@ -161,6 +332,22 @@ struct udpgram                  /**< UDP Packet Variables           */
     uchar data[1];              /**< UDP data                       */
 };
 
+/** UDP header accessors, in host byte order */
+NET_INLINE ushort udpGetSrcPort(const struct udpgram *udp)
+{
+    return ntohs(udp->srcPort);
+}
+
+NET_INLINE ushort udpGetDstPort(const struct udpgram *udp)
+{
+    return ntohs(udp->dstPort);
+}
+
+NET_INLINE ushort udpGetLen(const struct udpgram *udp)
+{
+    return ntohs(udp->len);
+}
+
 /*
  * DHCP HEADER
  *
@@ -210,10 +397,10 @@ struct dhcpgram                 /**< DHCP Packet Variables          */
     ulong  id;                  /**< DHCP transaction ID            */
     ushort elapsed;             /**< DHCP time elapsed              */
     ushort flags;               /**< DHCP flags                     */
-    uchar  client[IPv4_ADDR_LEN];  /**< DHCP client IP address      */
-    uchar  yourIP[IPv4_ADDR_LEN];  /**< DHCP your IP address        */
-    uchar  server[IPv4_ADDR_LEN];  /**< DHCP server IP address      */
-    uchar  router[IPv4_ADDR_LEN];  /**< DHCP gateway IP address     */
+    ipaddr client;              /**< DHCP client IP address         */
+    ipaddr yourIP;              /**< DHCP your IP address           */
+    ipaddr server;              /**< DHCP server IP address         */
+    ipaddr router;              /**< DHCP gateway IP address        */
     uchar  hwaddr[DHCP_HWFIELD_LEN];  /**< Client hardware address  */
     uchar  servname[DHCP_SERVNAME_LEN];  /**< Server name           */
     uchar  bootfile[DHCP_BOOTFILE_LEN];  /**< Bootfile name         */
@@ -227,6 +414,7 @@ struct dhcpgram                 /**< DHCP Packet Variables          */
 #define DHCP_MAGIC_COOKIE 0x63825363
 
 /* DHCP options,  RFC2132 */
+#define DHCP_OPTIONS_PAD            0
 #define DHCP_OPTIONS_SUBNET_MASK    1
 #define DHCP_OPTIONS_ROUTER         3
 #define DHCP_OPTIONS_DNS_SERVER     6
@@ -235,6 +423,7 @@ struct dhcpgram                 /**< DHCP Packet Variables          */
 #define DHCP_OPTIONS_LEASETIME     51
 #define DHCP_OPTIONS_MESSAGE       53
 #define DHCP_OPTIONS_SERVER_ID     54
+#define DHCP_OPTIONS_PARAM_REQ     55
 #define DHCP_OPTIONS_CLIENT_ID     61
 #define DHCP_OPTIONS_END           255
 
@@ -255,13 +444,16 @@ struct dhcpgram                 /**< DHCP Packet Variables          */
 #define IPv4_FRAG_INVALID    0x00
 #define IPv4_FRAG_INCOMPLETE 0x01
 #define IPv4_FRAG_ENTS       0x1
+#define IPv4_FRAG_TIMEOUT    15000   /* Reassembly timeout in ms */
 
 struct ipFragEntry
 {
     uchar       flag;
+    uchar       gotFirst;       /* Fragment at offset 0 has arrived */
     ushort      id;
     ulong       pktDataLen;
     ulong       recvdBytes;
+    ulong       startTime;      /* Time (ms) the first fragment arrived */
     uchar       pkt[IPv4_FRAGBUF_SIZE];
     uchar       *dataStart;
 };
@@ -269,28 +461,120 @@ struct ipFragEntry
 extern struct ipFragEntry ipFrags[IPv4_FRAG_ENTS];
 
 
+/** A network buffer pool and its usage */
+struct netPool
+{
+    int         id;                                 /** bfptab index, SYSERR if none */
+    ulong       size;                               /** Bytes per buffer */
+    ulong       count;                              /** Buffers in the pool */
+    ulong       inUse;                              /** Buffers handed out now */
+    ulong       highWater;                          /** Most ever handed out at once */
+    ulong       fails;                              /** Requests with none left */
+};
+
+
 /** Network Information Struct */
 struct netInfo
 {
     int         dId;                                /** Net daemon id */
-    uchar       ipAddr[IP_ADDR_LEN];                /** This host's IP address */
+    ipaddr      ipAddr;                             /** This host's IP address */
+    ipaddr      netmask;                            /** Local subnet mask */
+    ipaddr      gateway;                            /** Default gateway, 0 if none */
+    ushort      ipId;                               /** IPv4 id of the next datagram */
     uchar       hwAddr[ETH_ADDR_LEN];               /** This host's mac address */
+    struct netPool pools[NET_POOLS];                /** Packet buffer pools */
+    uchar       mcastRefs[NET_MCAST_HASH];          /** Joins per multicast bucket */
+    ulong       rxAccepted;                         /** Frames past netRxFilter */
+    ulong       rxDrops[NET_DROP_REASONS];          /** Frames it dropped, by reason */
+    ulong       rxShed[NET_CLASSES];                /** Frames shed under load, by class */
+    ulong       rxRests;                            /** Times netDaemon hit NET_RX_SLICE */
+    ulong       rxSliceStart;                       /** netTime the daemon last idled */
 };
 
 extern struct netInfo net;
 
 
+/** A transmit queue: frames waiting for room in the TX DMA ring */
+struct netTxQueue
+{
+    struct ethPktBuffer *frames[NET_TXQ_LEN];       /** Frames, oldest at head */
+    ushort      lens[NET_TXQ_LEN];                  /** Their lengths in bytes */
+    ulong       stamps[NET_TXQ_LEN];                /** netCycles when queued */
+    int         head;                               /** Index of the oldest frame */
+    int         count;                              /** Frames queued now */
+    ulong       sent;                               /** Frames posted to the ring */
+    ulong       drops;                              /** Frames that found it full */
+    ulong       maxDepth;                           /** Most frames ever queued */
+    ulong       maxWait;                            /** Longest wait in us */
+    ulong       hist[NET_TX_HIST];                  /** Waits, bucket b < 2^b us */
+};
+
+/** Transmit queue state */
+struct netTxInfo
+{
+    struct netTxQueue queues[NET_TXQS];             /** Queues by NET_TXQ_* */
+    int         turn;                               /** MID or LOW, whose turn */
+    int         credit;                             /** Frames left in the turn */
+    ulong       mhz;                                /** netCycles per us */
+    void        (*wake)(void);                      /** Called when room frees, or NULL */
+};
+
+extern struct netTxInfo netTx;
+
+
 /** Network daemon process */
 void netDaemon(void);
 
 /** IPv4 Functions */
 syscall ipRecv(struct ipgram *, uchar *);
-syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto, uchar *ipAddr);
+syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto,
+                uchar ttl, uchar tos, ipaddr ipAddr);
+syscall ipSend(struct ethPktBuffer *frame, ushort id, ushort dataLen,
+               uchar proto, uchar ttl, uchar tos, ipaddr ipAddr);
+ushort ipNextId(void);
 
 /** Lower level Network functions */
-syscall netWrite(void *payload, ushort payloadLen, ushort type, uchar *hwAddr);
+syscall netWrite(void *payload, ushort payloadLen, ushort type, uchar *hwAddr,
+                 uchar tos);
+struct ethPktBuffer *netFrameGet(void);
+syscall netFrameSend(struct ethPktBuffer *frame, ushort payloadLen,
+                     ushort type, uchar *hwAddr, uchar tos);
+syscall netFrameFree(struct ethPktBuffer *frame);
+
+/** Transmit queue functions */
+syscall netTxInit(void);
+syscall netTxEnqueue(struct ethPktBuffer *frame, ushort len, uchar tos);
+void netTxKick(void);
+syscall netTxClear(void);
+ulong netTxLatency(int queue, int pct);
+
+/** Early receive filter functions */
+syscall netFilterInit(void);
+syscall netRxFilter(const struct ethergram *eg, int len);
+syscall netMcastJoin(const uchar *hwAddr);
+syscall netMcastLeave(const uchar *hwAddr);
+
+/** Receive overload functions */
+int netRxClass(const struct ethergram *eg);
+syscall netRxShed(const struct ethergram *eg, int depth);
+syscall netRxQuota(int depth);
+
+/** Network buffer pool functions */
+syscall netBufInit(void);
+void *netBufGet(int pool);
+syscall netBufFree(void *buf);
+
+/** Internet checksum functions */
+ulong csumPartial(const void *buf, int len, ulong sum);
+ulong csumPartialCopy(void *dst, const void *src, int len, ulong sum);
+ushort csumFold(ulong sum);
+ushort netChecksum(const void *buf, int len);
+ushort csumUpdate16(ushort chksum, ushort oldVal, ushort newVal);
+ulong ipPseudoSum(ipaddr src, ipaddr dst, uchar proto, ushort len);
 
 /** Misc. Helper functions */
 syscall getpid(void);
+ulong netTime(void);
+ulong netCycles(void);
 
 #endif                          /* _NETWORK_H_ */
@@ -0,0 +1,68 @@
+/**
+ * @file shape.h
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#ifndef _SHAPE_H_
+#define _SHAPE_H_
+
+#include <network.h>
+#include <ether.h>
+
+/* Shaper defines */
+#define SHAPE_RULES         8       /** Destinations that can be shaped */
+#define SHAPE_QLEN          16      /** Frames each rule can hold back */
+#define SHAPE_BURST_MIN     ETH_MAX_PKT_LEN /** Smallest bucket, in bytes */
+#define SHAPE_BURST_MAX     (1 << 24)   /** Largest bucket, in bytes */
+#define SHAPE_BURST_DEFAULT 8192    /** Bucket if none is given, in bytes */
+#define SHAPE_RATE_MAX      1000000 /** Highest rate, in kbit/s */
+
+/** A token bucket for the traffic to one destination prefix */
+struct shapeRule
+{
+    ipaddr  dst;                    /** Destination prefix */
+    ipaddr  mask;                   /** Its netmask */
+    ulong   rate;                   /** kbit/s, so bits per ms; 0 if free */
+    ulong   burst;                  /** Bucket depth in bits */
+    ulong   tokens;                 /** Bits that may be sent now */
+    bool    removed;                /** Removed, sending what it holds */
+    ulong   last;                   /** netTime of the last refill */
+    struct ethPktBuffer *frames[SHAPE_QLEN];    /** Held frames, oldest at head */
+    ushort  lens[SHAPE_QLEN];       /** Their lengths in bytes */
+    uchar   tos[SHAPE_QLEN];        /** Their precedence */
+    int     head;                   /** Index of the oldest held frame */
+    int     count;                  /** Frames held now */
+    ulong   passed;                 /** Frames sent straight through */
+    ulong   delayed;                /** Frames held back, then sent */
+    ulong   dropped;                /** Frames that found the queue full */
+    ulong   bytes;                  /** Bytes sent under this rule */
+};
+
+/** Traffic shaper information struct */
+struct shapeInfo
+{
+    struct shapeRule rules[SHAPE_RULES];    /** Rules, in match order */
+    int         active;             /** Rules in use */
+    int         held;               /** Frames held across all rules */
+    bool        blocked;            /** A held frame found netTx full */
+    int         sId;                /** Shaper process id */
+};
+
+extern struct shapeInfo shape;
+
+/** Shaper initialization and process */
+syscall shapeInit(void);
+void shapeDaemon(void);
+void shapeKick(void);
+
+/** Shaping rules */
+syscall shapeAdd(ipaddr dst, ipaddr mask, ulong kbps, ulong burst);
+syscall shapeRemove(ipaddr dst, ipaddr mask);
+
+/** Transmit path, used by netFrameSend */
+syscall shapeSend(struct ethPktBuffer *frame, ushort len, uchar tos);
+
+#endif                          /* _SHAPE_H_ */
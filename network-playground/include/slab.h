@@ -0,0 +1,70 @@
+/**
+ * @file slab.h
+ *
+ * $Id:$
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/12/2016       */
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <kernel.h>
+#include <mips.h>
+
+/*
+ * Caches back the network objects made and freed at run time: the UDP
+ * receive rings (udp.ringSlab) and the TCP send/receive rings
+ * (tcp.bufSlab). The ARP table (arp.tbl), the ICMP sessions (icmpTbl)
+ * and the reassembly descriptors (ipFrags) are static arrays sized at
+ * compile time and reused by slot; they never touch the heap, so a
+ * cache would add a lookup without saving any fragmentation. A pending
+ * ARP resolution has no descriptor to cache: its state lives on the
+ * stack of its helper process.
+ */
+
+#define SLAB_MAX_CACHES     8
+#define SLAB_MIN_OBJ        sizeof(void *)  /** A free object holds a link */
+
+/** slabRound - round an object size up to a whole number of cache lines
+ *  @param b size in bytes
+ */
+#define slabRound(b) (((b) + D_CACHE_LINE - 1) & ~(D_CACHE_LINE - 1))
+
+/** A free object; the link lives in the object itself */
+struct slabObj
+{
+    struct slabObj  *next;
+};
+
+/** A cache of equal sized objects of one type */
+struct slabCache
+{
+    char            *name;          /** Type name, NULL if the cache is free */
+    ulong           objSize;        /** Bytes per object, whole cache lines */
+    ulong           perSlab;        /** Objects carved from each slab */
+    ulong           maxSlabs;       /** Most slabs the cache may take */
+    ulong           slabs;          /** Slabs taken from the heap so far */
+    struct slabObj  *free;          /** Free objects, last freed first */
+    ulong           inUse;          /** Objects handed out now */
+    ulong           highWater;      /** Most ever handed out at once */
+    ulong           allocs;         /** Successful slabAlloc calls */
+    ulong           fails;          /** slabAlloc calls with none left */
+};
+
+/** Slab allocator information struct */
+struct slabInfo
+{
+    struct slabCache    caches[SLAB_MAX_CACHES];
+};
+
+extern struct slabInfo slab;
+
+/** Slab allocator functions */
+syscall slabInit(void);
+int slabCreate(char *name, ulong size, ulong perSlab, ulong maxSlabs);
+void *slabAlloc(int id);
+syscall slabFree(int id, void *obj);
+
+#endif                          /* _SLAB_H_ */
@@ -0,0 +1,252 @@
+/**
+ * @file tcp.h
+ *
+ * $Id:$
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/8/2016        */
+
+#ifndef _TCP_H_
+#define _TCP_H_
+
+#include <network.h>
+#include <ether.h>
+
+/* TCP header sizes */
+#define TCP_HDR_LEN         20
+#define TCP_MSS_OPT_LEN     4       /** MSS option sent with a SYN */
+#define TCP_MSS             (ETH_MTU - IPv4_HDR_LEN - TCP_HDR_LEN)
+#define TCP_DEFAULT_MSS     536     /** Peer MSS if it sends no option */
+
+/* TCP header flags */
+#define TCP_FLAG_FIN        0x01
+#define TCP_FLAG_SYN        0x02
+#define TCP_FLAG_RST        0x04
+#define TCP_FLAG_PSH        0x08
+#define TCP_FLAG_ACK        0x10
+#define TCP_FLAG_URG        0x20
+
+/* TCP options */
+#define TCP_OPT_END         0
+#define TCP_OPT_NOP         1
+#define TCP_OPT_MSS         2
+
+/* Connection states (RFC 793) */
+#define TCP_CLOSED          0
+#define TCP_LISTEN          1
+#define TCP_SYN_SENT        2
+#define TCP_SYN_RCVD        3
+#define TCP_ESTABLISHED     4
+#define TCP_FIN_WAIT_1      5
+#define TCP_FIN_WAIT_2      6
+#define TCP_CLOSE_WAIT      7
+#define TCP_CLOSING         8
+#define TCP_LAST_ACK        9
+#define TCP_TIME_WAIT       10
+
+/* Connection table defines */
+#define TCP_MAX_CONNS       8
+#define TCP_SNDBUF          16384   /** Send buffer bytes, a power of 2 */
+#define TCP_RCVBUF          16384   /** Receive buffer bytes, a power of 2 */
+#define TCP_BACKLOG         4       /** Connections waiting on accept */
+#define TCP_NO_CONN         -1
+#define TCP_NO_PID          -1
+#define TCP_OUTQ            32      /** Segments built while the semaphore
+                                        is held, sent once it is released */
+
+/* Timers, in ms */
+#define TCP_TICK            10      /** Timer process period */
+#define TCP_DELACK          100     /** Longest an ACK is delayed */
+#define TCP_RTO_INIT        1000    /** RTO before any RTT sample */
+#define TCP_RTO_MIN         200
+#define TCP_RTO_MAX         60000
+#define TCP_TIME_WAIT_LEN   2000    /** 2 * MSL, kept short for a LAN */
+#define TCP_FIN_WAIT_2_LEN  60000   /** Longest an orphan waits for a FIN */
+#define TCP_MAX_RETRIES     8
+#define TCP_DUPACK_THRESH   3       /** Duplicate ACKs before fast retransmit */
+
+/* Ports handed out to active opens */
+#define TCP_EPHEM_FIRST     49152
+#define TCP_EPHEM_LAST      65535
+
+/* Connection flags */
+#define TCP_CF_INUSE        0x01    /** Connection table entry is taken */
+#define TCP_CF_USERCLOSED   0x02    /** User called tcpClose, send a FIN */
+#define TCP_CF_FINSENT      0x04    /** Our FIN is in sndNxt */
+#define TCP_CF_FINRCVD      0x08    /** Peer's FIN is in rcvNxt */
+#define TCP_CF_RTTTIMING    0x10    /** A segment is being timed */
+#define TCP_CF_ACKNOW       0x20    /** Send an ACK without delay */
+#define TCP_CF_ORPHAN       0x40    /** No process holds the descriptor */
+
+/** Sequence number comparisons, modulo 2^32 */
+#define SEQ_LT(a, b)        ((long) ((a) - (b)) < 0)
+#define SEQ_LEQ(a, b)       ((long) ((a) - (b)) <= 0)
+#define SEQ_GT(a, b)        ((long) ((a) - (b)) > 0)
+#define SEQ_GEQ(a, b)       ((long) ((a) - (b)) >= 0)
+
+/** Has a deadline from netTime passed; a deadline of 0 is off */
+#define TCP_EXPIRED(now, t) ((t) != 0 && (long) ((now) - (t)) >= 0)
+
+/*
+ * TCP HEADER
+ *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Source Port                   | Destination Port              |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Sequence Number                                               |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Acknowledgment Number                                         |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Offset| Rsrvd |     Flags     | Window                        |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Checksum                      | Urgent Pointer                |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * | Options & Padding (Variable octets)                           |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+
+struct tcpgram                  /**< TCP Segment Variables          */
+{
+    ushort srcPort;             /**< TCP Source port                */
+    ushort dstPort;             /**< TCP Destination port           */
+    ulong  seq;                 /**< TCP Sequence number            */
+    ulong  ack;                 /**< TCP Acknowledgment number      */
+    uchar  offset;              /**< TCP Data offset (high nibble)  */
+    uchar  flags;               /**< TCP Flags                      */
+    ushort window;              /**< TCP Receive window             */
+    ushort chksum;              /**< TCP Checksum                   */
+    ushort urgent;              /**< TCP Urgent pointer             */
+    uchar  data[1];             /**< TCP options and data           */
+};
+
+/** TCP header accessors, in host byte order */
+NET_INLINE ushort tcpGetHdrLen(const struct tcpgram *tcp)
+{
+    return (tcp->offset >> 4) << 2;
+}
+
+NET_INLINE ulong tcpGetSeq(const struct tcpgram *tcp)
+{
+    return ntohl(tcp->seq);
+}
+
+NET_INLINE ulong tcpGetAck(const struct tcpgram *tcp)
+{
+    return ntohl(tcp->ack);
+}
+
+/** TCP connection (transmission control block) */
+struct tcb
+{
+    uchar   state;                  /** TCP_CLOSED ... TCP_TIME_WAIT */
+    uchar   flags;                  /** TCP_CF_* */
+    ipaddr  remoteAddr;             /** Peer's IPv4 address */
+    ushort  localPort;              /** Our port */
+    ushort  remotePort;             /** Peer's port */
+    int     pid;                    /** Process blocked on this connection */
+
+    /* Listening connections */
+    int     parent;                 /** Listener that spawned this one */
+    int     backlog[TCP_BACKLOG];   /** Established, not yet accepted */
+    int     backlogCount;
+
+    /* Send side */
+    ulong   iss;                    /** Initial send sequence number */
+    ulong   sndUna;                 /** Oldest unacknowledged sequence */
+    ulong   sndNxt;                 /** Next sequence to send */
+    ulong   sndMax;                 /** Highest sequence sent so far */
+    ulong   sndWnd;                 /** Peer's advertised window */
+    ulong   cwnd;                   /** Congestion window */
+    ulong   ssthresh;               /** Slow start threshold */
+    ushort  mss;                    /** Largest segment the peer takes */
+    ushort  dupAcks;                /** Duplicate ACKs in a row */
+    uchar   *sndBuf;                /** Send ring, TCP_SNDBUF bytes */
+    ulong   sndHead;                /** Ring index of sndUna's byte */
+    ulong   sndCount;               /** Bytes queued, sent or not */
+
+    /* Receive side */
+    ulong   irs;                    /** Initial receive sequence number */
+    ulong   rcvNxt;                 /** Next sequence expected */
+    ulong   rcvAdv;                 /** Window we last advertised */
+    uchar   *rcvBuf;                /** Receive ring, TCP_RCVBUF bytes */
+    ulong   rcvHead;                /** Ring index of the oldest byte */
+    ulong   rcvCount;               /** Bytes waiting to be read */
+
+    /* Timers and RTT estimation (RFC 6298), times in ms */
+    ulong   rtoTime;                /** Retransmit deadline, 0 if off */
+    ulong   ackTime;                /** Delayed ACK deadline, 0 if off */
+    ulong   waitTime;               /** TIME_WAIT deadline, or FIN_WAIT_2
+                                        deadline of an orphan */
+    ulong   persistTime;            /** Zero window probe deadline, 0 if off */
+    ulong   persistLen;             /** Probe interval, doubled per probe */
+    ulong   rto;                    /** Retransmission timeout */
+    long    srtt;                   /** Smoothed RTT, scaled by 8 */
+    long    rttvar;                 /** RTT variation, scaled by 4 */
+    ulong   rttSeq;                 /** Sequence being timed */
+    ulong   rttStart;               /** Time it was sent */
+    uchar   retries;                /** Retransmits without progress */
+    uchar   unacked;                /** Full segments received, not ACKed */
+};
+
+/** A segment built and waiting for tcpUnlock to send it */
+struct tcpOutSeg
+{
+    struct ethPktBuffer *frame;     /** Frame holding the segment */
+    ushort  len;                    /** Segment length in bytes */
+    ushort  id;                     /** IPv4 id */
+    ipaddr  dst;                    /** Remote address */
+};
+
+/** TCP information struct - includes the connection table */
+struct tcpInfo
+{
+    struct tcb      tcbs[TCP_MAX_CONNS];    /** Connection table */
+    semaphore       sema;                   /** Connection table semaphore */
+    int             tId;                    /** TCP timer process id */
+    int             bufSlab;                /** Slab cache of send/receive rings */
+    ushort          nextEphem;              /** Next ephemeral port to try */
+    ulong           segsIn;                 /** Segments received */
+    ulong           segsOut;                /** Segments sent */
+    ulong           retransmits;            /** Segments sent again */
+    ulong           badSum;                 /** Segments with a bad checksum */
+    struct tcpOutSeg outq[TCP_OUTQ];        /** Segments to send on unlock */
+    int             outCount;               /** Segments in outq */
+    ulong           outDrops;               /** Segments that found outq full */
+};
+
+extern struct tcpInfo tcp;
+
+/** TCP initialization and timer process */
+syscall tcpInit(void);
+void tcpTimer(void);
+
+/** Receive a TCP segment (used by netDaemon) */
+syscall tcpRecv(struct ipgram *);
+
+/** Socket-like TCP calls */
+int tcpListen(ushort localPort);
+int tcpAccept(int sd, int timeout);
+int tcpConnect(ipaddr remoteAddr, ushort remotePort, int timeout);
+int tcpWrite(int sd, void *buf, int len);
+int tcpRead(int sd, void *buf, int len, int timeout);
+syscall tcpClose(int sd);
+
+/** TCP internals shared by the input, output and timer paths */
+int tcpAlloc(void);
+void tcpFree(int sd);
+void tcpUnlock(void);
+void tcpWake(struct tcb *);
+void tcpSetClosed(struct tcb *);
+int tcpLookup(ipaddr remoteAddr, ushort remotePort, ushort localPort);
+ulong tcpDeadline(ulong ms);
+ulong tcpIss(void);
+void tcpStartTimers(struct tcb *, ulong seq);
+void tcpPersist(struct tcb *);
+void tcpProbe(struct tcb *);
+void tcpOutput(struct tcb *);
+void tcpRetransmit(struct tcb *);
+syscall tcpSendSegment(struct tcb *, uchar flags, ulong seq, ulong len);
+syscall tcpSendReset(struct ipgram *, struct tcpgram *, ushort dataLen);
+
+#endif                          /* _TCP_H_ */
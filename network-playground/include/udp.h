@@ -0,0 +1,112 @@
+/**
+ * @file udp.h
+ *
+ * $Id:$
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/6/2016        */
+
+#ifndef _UDP_H_
+#define _UDP_H_
+
+#include <network.h>
+#include <ether.h>
+
+/* UDP header and payload sizes */
+#define UDP_HDR_LEN         8
+#define UDP_MAX_DATA        (ETH_MTU - IPv4_HDR_LEN - UDP_HDR_LEN)
+
+/* UDP socket table defines */
+#define UDP_MAX_SOCKS       16
+#define UDP_HASH_LEN        16      /** Hash buckets, a power of 2 */
+#define UDP_RING_LEN        16      /** Datagrams queued per socket */
+#define UDP_POST_LEN        16      /** Buffers posted per socket */
+#define UDP_SOCK_FREE       0
+#define UDP_SOCK_BOUND      1
+#define UDP_NO_SOCK         -1      /** End of a hash chain */
+#define UDP_NO_PID          -1      /** No process waiting */
+
+/* UDP socket flags */
+#define UDP_FLAG_POSTED     0x01    /** Deliver into posted buffers */
+
+/* Ports handed out when binding to port 0 */
+#define UDP_EPHEM_FIRST     49152
+#define UDP_EPHEM_LAST      65535
+
+/** Hash bucket of a local port */
+#define udpHash(port) (((port) ^ ((port) >> 8)) & (UDP_HASH_LEN - 1))
+
+/** A received datagram waiting in a socket's ring */
+struct udpDgram
+{
+    ipaddr  srcAddr;                /** Sender's IPv4 address */
+    ushort  srcPort;                /** Sender's UDP port */
+    ushort  len;                    /** Payload length in bytes */
+    uchar   data[UDP_MAX_DATA];     /** Payload */
+};
+
+/** A caller buffer posted to a socket, filled in by the netDaemon */
+struct udpPost
+{
+    uchar   *buf;                   /** Caller's buffer */
+    ushort  size;                   /** Size of the buffer in bytes */
+    ushort  len;                    /** Payload length once filled */
+    ipaddr  srcAddr;                /** Sender's IPv4 address */
+    ushort  srcPort;                /** Sender's UDP port */
+};
+
+/** UDP socket contents */
+struct udpSock
+{
+    uchar   state;                  /** UDP_SOCK_FREE or UDP_SOCK_BOUND */
+    uchar   flags;                  /** UDP_FLAG_POSTED */
+    ushort  localPort;              /** Port this socket is bound to */
+    int     next;                   /** Next socket in the hash chain */
+    int     pid;                    /** Process blocked in udpRecvfrom */
+    struct udpDgram *ring;          /** Receive ring, UDP_RING_LEN entries */
+    int     head;                   /** Oldest queued datagram */
+    int     count;                  /** Datagrams queued */
+    struct udpPost posts[UDP_POST_LEN]; /** Posted buffers, in order */
+    int     postHead;               /** Oldest posted buffer */
+    int     postCount;              /** Buffers posted, filled or not */
+    int     postFilled;             /** Buffers filled, from postHead */
+    ulong   recvd;                  /** Datagrams queued since bind */
+    ulong   drops;                  /** Datagrams dropped, no room */
+};
+
+/** UDP information struct - includes the socket table */
+struct udpInfo
+{
+    struct udpSock  socks[UDP_MAX_SOCKS];   /** Socket table */
+    int             hash[UDP_HASH_LEN];     /** First socket of each chain */
+    semaphore       sema;                   /** Socket table semaphore */
+    int             ringSlab;               /** Slab cache of receive rings */
+    ushort          nextEphem;              /** Next ephemeral port to try */
+    ulong           noPort;                 /** Datagrams for unbound ports */
+    ulong           badSum;                 /** Datagrams with a bad checksum */
+};
+
+extern struct udpInfo udp;
+
+/** UDP initialization */
+syscall udpInit(void);
+
+/** Receive a UDP datagram (used by netDaemon) */
+syscall udpRecv(struct ipgram *);
+
+/** Socket-like UDP calls */
+int udpBind(ushort localPort);
+syscall udpClose(int sd);
+syscall udpSendto(int sd, void *buf, ushort len, ipaddr dstAddr,
+                  ushort dstPort, uchar tos);
+int udpRecvfrom(int sd, void *buf, ushort len, ipaddr *srcAddr,
+                ushort *srcPort, int timeout);
+
+/** Zero-copy receive into buffers posted ahead of time */
+syscall udpPostBuf(int sd, void *buf, ushort size);
+int udpWaitBuf(int sd, void **buf, ipaddr *srcAddr, ushort *srcPort,
+               int timeout);
+int udpUnpostBuf(int sd, void **bufs);
+
+#endif                          /* _UDP_H_ */
@@ -87,11 +87,11 @@ void arpWatcher(void)
  * @param hwAddr mac address of entry we want to add
  * @return OK for success, SYSERR for syntax error
  */
-syscall arpAddEntry(uchar * ipAddr, uchar *hwAddr)
+syscall arpAddEntry(ipaddr ipAddr, uchar *hwAddr)
 {
     int i, entID;
     
-    if (ipAddr == NULL || hwAddr == NULL)
+    if (hwAddr == NULL)
         return SYSERR;
     
     wait(arp.sema);
@@ -103,8 +103,7 @@ syscall arpAddEntry(uchar * ipAddr, uchar *hwAddr)
         entID = arp.freeEnt;
         
         // Set IP Address of entry
-        for (i = 0; i < IP_ADDR_LEN; i++)
-            arp.tbl[entID].ipAddr[i] = ipAddr[i];
+        arp.tbl[entID].ipAddr = ipAddr;
         
         // Set mac address of entry
         for (i = 0; i < ETH_ADDR_LEN; i++)
@@ -167,12 +166,9 @@ syscall arpAddEntry(uchar * ipAddr, uchar *hwAddr)
  * @param ipAddr IPv4 address of entry we are looking for
  * @return OK for success, SYSERR for syntax error
  */
-int arpFindEntry(uchar *ipAddr)
+int arpFindEntry(ipaddr ipAddr)
 {
-    int i, j;
-    
-    if (ipAddr == NULL)
-        return ARP_ENT_NOT_FOUND;
+    int i;
     
     for (i = 0; i < ARP_TABLE_LEN; i++)
     {
@@ -180,16 +176,8 @@ int arpFindEntry(uchar *ipAddr)
         if (arp.tbl[i].osFlags == ARP_ENT_INVALID)
             continue;
         
-        // Compare addresses
-        for(j = 0; j < IP_ADDR_LEN; j++)
-        {
-            // Stop checking if there is a difference
-            if (ipAddr[j] != arp.tbl[i].ipAddr[j])
-                break;
-        }
-        
         // The address is the same, return the index
-        if (j == IP_ADDR_LEN)
+        if (arp.tbl[i].ipAddr == ipAddr)
             return i;
     }
     return ARP_ENT_NOT_FOUND;
@@ -18,39 +18,34 @@
  */
 syscall arpRecv(struct arpPkt *pkt)
 {
-    int i, eqFlag;
+    ipaddr dstAddr;
+    ushort op;
      
     if (pkt == NULL)
         return SYSERR;
     
+    op = arpGetOp(pkt);
+    
     // Screen out packets with bad ARP headers
     if ( pkt->hwAddrLen != ETH_ADDR_LEN ||
          pkt->prAddrLen != IP_ADDR_LEN ||
-         ntohs(pkt->hwType) != ARP_HWTYPE_ETHERNET ||
-         ntohs(pkt->prType) != ARP_PRTYPE_IPv4 ||
-         ((ntohs(pkt->op) != ARP_OP_REPLY) && 
-         (ntohs(pkt->op) != ARP_OP_RQST))
+         arpGetHwType(pkt) != ARP_HWTYPE_ETHERNET ||
+         arpGetPrType(pkt) != ARP_PRTYPE_IPv4 ||
+         ((op != ARP_OP_REPLY) && 
+         (op != ARP_OP_RQST))
          )
         return SYSERR;
     
-    // Screen out packets not addressed to us
-    eqFlag = OK;
-    for (i = 0; i < IP_ADDR_LEN; i++)
-    {
-        if (pkt->addrs[i + ARP_DPA_OFFSET] != net.ipAddr[i])
-        {
-            eqFlag = SYSERR;
-            break;
-        }
-    }
-        
-    if (eqFlag == SYSERR)
+    // Screen out packets not addressed to us. ARP addresses are not
+    // word aligned in the packet, so load them a byte at a time
+    dstAddr = IP_LOAD(&pkt->addrs[ARP_DPA_OFFSET]);
+    if (dstAddr != net.ipAddr)
         return OK;
     
     // Add the sender to our arp table
-    arpAddEntry(&pkt->addrs[ARP_SPA_OFFSET], &pkt->addrs[ARP_SHA_OFFSET]);  
+    arpAddEntry(IP_LOAD(&pkt->addrs[ARP_SPA_OFFSET]), &pkt->addrs[ARP_SHA_OFFSET]);
     
-    if (ntohs(pkt->op) == ARP_OP_RQST)
+    if (op == ARP_OP_RQST)
     {
         arpSendReply(pkt);
     }
@@ -11,7 +11,7 @@
 #include <arp.h>
 
 /* Private/helper functions */
-void arpResolveHelper(uchar *, long, uchar *);
+void arpResolveHelper(ipaddr, long, uchar *);
 
 
 /**
@@ -20,13 +20,13 @@ void arpResolveHelper(uchar *, long, uchar *);
  * @param hwAddr mac address return value
  * @return OK for success, SYSERR for syntax error
  */
-syscall arpResolve(uchar *ipAddr, uchar *hwAddr)
+syscall arpResolve(ipaddr ipAddr, uchar *hwAddr)
 {
     int i, helperID, entID;
     long currpid;
     message msg;
     
-    if (ipAddr == NULL || hwAddr == NULL)
+    if (hwAddr == NULL)
     {
         return SYSERR;
     }
@@ -79,7 +79,7 @@ syscall arpResolve(uchar *ipAddr, uchar *hwAddr)
  * @param hwAddr mac address return value
  * @return OK for success, SYSERR for syntax error
  */
-void arpResolveHelper(uchar *ipAddr, long sourpid, uchar *hwAddr)
+void arpResolveHelper(ipaddr ipAddr, long sourpid, uchar *hwAddr)
 {
     int attempts, i, entID;
     message msg;
@@ -18,29 +18,26 @@
 syscall arpSendReply(struct arpPkt *recvdPkt)
 {
     int i;
-    struct ethergram    *egram = NULL;
+    struct ethPktBuffer *frame = NULL;
     struct arpPkt       *arpP = NULL;
-    char                buf[ARP_PKTSIZE];
+    uchar               dstHwAddr[ETH_ADDR_LEN];
     
     if (recvdPkt == NULL)
     {
         return SYSERR;
     }
     
-    /* Set up Ethergram header */
-    egram = (struct ethergram *) buf;
-    
-    for (i = 0; i < ETH_ADDR_LEN; i++)
-        egram->dst[i] = recvdPkt->addrs[i + ARP_SHA_OFFSET];
+    frame = netFrameGet();
+    if (frame == NULL)
+        return SYSERR;
     
+    // Sent straight back to the requester
     for (i = 0; i < ETH_ADDR_LEN; i++)
-        egram->src[i] = net.hwAddr[i];
-    
-    egram->type = htons(ETYPE_ARP);
+        dstHwAddr[i] = recvdPkt->addrs[i + ARP_SHA_OFFSET];
     
     
     /* Set up Arp header */
-    arpP = (struct arpPkt *) &egram->data;
+    arpP = (struct arpPkt *) netFramePayload(frame);
     
     arpP->hwType = htons(ARP_HWTYPE_ETHERNET);
     arpP->prType = htons(ARP_PRTYPE_IPv4);
@@ -55,8 +52,7 @@ syscall arpSendReply(struct arpPkt *recvdPkt)
         arpP->addrs[i + ARP_SHA_OFFSET] = net.hwAddr[i];
     
     // Source protocol addr (ours)
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        arpP->addrs[i + ARP_SPA_OFFSET] = net.ipAddr[i];
+    IP_STORE(&arpP->addrs[ARP_SPA_OFFSET], net.ipAddr);
     
     // Dest hw addr (requester's)
     for (i = 0; i < ETH_ADDR_LEN; i++)
@@ -66,8 +62,7 @@ syscall arpSendReply(struct arpPkt *recvdPkt)
     for (i = 0; i < IP_ADDR_LEN; i++)
         arpP->addrs[i + ARP_DPA_OFFSET] = recvdPkt->addrs[i + ARP_SPA_OFFSET];
     
-    /* Send packet */
-    write(ETH0, (uchar *)buf, ARP_PKTSIZE);
-
-    return OK;
+    /* Send packet, ahead of any bulk traffic */
+    return netFrameSend(frame, ARP_CONST_HDR_LEN + ARP_ADDR_END_OFFSET,
+                        ETYPE_ARP, dstHwAddr, IPv4_TOS_NETCNTRL);
 }
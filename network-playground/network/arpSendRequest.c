@@ -16,32 +16,24 @@
  * @param ipAddr IPv4 address target
  * @return OK for success, SYSERR for syntax error
  */
-syscall arpSendRequest(uchar *ipAddr)
+syscall arpSendRequest(ipaddr ipAddr)
 {
     int i;
-    struct ethergram    *egram = NULL;
+    struct ethPktBuffer *frame = NULL;
     struct arpPkt       *arpP = NULL;
-    char                buf[ARP_PKTSIZE];
+    uchar               dstHwAddr[ETH_ADDR_LEN];
     
-    if (ipAddr == NULL)
-    {
+    frame = netFrameGet();
+    if (frame == NULL)
         return SYSERR;
-    }    
-    
-    /* Set up Ethergram header */
-    egram = (struct ethergram *) buf;
-    
-    for (i = 0; i < ETH_ADDR_LEN; i++)
-        egram->dst[i] = 0xFF;
     
+    // Broadcast to every host on the wire
     for (i = 0; i < ETH_ADDR_LEN; i++)
-        egram->src[i] = net.hwAddr[i];
-    
-    egram->type = htons(ETYPE_ARP);
+        dstHwAddr[i] = 0xFF;
     
     
     /* Set up Arp header */
-    arpP = (struct arpPkt *) &egram->data;
+    arpP = (struct arpPkt *) netFramePayload(frame);
     
     arpP->hwType = htons(ARP_HWTYPE_ETHERNET);
     arpP->prType = htons(ARP_PRTYPE_IPv4);
@@ -56,19 +48,16 @@ syscall arpSendRequest(uchar *ipAddr)
         arpP->addrs[i + ARP_SHA_OFFSET] = net.hwAddr[i];
     
     // Source protocol addr
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        arpP->addrs[i + ARP_SPA_OFFSET] = net.ipAddr[i];
+    IP_STORE(&arpP->addrs[ARP_SPA_OFFSET], net.ipAddr);
     
     // Dest hw addr
     for (i = 0; i < ETH_ADDR_LEN; i++)
         arpP->addrs[i + ARP_DHA_OFFSET] = 0x00;
     
     // Dest protocol addr
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        arpP->addrs[i + ARP_DPA_OFFSET] = ipAddr[i];
+    IP_STORE(&arpP->addrs[ARP_DPA_OFFSET], ipAddr);
     
-    /* Send packet */
-    write(ETH0, (uchar *)buf, PKTSZ);
-
-    return OK;
+    /* Send packet, ahead of any bulk traffic */
+    return netFrameSend(frame, ARP_CONST_HDR_LEN + ARP_ADDR_END_OFFSET,
+                        ETYPE_ARP, dstHwAddr, IPv4_TOS_NETCNTRL);
 }
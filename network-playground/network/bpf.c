@@ -0,0 +1,337 @@
+/**
+ * @file bpf.c
+ * @provides bpfVerify, bpfLoad, and bpfRun
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <bpf.h>
+
+/* Loads of a frame's bytes in network byte order; frames may be unaligned */
+#define BPF_LOAD32(p)   (((ulong) (p)[0] << 24) | ((ulong) (p)[1] << 16) | \
+                         ((ulong) (p)[2] << 8) | (ulong) (p)[3])
+#define BPF_LOAD16(p)   (((ulong) (p)[0] << 8) | (ulong) (p)[1])
+
+
+/**
+ * Check that a program only uses the supported instructions and always
+ * ends. Jumps only go forward and must land inside the program, the
+ * last instruction must return, scratch memory indexes and shifts must
+ * be in range, and constant divisors nonzero. Loads past the end of a
+ * frame are caught as the program runs.
+ * @param insns instructions
+ * @param len   count of instructions, 1 to BPF_MAXINSNS
+ * @return OK if the program is safe to run, SYSERR otherwise
+ */
+syscall bpfVerify(const struct bpfInsn *insns, int len)
+{
+    const struct bpfInsn *in = NULL;
+    ulong left;
+    int pc;
+
+    if (insns == NULL || len < 1 || len > BPF_MAXINSNS)
+        return SYSERR;
+
+    for (pc = 0; pc < len; pc++)
+    {
+        in = &insns[pc];
+        left = len - pc - 1;
+
+        switch (in->code)
+        {
+        case BPF_LD | BPF_W | BPF_ABS:
+        case BPF_LD | BPF_H | BPF_ABS:
+        case BPF_LD | BPF_B | BPF_ABS:
+        case BPF_LD | BPF_W | BPF_IND:
+        case BPF_LD | BPF_H | BPF_IND:
+        case BPF_LD | BPF_B | BPF_IND:
+        case BPF_LD | BPF_W | BPF_LEN:
+        case BPF_LD | BPF_W | BPF_IMM:
+        case BPF_LDX | BPF_W | BPF_LEN:
+        case BPF_LDX | BPF_W | BPF_IMM:
+        case BPF_LDX | BPF_B | BPF_MSH:
+        case BPF_ALU | BPF_ADD | BPF_K:
+        case BPF_ALU | BPF_SUB | BPF_K:
+        case BPF_ALU | BPF_MUL | BPF_K:
+        case BPF_ALU | BPF_OR | BPF_K:
+        case BPF_ALU | BPF_AND | BPF_K:
+        case BPF_ALU | BPF_ADD | BPF_X:
+        case BPF_ALU | BPF_SUB | BPF_X:
+        case BPF_ALU | BPF_MUL | BPF_X:
+        case BPF_ALU | BPF_DIV | BPF_X:
+        case BPF_ALU | BPF_OR | BPF_X:
+        case BPF_ALU | BPF_AND | BPF_X:
+        case BPF_ALU | BPF_LSH | BPF_X:
+        case BPF_ALU | BPF_RSH | BPF_X:
+        case BPF_ALU | BPF_NEG:
+        case BPF_RET | BPF_K:
+        case BPF_RET | BPF_A:
+        case BPF_MISC | BPF_TAX:
+        case BPF_MISC | BPF_TXA:
+            break;
+
+        case BPF_LD | BPF_MEM:
+        case BPF_LDX | BPF_MEM:
+        case BPF_ST:
+        case BPF_STX:
+            if (in->k >= BPF_MEMWORDS)
+                return SYSERR;
+            break;
+
+        case BPF_ALU | BPF_DIV | BPF_K:
+            if (in->k == 0)
+                return SYSERR;
+            break;
+
+        case BPF_ALU | BPF_LSH | BPF_K:
+        case BPF_ALU | BPF_RSH | BPF_K:
+            if (in->k >= 32)
+                return SYSERR;
+            break;
+
+        case BPF_JMP | BPF_JA:
+            if (in->k >= left)
+                return SYSERR;
+            break;
+
+        case BPF_JMP | BPF_JEQ | BPF_K:
+        case BPF_JMP | BPF_JGT | BPF_K:
+        case BPF_JMP | BPF_JGE | BPF_K:
+        case BPF_JMP | BPF_JSET | BPF_K:
+        case BPF_JMP | BPF_JEQ | BPF_X:
+        case BPF_JMP | BPF_JGT | BPF_X:
+        case BPF_JMP | BPF_JGE | BPF_X:
+        case BPF_JMP | BPF_JSET | BPF_X:
+            if (in->jt >= left || in->jf >= left)
+                return SYSERR;
+            break;
+
+        default:
+            return SYSERR;
+        }
+    }
+
+    if (BPF_CLASS(insns[len - 1].code) != BPF_RET)
+        return SYSERR;
+
+    return OK;
+}
+
+
+/**
+ * Verify a program and copy it in to run
+ * @param prog  where to keep the program
+ * @param insns instructions
+ * @param len   count of instructions
+ * @return OK for success, SYSERR if the program failed bpfVerify
+ */
+syscall bpfLoad(struct bpfProg *prog, const struct bpfInsn *insns, int len)
+{
+    int pc;
+
+    if (prog == NULL || SYSERR == bpfVerify(insns, len))
+        return SYSERR;
+
+    memcpy((void *) prog->insns, (void *) insns, len * sizeof(struct bpfInsn));
+    prog->len = len;
+    prog->flags = 0;
+    for (pc = 0; pc < len; pc++)
+    {
+        if (insns[pc].code == (BPF_LD | BPF_MEM) ||
+            insns[pc].code == (BPF_LDX | BPF_MEM))
+            prog->flags |= BPF_USES_MEM;
+    }
+
+    return OK;
+}
+
+
+/**
+ * Run a program from bpfLoad over a frame. A load past the end of the
+ * frame ends the program and rejects the frame.
+ * @param prog program
+ * @param pkt  start of the frame
+ * @param len  length of the frame in bytes
+ * @return bytes of the frame to keep, 0 to reject it
+ */
+ulong bpfRun(const struct bpfProg *prog, const uchar *pkt, ulong len)
+{
+    const struct bpfInsn *pc = prog->insns;
+    ulong a = 0, x = 0, off;
+    ulong mem[BPF_MEMWORDS];
+
+    // Scratch memory is only read back by programs that load from it
+    if (prog->flags & BPF_USES_MEM)
+        bzero((void *) mem, sizeof(mem));
+
+    for (;; pc++)
+    {
+        switch (pc->code)
+        {
+        case BPF_LD | BPF_W | BPF_ABS:
+            if (pc->k >= len || len - pc->k < 4)
+                return 0;
+            a = BPF_LOAD32(pkt + pc->k);
+            break;
+        case BPF_LD | BPF_H | BPF_ABS:
+            if (pc->k >= len || len - pc->k < 2)
+                return 0;
+            a = BPF_LOAD16(pkt + pc->k);
+            break;
+        case BPF_LD | BPF_B | BPF_ABS:
+            if (pc->k >= len)
+                return 0;
+            a = pkt[pc->k];
+            break;
+        case BPF_LD | BPF_W | BPF_IND:
+            off = x + pc->k;
+            if (off < x || off >= len || len - off < 4)
+                return 0;
+            a = BPF_LOAD32(pkt + off);
+            break;
+        case BPF_LD | BPF_H | BPF_IND:
+            off = x + pc->k;
+            if (off < x || off >= len || len - off < 2)
+                return 0;
+            a = BPF_LOAD16(pkt + off);
+            break;
+        case BPF_LD | BPF_B | BPF_IND:
+            off = x + pc->k;
+            if (off < x || off >= len)
+                return 0;
+            a = pkt[off];
+            break;
+        case BPF_LD | BPF_W | BPF_LEN:
+            a = len;
+            break;
+        case BPF_LD | BPF_W | BPF_IMM:
+            a = pc->k;
+            break;
+        case BPF_LD | BPF_MEM:
+            a = mem[pc->k];
+            break;
+        case BPF_LDX | BPF_W | BPF_LEN:
+            x = len;
+            break;
+        case BPF_LDX | BPF_W | BPF_IMM:
+            x = pc->k;
+            break;
+        case BPF_LDX | BPF_MEM:
+            x = mem[pc->k];
+            break;
+        case BPF_LDX | BPF_B | BPF_MSH:
+            // IPv4 header length from the IHL nibble
+            if (pc->k >= len)
+                return 0;
+            x = (pkt[pc->k] & 0xf) << 2;
+            break;
+        case BPF_ST:
+            mem[pc->k] = a;
+            break;
+        case BPF_STX:
+            mem[pc->k] = x;
+            break;
+
+        case BPF_ALU | BPF_ADD | BPF_K:
+            a += pc->k;
+            break;
+        case BPF_ALU | BPF_SUB | BPF_K:
+            a -= pc->k;
+            break;
+        case BPF_ALU | BPF_MUL | BPF_K:
+            a *= pc->k;
+            break;
+        case BPF_ALU | BPF_DIV | BPF_K:
+            a /= pc->k;
+            break;
+        case BPF_ALU | BPF_OR | BPF_K:
+            a |= pc->k;
+            break;
+        case BPF_ALU | BPF_AND | BPF_K:
+            a &= pc->k;
+            break;
+        case BPF_ALU | BPF_LSH | BPF_K:
+            a <<= pc->k;
+            break;
+        case BPF_ALU | BPF_RSH | BPF_K:
+            a >>= pc->k;
+            break;
+        case BPF_ALU | BPF_ADD | BPF_X:
+            a += x;
+            break;
+        case BPF_ALU | BPF_SUB | BPF_X:
+            a -= x;
+            break;
+        case BPF_ALU | BPF_MUL | BPF_X:
+            a *= x;
+            break;
+        case BPF_ALU | BPF_DIV | BPF_X:
+            if (x == 0)
+                return 0;
+            a /= x;
+            break;
+        case BPF_ALU | BPF_OR | BPF_X:
+            a |= x;
+            break;
+        case BPF_ALU | BPF_AND | BPF_X:
+            a &= x;
+            break;
+        case BPF_ALU | BPF_LSH | BPF_X:
+            a = (x < 32) ? a << x : 0;
+            break;
+        case BPF_ALU | BPF_RSH | BPF_X:
+            a = (x < 32) ? a >> x : 0;
+            break;
+        case BPF_ALU | BPF_NEG:
+            a = -a;
+            break;
+
+        case BPF_JMP | BPF_JA:
+            pc += pc->k;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += (a == pc->k) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JGT | BPF_K:
+            pc += (a > pc->k) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_K:
+            pc += (a >= pc->k) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JSET | BPF_K:
+            pc += (a & pc->k) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_X:
+            pc += (a == x) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JGT | BPF_X:
+            pc += (a > x) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_X:
+            pc += (a >= x) ? pc->jt : pc->jf;
+            break;
+        case BPF_JMP | BPF_JSET | BPF_X:
+            pc += (a & x) ? pc->jt : pc->jf;
+            break;
+
+        case BPF_RET | BPF_K:
+            return pc->k;
+        case BPF_RET | BPF_A:
+            return a;
+
+        case BPF_MISC | BPF_TAX:
+            x = a;
+            break;
+        case BPF_MISC | BPF_TXA:
+            a = x;
+            break;
+
+        default:
+            // Not reached by a verified program
+            return 0;
+        }
+    }
+}
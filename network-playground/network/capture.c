@@ -0,0 +1,297 @@
+/**
+ * @file capture.c
+ * @provides captureStart, captureStop, captureFilter, captureFrame, and
+ *           captureDump
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <uart.h>
+#include <capture.h>
+
+/* Global packet capture definition */
+struct captureInfo capture;
+
+/* The capture ring, word aligned */
+static ulong captureRing[CAPTURE_RING_LEN / 4];
+
+/* Private/helper functions */
+void captureUart(struct uart_csreg *ucsr, const void *buf, int len);
+
+
+/**
+ * Start copying received and sent frames into the capture ring. Frames
+ * already in the ring are discarded. Caution: a dump must not be
+ * running.
+ * @param snaplen bytes kept per frame, 0 for CAPTURE_SNAPLEN
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall captureStart(int snaplen)
+{
+    irqmask im;
+
+    if (snaplen == 0)
+        snaplen = CAPTURE_SNAPLEN;
+    if (snaplen < ETH_HEADER_LEN || snaplen > CAPTURE_SNAPLEN_MAX)
+        return SYSERR;
+
+    im = disable();
+    capture.ring = (uchar *) captureRing;
+    capture.snaplen = snaplen;
+    capture.tail = capture.head;
+    capture.frames = 0;
+    capture.drops = 0;
+    capture.dumped = 0;
+    capture.filtered = 0;
+    capture.on = TRUE;
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Stop capturing frames. Frames in the ring stay there for captureDump.
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall captureStop(void)
+{
+    capture.on = FALSE;
+    return OK;
+}
+
+
+/**
+ * Capture only the frames a BPF program accepts, keeping no more of
+ * each than it returns. The program is verified and loaded into the
+ * slot not in use, then swapped in, all with interrupts disabled;
+ * captureFrame runs the program with them disabled too, so no frame is
+ * ever filtered by a program being overwritten.
+ * @param insns instructions, e.g. from tcpdump -ddd; NULL to capture
+ *              every frame
+ * @param len   count of instructions
+ * @return OK for success, SYSERR if the program failed bpfVerify
+ */
+syscall captureFilter(const struct bpfInsn *insns, int len)
+{
+    struct bpfProg *next = NULL;
+    irqmask im;
+
+    if (insns == NULL)
+    {
+        capture.filter = NULL;
+        return OK;
+    }
+
+    // A failed load leaves the program in use untouched
+    im = disable();
+    next = (capture.filter == &capture.progs[0]) ?
+           &capture.progs[1] : &capture.progs[0];
+    if (SYSERR == bpfLoad(next, insns, len))
+    {
+        restore(im);
+        return SYSERR;
+    }
+
+    capture.filter = next;
+    restore(im);
+    return OK;
+}
+
+
+/**
+ * Copy the first snaplen bytes of a frame into the capture ring. Space
+ * is reserved with interrupts disabled and filled in with the caller's
+ * mask restored; the record is marked ready last, so captureDump never
+ * needs a lock. Sent frames are captured by netTxEnqueue as they join
+ * a transmit queue, so a frame dropped by the shaper or a full queue is
+ * never recorded, and a shaped frame is stamped when it is released.
+ * Callers check capture.on first, so this costs nothing when capture is
+ * off. A filter from captureFilter runs first, before anything is
+ * reserved or copied, with interrupts disabled; it is at most
+ * BPF_MAXINSNS instructions and has no loops.
+ * @param frame start of the Ethernet header
+ * @param len   length of the frame in bytes
+ * @param type  CAPTURE_RX or CAPTURE_TX
+ * @return OK for success, SYSERR if off, filtered out or the ring is
+ *         full
+ */
+syscall captureFrame(const void *frame, int len, int type)
+{
+    struct captureRecord *rec = NULL;
+    struct bpfProg *filter = NULL;
+    ulong off, pad, need, ms, keep;
+    int capLen;
+    irqmask im;
+
+    if (!capture.on || frame == NULL || len <= 0)
+        return SYSERR;
+
+    capLen = (len < capture.snaplen) ? len : capture.snaplen;
+
+    im = disable();
+    filter = capture.filter;
+    keep = (filter != NULL) ? bpfRun(filter, (const uchar *) frame, len) : 1;
+    restore(im);
+
+    if (filter != NULL)
+    {
+        if (keep == 0)
+        {
+            capture.filtered++;
+            return SYSERR;
+        }
+        if (keep < capLen)
+            capLen = keep;
+    }
+    need = (CAPTURE_HDR_LEN + capLen + 3) & ~3;
+
+    im = disable();
+    off = capture.head & (CAPTURE_RING_LEN - 1);
+
+    // Records never wrap; the end of the ring is skipped with a pad
+    pad = (CAPTURE_RING_LEN - off < need) ? CAPTURE_RING_LEN - off : 0;
+    if (capture.head + pad + need - capture.tail > CAPTURE_RING_LEN)
+    {
+        capture.drops++;
+        restore(im);
+        return SYSERR;
+    }
+
+    if (pad != 0)
+    {
+        rec = (struct captureRecord *) (capture.ring + off);
+        rec->len = pad;
+        rec->type = CAPTURE_PAD;
+        rec->ready = TRUE;
+        capture.head += pad;
+        off = 0;
+    }
+
+    rec = (struct captureRecord *) (capture.ring + off);
+    rec->len = need;
+    rec->type = type;
+    rec->ready = FALSE;
+    capture.head += need;
+    capture.frames++;
+    restore(im);
+
+    ms = netTime();
+    rec->sec = ms / 1000;
+    rec->usec = (ms % 1000) * 1000;
+    rec->capLen = capLen;
+    rec->origLen = len;
+    memcpy((void *) rec->data, (void *) frame, capLen);
+
+    // The copy must be complete before the record is seen as ready
+    asm volatile ("" : : : "memory");
+    rec->ready = TRUE;
+
+    return OK;
+}
+
+
+/**
+ * Write the capture ring out in libpcap format, polling the UART of a
+ * tty so the bytes go out exactly as given. Keeps going while frames
+ * arrive, and stops once capture is off and the ring is empty, or the
+ * ring has been empty for CAPTURE_IDLE ms. The tty's interrupts are
+ * held off meanwhile.
+ * @param dev tty to write to, e.g. TTY1
+ * @return count of frames written, SYSERR for syntax error
+ */
+int captureDump(int dev)
+{
+    struct uart_csreg *ucsr = NULL;
+    struct captureRecord *rec = NULL;
+    struct pcapHdr hdr;
+    struct pcapRecHdr recHdr;
+    ulong idle;
+    uchar ier;
+    int count = 0;
+
+    if (isbaddev(dev) || devtab[dev].dvcsr == 0 || capture.ring == NULL)
+        return SYSERR;
+
+    ucsr = (struct uart_csreg *) devtab[dev].dvcsr;
+    ier = ucsr->ier;
+    ucsr->ier = 0;
+
+    hdr.magic = PCAP_MAGIC;
+    hdr.versionMajor = PCAP_VERSION_MAJOR;
+    hdr.versionMinor = PCAP_VERSION_MINOR;
+    hdr.thiszone = 0;
+    hdr.sigfigs = 0;
+    hdr.snaplen = capture.snaplen;
+    hdr.linktype = PCAP_LINKTYPE_ETHERNET;
+    captureUart(ucsr, &hdr, sizeof(hdr));
+
+    idle = netTime();
+    while (TRUE)
+    {
+        if (capture.tail == capture.head)
+        {
+            if (!capture.on || netTime() - idle >= CAPTURE_IDLE)
+                break;
+            sleep(10);
+            continue;
+        }
+
+        // Reserved, but its frame is still being copied in
+        rec = (struct captureRecord *)
+            (capture.ring + (capture.tail & (CAPTURE_RING_LEN - 1)));
+        if (!rec->ready)
+        {
+            sleep(1);
+            continue;
+        }
+
+        if (rec->type != CAPTURE_PAD)
+        {
+            recHdr.sec = rec->sec;
+            recHdr.usec = rec->usec;
+            recHdr.inclLen = rec->capLen;
+            recHdr.origLen = rec->origLen;
+            captureUart(ucsr, &recHdr, sizeof(recHdr));
+            captureUart(ucsr, rec->data, rec->capLen);
+            capture.dumped++;
+            count++;
+        }
+
+        // Only this reader moves the tail
+        capture.tail += rec->len;
+        idle = netTime();
+    }
+
+    ucsr->ier = ier;
+
+    return count;
+}
+
+
+/**
+ * Write bytes to a UART without the tty's newline translation, a FIFO
+ * at a time
+ * @param ucsr UART control and status registers
+ * @param buf  bytes to write
+ * @param len  count of bytes
+ */
+void captureUart(struct uart_csreg *ucsr, const void *buf, int len)
+{
+    const uchar *p = (const uchar *) buf;
+    int i, n;
+
+    while (len > 0)
+    {
+        while (!(ucsr->lsr & UART_LSR_THRE))
+            ;
+        n = (len < UART_FIFO_LEN) ? len : UART_FIFO_LEN;
+        for (i = 0; i < n; i++)
+            ucsr->thr = p[i];
+        p += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,276 @@
+/**
+ * @file dcache.c
+ * @provides dcacheMode, dcacheInvalidate, dcacheWriteback, dcacheRxInit,
+ *           dcacheRxRefill, dcacheRxReturn, dcacheRxFrame, and dcacheTxFrame
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <dcache.h>
+
+/* Global D-cache maintenance state definition */
+struct dcacheInfo dcache;
+
+/** dcacheLine - run a CACHE instruction on the line holding an address
+ *  @param op   cache operation from mips.h
+ *  @param addr KSEG0 address
+ */
+#define dcacheLine(op, addr) \
+    asm volatile ("cache %0, 0(%1)" : : "i" (op), "r" (addr) : "memory")
+
+/** dcacheRxHead - end of what the CPU reads of a receive buffer before
+ *  it takes the frame: the pool header, the buffer's own fields, and the
+ *  rxHeader and VLAN tag rxPackets checks. pkt->data is only set once
+ *  allocRxBuffer has taken the buffer.
+ *  @param ethptr ether device the buffer belongs to
+ *  @param pkt    packet buffer
+ */
+#define dcacheRxHead(ethptr, pkt) \
+    ((ulong) ((pkt) + 1) + (ethptr)->rxOffset + ETH_HEADER_LEN + ETH_VLAN_LEN)
+
+
+/**
+ * Choose how packet buffers are kept coherent with the DMA engine.
+ * Receive buffers are invalidated as they are returned, by the mode
+ * then in force, so choose before the device is opened.
+ * @param mode DCACHE_UNCACHED, DCACHE_PERBUF or DCACHE_BATCHED
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall dcacheMode(int mode)
+{
+    if (mode != DCACHE_UNCACHED && mode != DCACHE_PERBUF &&
+        mode != DCACHE_BATCHED)
+        return SYSERR;
+
+    dcache.mode = mode;
+    return OK;
+}
+
+
+/**
+ * Invalidate the D-cache lines over a range, so the next reads come
+ * from memory. Lines only partly in the range are written back first,
+ * since the rest of them may be someone else's data.
+ * @param addr start of the range, a KSEG0 address
+ * @param len length of the range in bytes
+ * @return count of lines touched
+ */
+ulong dcacheInvalidate(void *addr, ulong len)
+{
+    ulong line, first, end, lines;
+
+    if (len == 0)
+        return 0;
+
+    first = (ulong) addr & ~(D_CACHE_LINE - 1);
+    end = (ulong) addr + len;
+    lines = 0;
+
+    for (line = first; line < end; line += D_CACHE_LINE)
+    {
+        if (line < (ulong) addr || line + D_CACHE_LINE > end)
+            dcacheLine(HIT_WRITEBACK_INV_D, line);
+        else
+            dcacheLine(HIT_INVALIDATE_D, line);
+        lines++;
+    }
+
+    return lines;
+}
+
+
+/**
+ * Write back and invalidate the D-cache lines over a range, so the DMA
+ * engine reads what the CPU wrote. Waits for the writes to reach memory.
+ * @param addr start of the range, a KSEG0 address
+ * @param len length of the range in bytes
+ * @return count of lines touched
+ */
+ulong dcacheWriteback(void *addr, ulong len)
+{
+    ulong line, end, lines;
+
+    if (len == 0)
+        return 0;
+
+    end = (ulong) addr + len;
+    lines = 0;
+
+    for (line = (ulong) addr & ~(D_CACHE_LINE - 1); line < end;
+         line += D_CACHE_LINE)
+    {
+        dcacheLine(HIT_WRITEBACK_INV_D, line);
+        lines++;
+    }
+    asm volatile ("sync" : : : "memory");
+
+    return lines;
+}
+
+
+/**
+ * Start an ether device's receive buffers with none of their lines in
+ * the D-cache. Buffers on the rxRing may already hold frames, so their
+ * head lines are dropped rather than written back, and the fields
+ * allocRxBuffer stored there are stored again through KSEG1. Free
+ * buffers of the input pool are the CPU's and are written back whole.
+ * Caution: This function must be called with interrupts disabled.
+ * @param ethptr ether device, open
+ * @return count of lines touched
+ */
+ulong dcacheRxInit(struct ether *ethptr)
+{
+    struct poolbuf *hdr = NULL;
+    struct ethPktBuffer *pkt = NULL;
+    struct poolbuf saveHdr;
+    struct ethPktBuffer savePkt;
+    ulong slot, line, end, lines, size;
+
+    if (ethptr == NULL || isbadpool(ethptr->inPool))
+        return 0;
+
+    lines = 0;
+    for (slot = 0; slot < ethptr->rxPending; slot++)
+    {
+        pkt = ethptr->rxBufs[slot];
+        if (pkt == NULL)
+            continue;
+        hdr = (struct poolbuf *) pkt - 1;
+
+        saveHdr = *hdr;
+        savePkt = *pkt;
+        end = (ulong) (pkt + 1) + ETH_RX_BUF_SIZE;
+        for (line = (ulong) hdr & ~(D_CACHE_LINE - 1);
+             line + D_CACHE_LINE <= end; line += D_CACHE_LINE)
+        {
+            dcacheLine(HIT_INVALIDATE_D, line);
+            lines++;
+        }
+        *(struct poolbuf *) dcacheKseg1(hdr) = saveHdr;
+        *(struct ethPktBuffer *) dcacheKseg1(pkt) = savePkt;
+    }
+
+    size = sizeof(struct poolbuf) + roundword(bfptab[ethptr->inPool].bufsize);
+    for (hdr = bfptab[ethptr->inPool].next; hdr != NULL; hdr = hdr->next)
+        lines += dcacheWriteback((void *) hdr, size);
+
+    return lines;
+}
+
+
+/**
+ * Write back and invalidate the head lines of the buffers rxPackets has
+ * just put on the rxRing. bufget and allocRxBuffer leave them dirty, and
+ * one evicted after the DMA engine writes the rxHeader would overwrite
+ * it; the DMA engine does not reach a refilled slot until the ring
+ * wraps, so writing them back now is safe.
+ * Caution: This function must be called with interrupts disabled.
+ * @param ethptr ether device just harvested
+ * @param first ethptr->rxHead before the harvest
+ * @return count of buffers written back
+ */
+int dcacheRxRefill(struct ether *ethptr, ulong first)
+{
+    struct ethPktBuffer *pkt = NULL;
+    ulong slot, head;
+    int bufs = 0;
+
+    if (ethptr == NULL || ethptr->rxPending == 0)
+        return 0;
+
+    for (slot = first; slot != ethptr->rxHead;
+         slot = (slot + 1) % ethptr->rxPending)
+    {
+        pkt = ethptr->rxBufs[slot];
+        if (pkt == NULL)
+            continue;
+
+        head = (ulong) ((struct poolbuf *) pkt - 1);
+        dcacheWriteback((void *) head, dcacheRxHead(ethptr, pkt) - head);
+        bufs++;
+    }
+
+    return bufs;
+}
+
+
+/**
+ * Invalidate the lines the CPU may hold of a receive buffer before it
+ * goes back to the input pool, so none are left to be read stale, or
+ * evicted over the next frame, once the DMA engine has it again.
+ * Batched mode invalidates the lines the frame occupies; per buffer
+ * mode the whole buffer; uncached mode read the frame through KSEG1.
+ * The buffer is the CPU's until allocRxBuffer posts it, so lines only
+ * partly in the range are written back.
+ * @param pkt packet buffer from etherReadBuf
+ * @return count of lines touched
+ */
+ulong dcacheRxReturn(struct ethPktBuffer *pkt)
+{
+    ulong len, lines;
+
+    if (pkt == NULL || dcache.mode == DCACHE_UNCACHED)
+        return 0;
+
+    if (dcache.mode == DCACHE_BATCHED)
+    {
+        len = (ulong) (pkt->data - pkt->buf) + pkt->length + ETH_CRC_LEN;
+        if (len > ETH_RX_BUF_SIZE)
+            len = ETH_RX_BUF_SIZE;
+    }
+    else
+        len = ETH_RX_BUF_SIZE;
+
+    lines = dcacheInvalidate((void *) pkt->buf, len);
+    dcache.rxFrames++;
+    dcache.rxLines += lines;
+
+    return lines;
+}
+
+
+/**
+ * Get where to parse a received frame. The cached modes parse in
+ * KSEG0, kept coherent by dcacheRxReturn; uncached mode parses through
+ * KSEG1.
+ * @param pkt packet buffer from etherReadBuf
+ * @return address of the frame to parse
+ */
+void *dcacheRxFrame(struct ethPktBuffer *pkt)
+{
+    if (dcache.mode == DCACHE_UNCACHED)
+        return dcacheKseg1(pkt->data);
+
+    return (void *) pkt->data;
+}
+
+
+/**
+ * Write back a frame built in a KSEG0 transmit buffer before it is
+ * posted. Batched mode writes back only the lines the frame occupies;
+ * per buffer mode writes back the whole buffer.
+ * @param pkt packet buffer from etherGetBuf
+ * @param len length of the frame at pkt->data
+ * @return count of lines written back
+ */
+ulong dcacheTxFrame(struct ethPktBuffer *pkt, ulong len)
+{
+    ulong lines;
+
+    // Built through KSEG1, already in memory
+    if (((ulong) pkt & KSEG1_BASE) == KSEG1_BASE)
+        return 0;
+
+    if (dcache.mode == DCACHE_BATCHED)
+        lines = dcacheWriteback((void *) pkt->data, len);
+    else
+        lines = dcacheWriteback((void *) pkt->buf, ETH_TX_BUF_SIZE);
+
+    dcache.txFrames++;
+    dcache.txLines += lines;
+
+    return lines;
+}
@@ -0,0 +1,508 @@
+/**
+ * @file dhcp.c
+ * @provides dhcpInit and the DHCP client process
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/10/2016       */
+
+#include <xinu.h>
+#include <network.h>
+#include <udp.h>
+#include <dhcp.h>
+
+/* Global DHCP client information definition */
+struct dhcpInfo dhcp;
+
+/* Private/helper functions */
+ipaddr dhcpNvramAddr(char *name);
+int dhcpExchange(int sd, uchar type, ipaddr ciaddr, ipaddr reqAddr,
+                 ipaddr serverId, ipaddr dst, int tries,
+                 struct dhcpLease *reply);
+syscall dhcpSend(int sd, uchar type, ipaddr ciaddr, ipaddr reqAddr,
+                 ipaddr serverId, ipaddr dst);
+int dhcpParse(struct dhcpgram *dhcpP, int len, struct dhcpLease *reply);
+void dhcpBind(struct dhcpLease *lease);
+void dhcpUnbind(void);
+void dhcpSetState(uchar state);
+
+
+/**
+ * Initialize the DHCP client and start its process. A lease cached in
+ * NVRAM is put to use at once, so the network is usable before any
+ * DHCP traffic; the client then confirms it with an INIT-REBOOT
+ * REQUEST instead of a full DISCOVER/OFFER exchange. Without a cached
+ * lease the client starts with a DISCOVER and the static address is
+ * used until a server answers.
+ * @return OK for success, SYSERR if the client could not be started
+ */
+syscall dhcpInit(void)
+{
+    ipaddr addr;
+
+    dhcp.sema = semcreate(1);
+    if (dhcp.sema == SYSERR)
+        return SYSERR;
+
+    /* Create DHCP client */
+    dhcp.cId = create((void *)dhcpClient, INITSTK, 3, "DHCP_CLIENT", 0);
+    if (dhcp.cId == SYSERR)
+    {
+        semfree(dhcp.sema);
+        return SYSERR;
+    }
+
+    dhcp.flags = 0;
+    dhcp.xid = 0;
+    bzero((void *) &dhcp.lease, sizeof(struct dhcpLease));
+    dhcp.boundAt = 0;
+    dhcp.t1 = 0;
+    dhcp.t2 = 0;
+    dhcp.expires = 0;
+    dhcp.startMs = netTime();
+    dhcp.bootMs = 0;
+
+    // Start from the last lease. The static address was never leased,
+    // so it is not asked for by INIT-REBOOT.
+    dhcp.cached = dhcpNvramAddr(DHCP_NVRAM_IPADDR);
+    if (dhcp.cached != IPv4_ADDR_ANY)
+    {
+        net.ipAddr = dhcp.cached;
+        addr = dhcpNvramAddr(DHCP_NVRAM_NETMASK);
+        if (addr != IPv4_ADDR_ANY)
+            net.netmask = addr;
+        addr = dhcpNvramAddr(DHCP_NVRAM_GATEWAY);
+        if (addr != IPv4_ADDR_ANY)
+            net.gateway = addr;
+        dhcp.lease.server = dhcpNvramAddr(DHCP_NVRAM_SERVER);
+        dhcp.state = DHCP_INIT_REBOOT;
+    }
+    else
+        dhcp.state = DHCP_INIT;
+
+    ready(dhcp.cId, 1);
+
+    return OK;
+}
+
+
+/**
+ * DHCP client process: gets a lease, then renews it in the background
+ * at T1 (unicast to the server) and T2 (broadcast) until it runs out
+ */
+void dhcpClient(void)
+{
+    struct dhcpLease reply;
+    ulong now, delay;
+    int sd, type;
+
+    sd = udpBind(DHCP_CLIENT_PORT);
+    if (sd == SYSERR)
+        return;
+
+    while (1)
+    {
+        switch (dhcp.state)
+        {
+        case DHCP_INIT_REBOOT:
+            // Ask to keep the cached address. A server that does not
+            // know it says NAK; if nobody answers we keep using it.
+            type = dhcpExchange(sd, DHCP_MESSAGE_REQUEST, IPv4_ADDR_ANY,
+                                dhcp.cached, IPv4_ADDR_ANY, IPv4_ADDR_BCAST,
+                                DHCP_TRIES, &reply);
+            if (type == DHCP_MESSAGE_ACK)
+                dhcpBind(&reply);
+            else
+            {
+                if (type == DHCP_MESSAGE_NACK)
+                    dhcpUnbind();
+                dhcpSetState(DHCP_INIT);
+            }
+            break;
+
+        case DHCP_INIT:
+            dhcpSetState(DHCP_SELECTING);
+            type = dhcpExchange(sd, DHCP_MESSAGE_DISCOVER, IPv4_ADDR_ANY,
+                                dhcp.cached, IPv4_ADDR_ANY, IPv4_ADDR_BCAST,
+                                DHCP_TRIES, &reply);
+            if (type == DHCP_MESSAGE_OFFER)
+            {
+                wait(dhcp.sema);
+                dhcp.lease = reply;
+                dhcp.state = DHCP_REQUESTING;
+                signal(dhcp.sema);
+            }
+            else
+            {
+                // No server, try again later
+                dhcpSetState(DHCP_INIT);
+                sleep(DHCP_RETRY_MAX);
+            }
+            break;
+
+        case DHCP_REQUESTING:
+            type = dhcpExchange(sd, DHCP_MESSAGE_REQUEST, IPv4_ADDR_ANY,
+                                dhcp.lease.addr, dhcp.lease.server,
+                                IPv4_ADDR_BCAST, DHCP_TRIES, &reply);
+            if (type == DHCP_MESSAGE_ACK)
+                dhcpBind(&reply);
+            else
+                dhcpSetState(DHCP_INIT);
+            break;
+
+        case DHCP_BOUND:
+            sleep(1000);
+            wait(dhcp.sema);
+            if ((dhcp.t1 != 0 && clocktime >= dhcp.t1) ||
+                (dhcp.flags & DHCP_FLAG_RENEW))
+            {
+                dhcp.flags &= ~DHCP_FLAG_RENEW;
+                dhcp.state = DHCP_RENEWING;
+            }
+            signal(dhcp.sema);
+            break;
+
+        case DHCP_RENEWING:
+        case DHCP_REBINDING:
+            // Renew with the server that gave us the lease, then with
+            // any server once T2 has passed
+            type = dhcpExchange(sd, DHCP_MESSAGE_REQUEST, net.ipAddr,
+                                IPv4_ADDR_ANY, IPv4_ADDR_ANY,
+                                (dhcp.state == DHCP_RENEWING &&
+                                 dhcp.lease.server != IPv4_ADDR_ANY) ?
+                                dhcp.lease.server : IPv4_ADDR_BCAST,
+                                1, &reply);
+            if (type == DHCP_MESSAGE_ACK)
+            {
+                dhcpBind(&reply);
+                break;
+            }
+            if (type == DHCP_MESSAGE_NACK ||
+                (dhcp.expires != 0 && clocktime >= dhcp.expires))
+            {
+                dhcpUnbind();
+                dhcpSetState(DHCP_INIT);
+                break;
+            }
+
+            // Wait half the time left to the next deadline (RFC 2131)
+            now = clocktime;
+            if (dhcp.t2 != 0 && now < dhcp.t2)
+                delay = (dhcp.t2 - now) / 2;
+            else
+            {
+                dhcpSetState(DHCP_REBINDING);
+                delay = (dhcp.expires > now) ? (dhcp.expires - now) / 2 : 0;
+            }
+            if (delay < DHCP_RENEW_MIN)
+                delay = DHCP_RENEW_MIN;
+            sleep(delay * 1000);
+            break;
+
+        default:
+            dhcpSetState(DHCP_INIT);
+            break;
+        }
+    }
+}
+
+
+/**
+ * Read an address saved in NVRAM
+ * @param name NVRAM variable
+ * @return address, IPv4_ADDR_ANY if it is not set
+ */
+ipaddr dhcpNvramAddr(char *name)
+{
+    ipaddr addr;
+    char *value;
+
+    value = nvramGet(name);
+    if (value == NULL || SYSERR == dot2ip(value, (uchar *) &addr))
+        return IPv4_ADDR_ANY;
+    return addr;
+}
+
+
+/**
+ * Send a DHCP message and wait for the answer, retransmitting with
+ * exponential backoff. A DISCOVER waits for an OFFER, anything else for
+ * an ACK; a NAK always ends the wait.
+ * @param sd       socket bound to the DHCP client port
+ * @param type     DHCP message type to send
+ * @param ciaddr   our address while renewing, 0 otherwise
+ * @param reqAddr  address to ask for, 0 for none
+ * @param serverId server chosen from an OFFER, 0 for none
+ * @param dst      server address, or IPv4_ADDR_BCAST
+ * @param tries    number of times to send
+ * @param reply    configuration from the answer return value
+ * @return DHCP message type of the answer, TIMEOUT if none came
+ */
+int dhcpExchange(int sd, uchar type, ipaddr ciaddr, ipaddr reqAddr,
+                 ipaddr serverId, ipaddr dst, int tries,
+                 struct dhcpLease *reply)
+{
+    ulong   *buf;
+    uchar   want;
+    ulong   start, elapsed, timeout;
+    int     i, n, got;
+
+    want = (type == DHCP_MESSAGE_DISCOVER) ? DHCP_MESSAGE_OFFER : DHCP_MESSAGE_ACK;
+
+    // One transaction id for all retransmissions
+    dhcp.xid = (IP_LOAD(&net.hwAddr[2]) ^ netTime()) + dhcp.xid;
+
+    buf = (ulong *) netBufGet(NET_POOL_CTL);
+    if (buf == NULL)
+        return TIMEOUT;
+
+    timeout = DHCP_RETRY_FIRST;
+    for (i = 0; i < tries; i++)
+    {
+        if (SYSERR == dhcpSend(sd, type, ciaddr, reqAddr, serverId, dst))
+            break;
+
+        start = netTime();
+        while ((elapsed = netTime() - start) < timeout)
+        {
+            n = udpRecvfrom(sd, (void *) buf, DHCP_RECV_LEN, NULL, NULL,
+                            timeout - elapsed);
+            if (n <= 0)
+                continue;
+
+            got = dhcpParse((struct dhcpgram *) buf, n, reply);
+            if (got == want || got == DHCP_MESSAGE_NACK)
+            {
+                netBufFree((void *) buf);
+                return got;
+            }
+        }
+
+        if (timeout * 2 <= DHCP_RETRY_MAX)
+            timeout *= 2;
+    }
+
+    netBufFree((void *) buf);
+    return TIMEOUT;
+}
+
+
+/**
+ * Build and send a DHCP message from the client port
+ * @param sd       socket bound to the DHCP client port
+ * @param type     DHCP message type
+ * @param ciaddr   our address while renewing, 0 otherwise
+ * @param reqAddr  address to ask for, 0 for none
+ * @param serverId server chosen from an OFFER, 0 for none
+ * @param dst      server address, or IPv4_ADDR_BCAST
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall dhcpSend(int sd, uchar type, ipaddr ciaddr, ipaddr reqAddr,
+                 ipaddr serverId, ipaddr dst)
+{
+    ulong   *buf;
+    struct  dhcpgram *dhcpP = NULL;
+    uchar   *opt;
+    syscall result;
+
+    buf = (ulong *) netBufGet(NET_POOL_CTL);
+    if (buf == NULL)
+        return SYSERR;
+
+    bzero((void *) buf, DHCP_PKT_LEN);
+    dhcpP = (struct dhcpgram *) buf;
+
+    /* Set up DHCP header */
+    dhcpP->opcode = DHCP_OPCODE_REQUEST;
+    dhcpP->htype = DHCP_HTYPE_ETHER;
+    dhcpP->hlen = ETH_ADDR_LEN;
+    dhcpP->id = htonl(dhcp.xid);
+    dhcpP->elapsed = htons((netTime() - dhcp.startMs) / 1000);
+    dhcpP->client = ciaddr;
+    if (ciaddr == IPv4_ADDR_ANY)
+        dhcpP->flags = htons(DHCP_FLAG_BROADCAST);
+    memcpy((void *) dhcpP->hwaddr, (void *) net.hwAddr, ETH_ADDR_LEN);
+
+    /* Options, after the magic cookie */
+    opt = dhcpP->opts;
+    *opt++ = (DHCP_MAGIC_COOKIE >> 24) & 0xFF;
+    *opt++ = (DHCP_MAGIC_COOKIE >> 16) & 0xFF;
+    *opt++ = (DHCP_MAGIC_COOKIE >> 8) & 0xFF;
+    *opt++ = DHCP_MAGIC_COOKIE & 0xFF;
+
+    *opt++ = DHCP_OPTIONS_MESSAGE;
+    *opt++ = 1;
+    *opt++ = type;
+
+    if (reqAddr != IPv4_ADDR_ANY)
+    {
+        *opt++ = DHCP_OPTIONS_REQUESTED_IP;
+        *opt++ = IPv4_ADDR_LEN;
+        IP_STORE(opt, reqAddr);
+        opt += IPv4_ADDR_LEN;
+    }
+
+    if (serverId != IPv4_ADDR_ANY)
+    {
+        *opt++ = DHCP_OPTIONS_SERVER_ID;
+        *opt++ = IPv4_ADDR_LEN;
+        IP_STORE(opt, serverId);
+        opt += IPv4_ADDR_LEN;
+    }
+
+    *opt++ = DHCP_OPTIONS_PARAM_REQ;
+    *opt++ = 3;
+    *opt++ = DHCP_OPTIONS_SUBNET_MASK;
+    *opt++ = DHCP_OPTIONS_ROUTER;
+    *opt++ = DHCP_OPTIONS_LEASETIME;
+
+    *opt = DHCP_OPTIONS_END;
+
+    result = udpSendto(sd, (void *) buf, DHCP_PKT_LEN, dst, DHCP_SERVER_PORT,
+                       IPv4_TOS_INTCNTRL);
+
+    netBufFree((void *) buf);
+    return result;
+}
+
+
+/**
+ * Check that a message answers our transaction and pull the
+ * configuration out of its options
+ * @param dhcpP received DHCP message, word aligned
+ * @param len   length of the message in bytes
+ * @param reply configuration return value
+ * @return DHCP message type, SYSERR if the message is not for us
+ */
+int dhcpParse(struct dhcpgram *dhcpP, int len, struct dhcpLease *reply)
+{
+    uchar *opt, *end;
+    uchar code, optLen;
+    int type = SYSERR;
+
+    if (len < DHCP_HDR_LEN + 4 || dhcpP->opcode != DHCP_OPCODE_REPLY ||
+        ntohl(dhcpP->id) != dhcp.xid ||
+        memcmp((void *) dhcpP->hwaddr, (void *) net.hwAddr, ETH_ADDR_LEN) != 0)
+        return SYSERR;
+
+    opt = dhcpP->opts;
+    end = (uchar *) dhcpP + len;
+    if (opt[0] != ((DHCP_MAGIC_COOKIE >> 24) & 0xFF) ||
+        opt[1] != ((DHCP_MAGIC_COOKIE >> 16) & 0xFF) ||
+        opt[2] != ((DHCP_MAGIC_COOKIE >> 8) & 0xFF) ||
+        opt[3] != (DHCP_MAGIC_COOKIE & 0xFF))
+        return SYSERR;
+    opt += 4;
+
+    bzero((void *) reply, sizeof(struct dhcpLease));
+    reply->addr = dhcpP->yourIP;
+    reply->server = dhcpP->server;
+
+    while (opt < end && *opt != DHCP_OPTIONS_END)
+    {
+        code = *opt++;
+        if (code == DHCP_OPTIONS_PAD)
+            continue;
+        if (opt >= end || opt + 1 + *opt > end)
+            break;
+        optLen = *opt++;
+
+        switch (code)
+        {
+        case DHCP_OPTIONS_MESSAGE:
+            if (optLen >= 1)
+                type = opt[0];
+            break;
+        case DHCP_OPTIONS_SERVER_ID:
+            if (optLen >= IPv4_ADDR_LEN)
+                reply->server = IP_LOAD(opt);
+            break;
+        case DHCP_OPTIONS_SUBNET_MASK:
+            if (optLen >= IPv4_ADDR_LEN)
+                reply->netmask = IP_LOAD(opt);
+            break;
+        case DHCP_OPTIONS_ROUTER:
+            if (optLen >= IPv4_ADDR_LEN)
+                reply->gateway = IP_LOAD(opt);
+            break;
+        case DHCP_OPTIONS_LEASETIME:
+            if (optLen >= 4)
+                reply->leaseTime = ((ulong) opt[0] << 24) | ((ulong) opt[1] << 16) |
+                                   ((ulong) opt[2] << 8) | opt[3];
+            break;
+        }
+        opt += optLen;
+    }
+
+    return type;
+}
+
+
+/**
+ * Take the configuration from an ACK and set the lease timers
+ * @param lease configuration from the server
+ */
+void dhcpBind(struct dhcpLease *lease)
+{
+    ulong now = clocktime;
+
+    wait(dhcp.sema);
+
+    dhcp.lease = *lease;
+    net.ipAddr = lease->addr;
+    if (lease->netmask != IPv4_ADDR_ANY)
+        net.netmask = lease->netmask;
+    if (lease->gateway != IPv4_ADDR_ANY)
+        net.gateway = lease->gateway;
+    dhcp.cached = lease->addr;
+
+    // T1 at half the lease, T2 at 7/8 (RFC 2131); an infinite lease
+    // is never renewed
+    dhcp.boundAt = now;
+    if (lease->leaseTime == 0xFFFFFFFF)
+    {
+        dhcp.t1 = 0;
+        dhcp.t2 = 0;
+        dhcp.expires = 0;
+    }
+    else
+    {
+        dhcp.t1 = now + lease->leaseTime / 2;
+        dhcp.t2 = now + lease->leaseTime - lease->leaseTime / 8;
+        dhcp.expires = now + lease->leaseTime;
+    }
+
+    if (dhcp.bootMs == 0)
+        dhcp.bootMs = netTime() - dhcp.startMs;
+    dhcp.state = DHCP_BOUND;
+
+    signal(dhcp.sema);
+}
+
+
+/**
+ * Give up our address after a NAK or an expired lease
+ */
+void dhcpUnbind(void)
+{
+    wait(dhcp.sema);
+    net.ipAddr = IPv4_ADDR_ANY;
+    dhcp.cached = IPv4_ADDR_ANY;
+    dhcp.t1 = 0;
+    dhcp.t2 = 0;
+    dhcp.expires = 0;
+    signal(dhcp.sema);
+}
+
+
+/**
+ * Move the client to a new state
+ * @param state DHCP_INIT ... DHCP_REBINDING
+ */
+void dhcpSetState(uchar state)
+{
+    wait(dhcp.sema);
+    dhcp.state = state;
+    signal(dhcp.sema);
+}
@@ -0,0 +1,152 @@
+/**
+ * @file etherPoll.c
+ * @provides etherPollInit, etherPollInterrupt, and etherPoll
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <dcache.h>
+
+/* Global receive polling state definition */
+struct etherPollInfo ethPoll;
+
+
+/**
+ * Switch an open ether device to interrupt-then-poll receive. The first
+ * receive interrupt harvests the ring and masks receive interrupts; the
+ * reader then polls the ring with etherPoll until it runs dry, and only
+ * then are receive interrupts taken again.
+ * @param devptr ether device table entry
+ * @return OK for success, SYSERR if the device is not open
+ */
+devcall etherPollInit(device *devptr)
+{
+    struct ether *ethptr = NULL;
+    irqmask im;
+
+    if (devptr == NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state != ETH_STATE_UP || ethptr->csr == NULL)
+        return SYSERR;
+
+    im = disable();
+    bzero((void *) &ethPoll, sizeof(ethPoll));
+    ethPoll.ethptr = ethptr;
+
+    // From here on each harvest writes back the buffers it posts, and
+    // etherReturnBuf invalidates each one read; start with none cached
+    dcacheRxInit(ethptr);
+
+    // Run in front of the driver's handler, which still does TX and
+    // error interrupts
+    interruptVector[IRQ_ETH0] = etherPollInterrupt;
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Ether interrupt handler for polled receive. A receive interrupt
+ * harvests the frames the DMA engine has finished and masks further
+ * receive interrupts; everything else goes to etherInterrupt. After a
+ * TX interrupt, ethTx.txDone is called to refill the ring.
+ */
+interrupt etherPollInterrupt(void)
+{
+    struct ether *ethptr = ethPoll.ethptr;
+    struct bcm4713 *csr = NULL;
+    ulong status;
+    ulong first;
+    ushort before;
+
+    if (ethptr == NULL || (csr = ethptr->csr) == NULL)
+    {
+        etherInterrupt();
+        return;
+    }
+
+    status = csr->interruptStatus & csr->interruptMask;
+    if (status & ISTAT_RX)
+    {
+        // Mask first, then acknowledge, so a frame that lands in
+        // between still latches the status bit for the rearm
+        csr->interruptMask &= ~ISTAT_RX;
+        csr->interruptStatus = ISTAT_RX;
+        ethPoll.masked = TRUE;
+
+        ethptr->rxirq++;
+        ethPoll.irqs++;
+        before = ethptr->icount;
+        first = ethptr->rxHead;
+        rxPackets(ethptr, csr);
+        dcacheRxRefill(ethptr, first);
+        ethPoll.irqFrames += ethptr->icount - before;
+    }
+
+    if (status & ~ISTAT_RX)
+        etherInterrupt();
+
+    // Let whoever is holding frames back refill the TX ring
+    if ((status & ISTAT_TX) && ethPoll.ethptr->state == ETH_STATE_UP &&
+        ethTx.txDone != NULL)
+        (*ethTx.txDone)();
+}
+
+
+/**
+ * Poll the receive ring while receive interrupts are masked. The ring
+ * is harvested when the input queue is empty, or after budget frames
+ * have been read since the last harvest; a harvest that finds nothing
+ * with the queue empty unmasks receive interrupts again.
+ * Readers call this before each read.
+ * @param devptr ether device table entry
+ * @param budget frames read between harvests while the queue has frames
+ * @return frames harvested, 0 if none or not polling
+ */
+int etherPoll(device *devptr, int budget)
+{
+    struct ether *ethptr = ethPoll.ethptr;
+    ulong first;
+    ushort before;
+    int got;
+    irqmask im;
+
+    if (devptr == NULL || ethptr == NULL ||
+        ethptr != (struct ether *) devptr->dvioblk)
+        return 0;
+
+    im = disable();
+    if (!ethPoll.masked ||
+        (ethptr->icount > 0 && ++ethPoll.credit < budget))
+    {
+        restore(im);
+        return 0;
+    }
+    ethPoll.credit = 0;
+
+    before = ethptr->icount;
+    first = ethptr->rxHead;
+    rxPackets(ethptr, ethptr->csr);
+    dcacheRxRefill(ethptr, first);
+    got = ethptr->icount - before;
+
+    ethPoll.polls++;
+    ethPoll.polledFrames += got;
+
+    // Drained: hand the ring back to the interrupt handler
+    if (got == 0 && ethptr->icount == 0)
+    {
+        ethPoll.masked = FALSE;
+        ethPoll.rearms++;
+        ethptr->csr->interruptMask |= ISTAT_RX;
+    }
+    restore(im);
+
+    return got;
+}
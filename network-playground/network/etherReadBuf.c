@@ -0,0 +1,193 @@
+/**
+ * @file etherReadBuf.c
+ * @provides etherReadBuf, etherReturnBuf, etherRxAlign,
+ *           etherReserveBufs, and etherCloseBufs
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/13/2016       */
+
+#include <xinu.h>
+#include <dcache.h>
+
+/* Global spare receive buffer definition */
+struct etherSpareInfo ethSpare;
+
+/**
+ * Take the next received frame from an ether device without copying
+ * it. The frame stays in the buffer the DMA engine wrote, at
+ * (*pkt)->data, and is on loan until etherReturnBuf gives it back.
+ * @param devptr ether device table entry
+ * @param pkt receives the loaned packet buffer, NULL if none
+ * @return frame length without the CRC, SYSERR for syntax error
+ */
+devcall etherReadBuf(device *devptr, struct ethPktBuffer **pkt)
+{
+    struct ether *ethptr = NULL;
+    struct rxHeader *rxHdr = NULL;
+    irqmask im;
+
+    if (devptr == NULL || pkt == NULL)
+        return SYSERR;
+
+    *pkt = NULL;
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state != ETH_STATE_UP)
+        return SYSERR;
+
+    // Same input queue etherRead takes from; the interrupt handler has
+    // already put a fresh buffer in the frame's rxRing slot
+    wait(ethptr->isema);
+
+    im = disable();
+    *pkt = ethptr->in[ethptr->istart];
+    ethptr->in[ethptr->istart] = NULL;
+    ethptr->istart = (ethptr->istart + 1) % ETH_IBLEN;
+    ethptr->icount--;
+    restore(im);
+
+    if (*pkt == NULL)
+        return 0;
+
+    // The DMA engine writes the frame length, CRC included, in the
+    // receive header at the start of the buffer
+    rxHdr = (struct rxHeader *) (*pkt)->buf;
+    (*pkt)->length = rxHdr->length - ETH_CRC_LEN;
+
+    return (*pkt)->length;
+}
+
+
+/**
+ * Give a loaned receive buffer back to an ether device. It goes back
+ * to the driver's input pool, where allocRxBuffer takes it to refill
+ * the rxRing; first the lines the CPU read of it are invalidated, since
+ * the DMA engine may have it again at the next harvest. A transmit
+ * buffer from etherGetBuf that will not be sent goes back to the output
+ * pool as it is.
+ * @param devptr ether device table entry
+ * @param pkt packet buffer from etherReadBuf or etherGetBuf
+ * @return OK for success, SYSERR for syntax error
+ */
+devcall etherReturnBuf(device *devptr, struct ethPktBuffer *pkt)
+{
+    struct ether *ethptr = NULL;
+
+    if (devptr == NULL || pkt == NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr != NULL &&
+        ((struct poolbuf *) pkt - 1)->poolid == ethptr->inPool)
+        dcacheRxReturn(pkt);
+
+    return buffree((void *) pkt);
+}
+
+
+/**
+ * Move where the DMA engine writes received frames, so the header
+ * after the Ethernet header can be word aligned. etherOpen programs the
+ * receive offset and allocRxBuffer points each buffer's data past it,
+ * so this must be called before the device is opened.
+ * @param devptr ether device table entry
+ * @param align bytes to leave between the receive header and the frame
+ * @return OK for success, SYSERR if the device is already open
+ */
+devcall etherRxAlign(device *devptr, int align)
+{
+    struct ether *ethptr = NULL;
+
+    if (devptr == NULL || align < 0 || align >= 4)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state == ETH_STATE_UP)
+        return SYSERR;
+
+    // An untagged full size frame and its CRC still fit in the
+    // receive buffer behind up to 4 bytes of padding
+    ethptr->rxOffset = sizeof(struct rxHeader) + align;
+
+    return OK;
+}
+
+
+/**
+ * Add buffers to an open ether device's input pool to cover the
+ * buffers its readers hold on loan. The pool is sized for a full rxRing
+ * plus a full input queue, and the interrupt handler cannot wait for a
+ * buffer, so every loan must be matched by a spare. bfpfree only gives
+ * back the pool's own block, so the spares are carved from one block of
+ * their own and the device's close is pointed at etherCloseBufs, which
+ * frees it.
+ * @param devptr ether device table entry
+ * @param count number of buffers to add, once per open
+ * @return OK for success, SYSERR if out of memory or already reserved
+ */
+devcall etherReserveBufs(device *devptr, int count)
+{
+    struct ether *ethptr = NULL;
+    struct poolbuf *hdr = NULL;
+    uchar *mem = NULL;
+    ulong size;
+    int i;
+
+    if (devptr == NULL || count <= 0 || ethSpare.mem != NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state != ETH_STATE_UP ||
+        isbadpool(ethptr->inPool))
+        return SYSERR;
+
+    size = sizeof(struct poolbuf) + roundword(bfptab[ethptr->inPool].bufsize);
+    mem = (uchar *) getmem(size * count);
+    if (mem == (uchar *) SYSERR || mem == NULL)
+        return SYSERR;
+
+    ethSpare.mem = (void *) mem;
+    ethSpare.size = size * count;
+    ethSpare.count = count;
+    devptr->dvclose = (void *) etherCloseBufs;
+
+    // Nothing of the heap's last use may be left dirty over them
+    dcacheWriteback((void *) mem, size * count);
+
+    for (i = 0; i < count; i++)
+    {
+        // Mark it as a taken buffer of the pool so buffree accepts it
+        hdr = (struct poolbuf *) (mem + i * size);
+        hdr->next = hdr;
+        hdr->poolid = ethptr->inPool;
+        buffree((void *) (hdr + 1));
+    }
+
+    return OK;
+}
+
+
+/**
+ * Close an ether device and free the spares etherReserveBufs added to
+ * its input pool. The pool is gone once etherClose returns, so nothing
+ * can still hold them.
+ * @param devptr ether device table entry
+ * @return OK for success, SYSERR if etherClose failed
+ */
+devcall etherCloseBufs(device *devptr)
+{
+    if (SYSERR == etherClose(devptr))
+        return SYSERR;
+
+    devptr->dvclose = (void *) etherClose;
+    if (ethSpare.mem != NULL)
+    {
+        freemem(ethSpare.mem, ethSpare.size);
+        ethSpare.mem = NULL;
+        ethSpare.size = 0;
+        ethSpare.count = 0;
+    }
+
+    return OK;
+}
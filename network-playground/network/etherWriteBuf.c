@@ -0,0 +1,236 @@
+/**
+ * @file etherWriteBuf.c
+ * @provides etherGetBuf, etherWriteBuf, etherTxReclaim, etherTxLimit,
+ *           and etherTxSpace
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/13/2016       */
+
+#include <xinu.h>
+#include <dcache.h>
+
+/* Global transmit completion state definition */
+struct etherTxInfo ethTx;
+
+
+/**
+ * Take a transmit buffer from an ether device, so a frame can be built
+ * where the DMA engine will read it. Like etherWrite, this waits for the
+ * TX completion interrupt to free a buffer when the device has none.
+ * In uncached mode the buffer is reached through KSEG1, so writes to it
+ * need no cache maintenance, but reads from it are slow; otherwise it
+ * is in KSEG0 and etherWriteBuf writes the frame back.
+ * @param devptr ether device table entry
+ * @param headroom bytes to skip before the frame at data
+ * @return packet buffer, NULL for syntax error
+ */
+struct ethPktBuffer *etherGetBuf(device *devptr, int headroom)
+{
+    struct ether *ethptr = NULL;
+    struct ether *phyptr = NULL;
+    struct ethPktBuffer *pkt = NULL;
+
+    if (devptr == NULL || headroom < 0 || headroom >= 4)
+        return NULL;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state != ETH_STATE_UP ||
+        ethptr->phy == NULL)
+        return NULL;
+
+    phyptr = (struct ether *) ethptr->phy->dvioblk;
+    if (phyptr == NULL || phyptr->state != ETH_STATE_UP)
+        return NULL;
+
+    // Frames posted without IOC are only reclaimed here, so a sender
+    // gets back its own buffers before it has to wait for one
+    etherTxReclaim(devptr);
+
+    pkt = (struct ethPktBuffer *) bufget(phyptr->outPool);
+    if (pkt == (struct ethPktBuffer *) SYSERR || pkt == NULL)
+        return NULL;
+
+    // Same layout etherWrite gives its buffers
+    if (dcache.mode == DCACHE_UNCACHED)
+        pkt = (struct ethPktBuffer *) dcacheKseg1(pkt);
+    pkt->buf = (uchar *) (pkt + 1);
+    pkt->data = pkt->buf + headroom;
+    pkt->length = 0;
+
+    return pkt;
+}
+
+
+/**
+ * Post a frame built in a buffer from etherGetBuf to the TX DMA ring.
+ * The buffer is freed once the frame is sent, by the TX completion
+ * interrupt or by a later etherGetBuf, so the caller must not touch it
+ * after this returns. Completion interrupts are only asked for on the
+ * first frame into an idle ring, every ETH_TX_IOC_EVERY frames, on the
+ * frame that brings the ring to the etherTxLimit, and when the ring is
+ * within ETH_TX_IOC_SLACK descriptors of full.
+ * @param devptr ether device table entry
+ * @param pkt packet buffer holding the frame at data
+ * @param len length of the frame in bytes
+ * @return len for success, SYSERR for syntax error
+ */
+devcall etherWriteBuf(device *devptr, struct ethPktBuffer *pkt, ulong len)
+{
+    struct ether *ethptr = NULL;
+    struct ether *phyptr = NULL;
+    ulong control, tail, inFlight;
+    irqmask im;
+
+    if (devptr == NULL || pkt == NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->state != ETH_STATE_UP ||
+        ethptr->csr == NULL || ethptr->phy == NULL)
+        return SYSERR;
+
+    phyptr = (struct ether *) ethptr->phy->dvioblk;
+    if (phyptr == NULL || phyptr->state != ETH_STATE_UP)
+        return SYSERR;
+
+    if (len < ETH_HEADER_LEN ||
+        len > ETH_TX_BUF_SIZE - (ulong) (pkt->data - pkt->buf))
+        return SYSERR;
+
+    pkt->length = len;
+    dcacheTxFrame(pkt, len);
+
+    // Post the buffer the way etherWrite posts its copy; the descriptor
+    // points at the frame itself rather than the start of the buffer
+    im = disable();
+    tail = phyptr->txTail;
+    phyptr->txBufs[tail] = pkt;
+
+    control = (len & ETH_DESC_CTRL_LEN) | ETH_DESC_CTRL_SOF |
+              ETH_DESC_CTRL_EOF;
+    inFlight = (tail + phyptr->txPending - phyptr->txHead) % phyptr->txPending;
+    if (inFlight == 0 || ++ethTx.sinceIoc >= ETH_TX_IOC_EVERY ||
+        (ethTx.limit > 0 && inFlight + 1 >= ethTx.limit) ||
+        inFlight + ETH_TX_IOC_SLACK >= phyptr->txPending)
+    {
+        control |= ETH_DESC_CTRL_IOC;
+        ethTx.sinceIoc = 0;
+        ethTx.iocs++;
+    }
+    ethTx.posted++;
+    if (tail == phyptr->txPending - 1)
+        control |= ETH_DESC_CTRL_EOT;
+    phyptr->txRing[tail].control = control;
+    phyptr->txRing[tail].address = (ulong) pkt->data & PMEM_MASK;
+
+    phyptr->txTail = (tail + 1) % phyptr->txPending;
+    ethptr->csr->dmaTxLast = phyptr->txTail * sizeof(struct dmaDescriptor);
+    restore(im);
+
+    return len;
+}
+
+
+/**
+ * Free the buffers of frames the DMA engine has finished sending. The
+ * TX completion interrupt does the same, but only follows descriptors
+ * posted with IOC.
+ * @param devptr ether device table entry
+ * @return count of buffers freed, SYSERR for syntax error
+ */
+int etherTxReclaim(device *devptr)
+{
+    struct ether *ethptr = NULL;
+    struct ether *phyptr = NULL;
+    ulong head, freed;
+    irqmask im;
+
+    if (devptr == NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->csr == NULL || ethptr->phy == NULL)
+        return SYSERR;
+
+    phyptr = (struct ether *) ethptr->phy->dvioblk;
+    if (phyptr == NULL || phyptr->state != ETH_STATE_UP)
+        return SYSERR;
+
+    im = disable();
+    head = phyptr->txHead;
+    txPackets(phyptr, ethptr->csr);
+    freed = (phyptr->txHead + phyptr->txPending - head) % phyptr->txPending;
+    if (freed > 0)
+    {
+        ethTx.reclaims++;
+        ethTx.reclaimed += freed;
+    }
+    restore(im);
+
+    return freed;
+}
+
+
+/**
+ * Set how many frames callers that check etherTxSpace keep in the TX
+ * DMA ring. A short ring lets a caller hold frames back and choose the
+ * order they go out in. The frame that reaches the limit always asks
+ * for a completion interrupt, so space always opens up again.
+ * @param devptr ether device table entry
+ * @param limit frames in flight, 0 for the whole ring
+ * @return OK for success, SYSERR for syntax error
+ */
+devcall etherTxLimit(device *devptr, int limit)
+{
+    struct ether *ethptr = NULL;
+    struct ether *phyptr = NULL;
+
+    if (devptr == NULL || limit < 0)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->phy == NULL)
+        return SYSERR;
+
+    phyptr = (struct ether *) ethptr->phy->dvioblk;
+    if (phyptr == NULL || phyptr->state != ETH_STATE_UP ||
+        limit >= phyptr->txPending)
+        return SYSERR;
+
+    ethTx.limit = limit;
+    return OK;
+}
+
+
+/**
+ * Count the frames that may still be posted before the TX DMA ring
+ * reaches its etherTxLimit. Frames sent but not yet reclaimed still
+ * count against it.
+ * @param devptr ether device table entry
+ * @return free descriptors under the limit, SYSERR for syntax error
+ */
+int etherTxSpace(device *devptr)
+{
+    struct ether *ethptr = NULL;
+    struct ether *phyptr = NULL;
+    ulong inFlight, limit;
+
+    if (devptr == NULL)
+        return SYSERR;
+
+    ethptr = (struct ether *) devptr->dvioblk;
+    if (ethptr == NULL || ethptr->phy == NULL)
+        return SYSERR;
+
+    phyptr = (struct ether *) ethptr->phy->dvioblk;
+    if (phyptr == NULL || phyptr->state != ETH_STATE_UP)
+        return SYSERR;
+
+    inFlight = (phyptr->txTail + phyptr->txPending - phyptr->txHead) %
+               phyptr->txPending;
+    limit = (ethTx.limit > 0) ? ethTx.limit : phyptr->txPending - 1;
+
+    return (inFlight < limit) ? limit - inFlight : 0;
+}
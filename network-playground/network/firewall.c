@@ -0,0 +1,632 @@
+/**
+ * @file firewall.c
+ * @provides fwInit, fwAdd, fwRemove, fwLoad, fwPolicy, fwMatch, fwKeys,
+ *           fwLookup, and fwCompile
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <firewall.h>
+
+/* Global firewall definition */
+struct fwInfo fw;
+
+/* Largest value of each field, by FW_DIM_* */
+static const ulong fwDimMax[FW_DIMS] = {
+    0xFFFFFFFF, 0xFFFFFFFF, 0xFF, FW_PORT_MAX, FW_PORT_MAX
+};
+
+/* Private/helper functions */
+bool fwCheck(const struct fwRule *rule);
+void fwInstall(struct fwTable *next, int pos, int delta);
+void fwRange(const struct fwRule *rule, int dim, ulong *lo, ulong *hi);
+int fwSort(ulong *vals, int count);
+int fwFind(const struct fwDim *dim, ulong key);
+int fwLowBit(ulong x);
+
+
+/**
+ * Start with no rules, accepting every packet
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall fwInit(void)
+{
+    fw.table = NULL;
+    fw.policy = FW_ACCEPT;
+    fw.missed = 0;
+    fw.dropped = 0;
+    fw.lock = semcreate(1);
+
+    return OK;
+}
+
+
+/**
+ * Insert a rule and compile the new rule set. Rules already there keep
+ * their counters.
+ * @param rule rule to add; its counters are ignored
+ * @param pos  index it takes, moving later rules down; beyond the last
+ *             rule or negative to append
+ * @return OK for success, SYSERR if the rule is invalid, the rule set
+ *         is full or memory ran out
+ */
+syscall fwAdd(const struct fwRule *rule, int pos)
+{
+    struct fwTable *old = NULL, *next = NULL;
+    struct fwRule *rules = NULL;
+    int count;
+
+    if (rule == NULL || !fwCheck(rule))
+        return SYSERR;
+
+    wait(fw.lock);
+    old = fw.table;
+    count = (old == NULL) ? 0 : old->count;
+    if (count >= FW_RULES)
+    {
+        signal(fw.lock);
+        return SYSERR;
+    }
+    if (pos < 0 || pos > count)
+        pos = count;
+
+    rules = (struct fwRule *) getmem((count + 1) * sizeof(struct fwRule));
+    if (rules == (struct fwRule *) SYSERR || rules == NULL)
+    {
+        signal(fw.lock);
+        return SYSERR;
+    }
+
+    // Only holders of the lock change the table, so it can be read here
+    if (pos > 0)
+        memcpy((void *) rules, (void *) old->rules, pos * sizeof(struct fwRule));
+    rules[pos] = *rule;
+    if (count > pos)
+        memcpy((void *) &rules[pos + 1], (void *) &old->rules[pos],
+               (count - pos) * sizeof(struct fwRule));
+
+    if (SYSERR == fwCompile(rules, count + 1, &next))
+    {
+        freemem((void *) rules, (count + 1) * sizeof(struct fwRule));
+        signal(fw.lock);
+        return SYSERR;
+    }
+    freemem((void *) rules, (count + 1) * sizeof(struct fwRule));
+
+    fwInstall(next, pos, 1);
+    signal(fw.lock);
+
+    return OK;
+}
+
+
+/**
+ * Remove a rule and compile the new rule set. Rules left keep their
+ * counters.
+ * @param pos index of the rule
+ * @return OK for success, SYSERR if there is no such rule or memory ran
+ *         out
+ */
+syscall fwRemove(int pos)
+{
+    struct fwTable *old = NULL, *next = NULL;
+    struct fwRule *rules = NULL;
+    int count;
+
+    wait(fw.lock);
+    old = fw.table;
+    count = (old == NULL) ? 0 : old->count;
+    if (pos < 0 || pos >= count)
+    {
+        signal(fw.lock);
+        return SYSERR;
+    }
+
+    if (count == 1)
+    {
+        fwInstall(NULL, 0, 0);
+        signal(fw.lock);
+        return OK;
+    }
+
+    rules = (struct fwRule *) getmem((count - 1) * sizeof(struct fwRule));
+    if (rules == (struct fwRule *) SYSERR || rules == NULL)
+    {
+        signal(fw.lock);
+        return SYSERR;
+    }
+
+    if (pos > 0)
+        memcpy((void *) rules, (void *) old->rules, pos * sizeof(struct fwRule));
+    if (count - 1 > pos)
+        memcpy((void *) &rules[pos], (void *) &old->rules[pos + 1],
+               (count - 1 - pos) * sizeof(struct fwRule));
+
+    if (SYSERR == fwCompile(rules, count - 1, &next))
+    {
+        freemem((void *) rules, (count - 1) * sizeof(struct fwRule));
+        signal(fw.lock);
+        return SYSERR;
+    }
+    freemem((void *) rules, (count - 1) * sizeof(struct fwRule));
+
+    fwInstall(next, pos, -1);
+    signal(fw.lock);
+
+    return OK;
+}
+
+
+/**
+ * Replace the whole rule set, compiling it once; much faster than
+ * adding many rules one at a time. Counters start from zero.
+ * @param rules rules, in match order
+ * @param count count of rules, 0 to remove them all
+ * @return OK for success, SYSERR if a rule is invalid, there are too
+ *         many or memory ran out
+ */
+syscall fwLoad(const struct fwRule *rules, int count)
+{
+    struct fwTable *next = NULL;
+    int i;
+
+    if (count < 0 || count > FW_RULES || (count > 0 && rules == NULL))
+        return SYSERR;
+    for (i = 0; i < count; i++)
+    {
+        if (!fwCheck(&rules[i]))
+            return SYSERR;
+    }
+
+    wait(fw.lock);
+    if (SYSERR == fwCompile(rules, count, &next))
+    {
+        signal(fw.lock);
+        return SYSERR;
+    }
+    fwInstall(next, 0, 0);
+    signal(fw.lock);
+
+    return OK;
+}
+
+
+/**
+ * Set what happens to packets no rule matches
+ * @param action FW_ACCEPT or FW_DROP
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall fwPolicy(uchar action)
+{
+    if (action != FW_ACCEPT && action != FW_DROP)
+        return SYSERR;
+
+    fw.policy = action;
+    return OK;
+}
+
+
+/**
+ * Decide a received packet's fate by the first rule it matches, or the
+ * policy if none does, and count it against that rule
+ * @param pkt IPv4 packet, whole and with a valid header
+ * @return FW_ACCEPT or FW_DROP
+ */
+int fwMatch(const struct ipgram *pkt)
+{
+    struct fwTable *t = NULL;
+    ulong keys[FW_DIMS];
+    int rule, action;
+    irqmask im;
+
+    fwKeys(pkt, keys);
+
+    // The table must not be swapped and freed during the lookup
+    im = disable();
+    t = fw.table;
+    rule = fwLookup(t, keys);
+
+    if (rule >= 0)
+    {
+        t->rules[rule].packets++;
+        t->rules[rule].bytes += ipGetLen(pkt);
+        action = t->rules[rule].action;
+    }
+    else
+    {
+        fw.missed++;
+        action = fw.policy;
+    }
+    if (action == FW_DROP)
+        fw.dropped++;
+    restore(im);
+
+    return action;
+}
+
+
+/**
+ * Get the value of each field a rule can match from a packet
+ * @param pkt  IPv4 packet, whole and with a valid header
+ * @param keys FW_DIMS values, indexed by FW_DIM_*, return value
+ */
+void fwKeys(const struct ipgram *pkt, ulong *keys)
+{
+    const struct udpgram *ports = NULL;
+    int hdrLen, dataLen;
+
+    hdrLen = ipGetHdrLen(pkt);
+    dataLen = ipGetLen(pkt) - hdrLen;
+
+    keys[FW_DIM_SRC] = ntohl(pkt->src);
+    keys[FW_DIM_DST] = ntohl(pkt->dst);
+    keys[FW_DIM_PROTO] = pkt->proto;
+    keys[FW_DIM_SPORT] = 0;
+    keys[FW_DIM_DPORT] = 0;
+
+    // TCP and UDP headers both start with the two ports
+    if ((pkt->proto == IPv4_PROTO_TCP || pkt->proto == IPv4_PROTO_UDP) &&
+        dataLen >= 4)
+    {
+        ports = (const struct udpgram *) ((const uchar *) pkt + hdrLen);
+        keys[FW_DIM_SPORT] = udpGetSrcPort(ports);
+        keys[FW_DIM_DPORT] = udpGetDstPort(ports);
+    }
+    else if (pkt->proto == IPv4_PROTO_ICMP && dataLen >= 1)
+        keys[FW_DIM_DPORT] = ((const uchar *) pkt)[hdrLen];
+}
+
+
+/**
+ * Find the first rule of a compiled table that a packet matches. Each
+ * field's value is looked up in its intervals by binary search, giving
+ * a bitmap of the rules it matches; the bitmaps are ANDed and the
+ * lowest set bit is the matching rule. The aggregate bitmaps skip words
+ * with no candidates, so the cost barely grows with the count of rules.
+ * Counters are left alone.
+ * @param t    compiled table, or NULL for no rules
+ * @param keys field values from fwKeys
+ * @return index of the matching rule, -1 if none matches
+ */
+int fwLookup(const struct fwTable *t, const ulong *keys)
+{
+    const ulong *maps[FW_DIMS];
+    ulong agg, bits;
+    int d, i, w;
+
+    if (t == NULL)
+        return -1;
+
+    agg = 0xFFFFFFFF;
+    for (d = 0; d < FW_DIMS; d++)
+    {
+        i = fwFind(&t->dims[d], keys[d]);
+        maps[d] = &t->dims[d].maps[i * t->words];
+        agg &= t->dims[d].aggs[i];
+    }
+
+    // Earlier words hold earlier rules, so the first hit wins
+    while (agg != 0)
+    {
+        w = fwLowBit(agg);
+        bits = maps[FW_DIM_SRC][w] & maps[FW_DIM_DST][w] &
+               maps[FW_DIM_PROTO][w] & maps[FW_DIM_SPORT][w] &
+               maps[FW_DIM_DPORT][w];
+        if (bits != 0)
+            return w * 32 + fwLowBit(bits);
+        agg &= agg - 1;
+    }
+
+    return -1;
+}
+
+
+/**
+ * Helper function to check a rule: masks must be contiguous so prefixes
+ * are ranges, and ports and ICMP types need a protocol that has them
+ * @param rule rule to check
+ * @return TRUE if the rule can be compiled, FALSE otherwise
+ */
+bool fwCheck(const struct fwRule *rule)
+{
+    ulong host;
+
+    if (rule->action != FW_ACCEPT && rule->action != FW_DROP)
+        return FALSE;
+
+    // The host part of a contiguous mask is one less than a power of 2
+    host = ~ntohl(rule->srcMask);
+    if (host & (host + 1))
+        return FALSE;
+    host = ~ntohl(rule->dstMask);
+    if (host & (host + 1))
+        return FALSE;
+
+    if (rule->sportLo > rule->sportHi || rule->dportLo > rule->dportHi)
+        return FALSE;
+
+    if ((rule->sportLo != 0 || rule->sportHi != FW_PORT_MAX) &&
+        rule->proto != IPv4_PROTO_TCP && rule->proto != IPv4_PROTO_UDP)
+        return FALSE;
+
+    if ((rule->dportLo != 0 || rule->dportHi != FW_PORT_MAX) &&
+        rule->proto != IPv4_PROTO_TCP && rule->proto != IPv4_PROTO_UDP &&
+        rule->proto != IPv4_PROTO_ICMP)
+        return FALSE;
+
+    return TRUE;
+}
+
+
+/**
+ * Compile rules for fwLookup. Each field's values
+ * are cut into elementary intervals at the ends of every rule's range,
+ * and each interval gets a bitmap of the rules that match its values.
+ * Everything goes in one allocation, freed with its size field.
+ * @param rules rules, in match order; copied
+ * @param count count of rules, 1 to FW_RULES; 0 compiles to NULL
+ * @param table the compiled table
+ * @return OK for success, SYSERR if memory ran out
+ */
+syscall fwCompile(const struct fwRule *rules, int count, struct fwTable **table)
+{
+    struct fwTable *t = NULL;
+    struct fwDim *dim = NULL;
+    ulong *ends = NULL, *cuts = NULL;
+    ulong lo, hi, size, endsSize;
+    uchar *mem = NULL;
+    int counts[FW_DIMS];
+    int d, i, r, w, n, words;
+
+    *table = NULL;
+    if (count == 0)
+        return OK;
+
+    // Every rule adds at most two cuts to a field: its low end and one
+    // past its high end
+    words = (count + 31) / 32;
+    endsSize = FW_DIMS * (2 * count + 1) * sizeof(ulong);
+    ends = (ulong *) getmem(endsSize);
+    if (ends == (ulong *) SYSERR || ends == NULL)
+        return SYSERR;
+
+    size = sizeof(struct fwTable) + count * sizeof(struct fwRule);
+    for (d = 0; d < FW_DIMS; d++)
+    {
+        cuts = &ends[d * (2 * count + 1)];
+        n = 0;
+        cuts[n++] = 0;
+        for (r = 0; r < count; r++)
+        {
+            fwRange(&rules[r], d, &lo, &hi);
+            cuts[n++] = lo;
+            if (hi < fwDimMax[d])
+                cuts[n++] = hi + 1;
+        }
+        counts[d] = fwSort(cuts, n);
+        size += counts[d] * (2 + words) * sizeof(ulong);
+    }
+
+    mem = (uchar *) getmem(size);
+    if (mem == (uchar *) SYSERR || mem == NULL)
+    {
+        freemem((void *) ends, endsSize);
+        return SYSERR;
+    }
+    bzero((void *) mem, size);
+
+    t = (struct fwTable *) mem;
+    t->count = count;
+    t->words = words;
+    t->size = size;
+    mem += sizeof(struct fwTable);
+    t->rules = (struct fwRule *) mem;
+    memcpy((void *) t->rules, (void *) rules, count * sizeof(struct fwRule));
+    mem += count * sizeof(struct fwRule);
+
+    for (d = 0; d < FW_DIMS; d++)
+    {
+        dim = &t->dims[d];
+        dim->count = counts[d];
+        dim->starts = (ulong *) mem;
+        dim->aggs = dim->starts + counts[d];
+        dim->maps = dim->aggs + counts[d];
+        mem += counts[d] * (2 + words) * sizeof(ulong);
+        memcpy((void *) dim->starts, (void *) &ends[d * (2 * count + 1)],
+               counts[d] * sizeof(ulong));
+
+        // Mark each rule in the intervals its range covers
+        for (r = 0; r < count; r++)
+        {
+            fwRange(&rules[r], d, &lo, &hi);
+            for (i = fwFind(dim, lo); i < dim->count && dim->starts[i] <= hi; i++)
+                dim->maps[i * words + r / 32] |= (ulong) 1 << (r % 32);
+        }
+
+        for (i = 0; i < dim->count; i++)
+        {
+            for (w = 0; w < words; w++)
+            {
+                if (dim->maps[i * words + w] != 0)
+                    dim->aggs[i] |= (ulong) 1 << w;
+            }
+        }
+    }
+
+    // Counters start from zero; fwInstall carries over the old ones
+    for (r = 0; r < count; r++)
+    {
+        t->rules[r].packets = 0;
+        t->rules[r].bytes = 0;
+    }
+
+    freemem((void *) ends, endsSize);
+    *table = t;
+
+    return OK;
+}
+
+
+/**
+ * Helper function to swap in a compiled table, carry the counters of
+ * the rules it keeps over from the old one, and free the old one
+ * @param next  compiled table, or NULL for no rules
+ * @param pos   index of the rule added or removed
+ * @param delta 1 if a rule was added at pos, -1 if one was removed, 0
+ *              if the whole rule set was replaced
+ */
+void fwInstall(struct fwTable *next, int pos, int delta)
+{
+    struct fwTable *old = NULL;
+    int i, j;
+    irqmask im;
+
+    im = disable();
+    old = fw.table;
+    if (old != NULL && next != NULL && delta != 0)
+    {
+        for (i = 0; i < next->count; i++)
+        {
+            if (delta > 0 && i == pos)
+                continue;
+            j = (i < pos) ? i : i - delta;
+            next->rules[i].packets = old->rules[j].packets;
+            next->rules[i].bytes = old->rules[j].bytes;
+        }
+    }
+    fw.table = next;
+    restore(im);
+
+    if (old != NULL)
+        freemem((void *) old, old->size);
+}
+
+
+/**
+ * Helper function to get the range of values a rule matches in a field
+ * @param rule rule
+ * @param dim  FW_DIM_*
+ * @param lo   lowest value matched
+ * @param hi   highest value matched
+ */
+void fwRange(const struct fwRule *rule, int dim, ulong *lo, ulong *hi)
+{
+    switch (dim)
+    {
+    case FW_DIM_SRC:
+        *lo = ntohl(rule->src & rule->srcMask);
+        *hi = *lo | ~ntohl(rule->srcMask);
+        break;
+    case FW_DIM_DST:
+        *lo = ntohl(rule->dst & rule->dstMask);
+        *hi = *lo | ~ntohl(rule->dstMask);
+        break;
+    case FW_DIM_PROTO:
+        *lo = rule->proto;
+        *hi = (rule->proto == 0) ? 0xFF : rule->proto;
+        break;
+    case FW_DIM_SPORT:
+        *lo = rule->sportLo;
+        *hi = rule->sportHi;
+        break;
+    default:
+        *lo = rule->dportLo;
+        *hi = rule->dportHi;
+        break;
+    }
+}
+
+
+/**
+ * Helper function to sort values and drop repeats, by Shell sort
+ * @param vals  values
+ * @param count count of values
+ * @return count of distinct values, now at the front of vals
+ */
+int fwSort(ulong *vals, int count)
+{
+    ulong v;
+    int gap, i, j, n;
+
+    for (gap = count / 2; gap > 0; gap /= 2)
+    {
+        for (i = gap; i < count; i++)
+        {
+            v = vals[i];
+            for (j = i; j >= gap && vals[j - gap] > v; j -= gap)
+                vals[j] = vals[j - gap];
+            vals[j] = v;
+        }
+    }
+
+    n = (count > 0) ? 1 : 0;
+    for (i = 1; i < count; i++)
+    {
+        if (vals[i] != vals[n - 1])
+            vals[n++] = vals[i];
+    }
+
+    return n;
+}
+
+
+/**
+ * Helper function to find the interval of a field holding a value
+ * @param dim compiled field; its first interval starts at 0
+ * @param key value
+ * @return index of the interval
+ */
+int fwFind(const struct fwDim *dim, ulong key)
+{
+    int lo = 0, hi = dim->count - 1, mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi + 1) / 2;
+        if (dim->starts[mid] <= key)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+
+/**
+ * Helper function to find the lowest set bit of a word
+ * @param x word, nonzero
+ * @return index of the bit, 0 to 31
+ */
+int fwLowBit(ulong x)
+{
+    int n = 0;
+
+    if (!(x & 0xFFFF))
+    {
+        n += 16;
+        x >>= 16;
+    }
+    if (!(x & 0xFF))
+    {
+        n += 8;
+        x >>= 8;
+    }
+    if (!(x & 0xF))
+    {
+        n += 4;
+        x >>= 4;
+    }
+    if (!(x & 0x3))
+    {
+        n += 2;
+        x >>= 2;
+    }
+    if (!(x & 0x1))
+        n += 1;
+
+    return n;
+}
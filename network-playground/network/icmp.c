@@ -1,6 +1,6 @@
 /**
  * @file icmp.c
- * @provides icmpRecv, icmpHandleRequest, and icmpHandleReply
+ * @provides icmpRecv, icmpHandleRequest, icmpHandleReply, and icmpHandleError
  *
  */
 /* Author: Drew Vanderwiel, Jiayi Xin  */
@@ -15,6 +15,9 @@
 /* Global ICMP table definition */
 struct icmpTblEntry icmpTbl[ICMP_TBL_LEN];
 
+/* Private/helper functions */
+syscall icmpProbeRecord(ushort, ushort, uchar, ipaddr);
+
 
 /**
  * Initialize the ICMP table
@@ -34,10 +37,17 @@ syscall icmpInit(void)
         icmpTbl[i].seqNum = 0;
         icmpTbl[i].recvdBytes = 0;
         icmpTbl[i].recvdTime = 0;
-        for (j = 0; j < IPv4_ADDR_LEN; j++)
-            icmpTbl[i].ipAddr[j] = 0;
+        icmpTbl[i].ipAddr = IPv4_ADDR_ANY;
+        for (j = 0; j < ICMP_MAX_PROBES; j++)
+            icmpTbl[i].probes[j].flag = ICMP_ENTRY_INVALID;
     }
     
+    /* Start the ICMP error limiter with a full bucket */
+    icmpErr.tokens = ICMP_ERR_BURST;
+    icmpErr.lastRefill = netTime();
+    icmpErr.sent = 0;
+    icmpErr.suppressed = 0;
+    
     return OK;
 }
 
@@ -53,25 +63,35 @@ syscall icmpRecv(struct ipgram *ipPkt, uchar *srcAddr)
     int i, eqFlag;
     struct icmpPkt *pkt;
     ushort origChksum, calChksum;
+    ushort ipLen, icmpLen;
      
     if (ipPkt == NULL || srcAddr == NULL)
         return SYSERR;
     
     pkt = (struct icmpPkt *) ipPkt->opts;
+    ipLen = ipGetLen(ipPkt);
     
     // Screen out packets with bad ICMP headers
-    if ( ntohs(ipPkt->len) < (ICMP_HEADER_LEN + IPv4_HDR_LEN) ||
-        (pkt->type != ICMP_ECHO_RQST_T &&
-         pkt->type != ICMP_ECHO_RPLY_T) ||
-         pkt->code != ICMP_ECHO_RQST_C)
+    if ( ipLen < (ICMP_HEADER_LEN + IPv4_HDR_LEN) )
         return SYSERR;
     
+    if (pkt->type == ICMP_ECHO_RQST_T || pkt->type == ICMP_ECHO_RPLY_T)
+    {
+        if (pkt->code != ICMP_ECHO_RQST_C)
+            return SYSERR;
+    }
+    else if (pkt->type != ICMP_TIMEX_T && pkt->type != ICMP_UNREACH_T)
+    {
+        return SYSERR;
+    }
     
-    // Screen out packets with a bad ICMP checksums
+    // Screen out packets with a bad ICMP checksum, which covers
+    // the whole ICMP message
+    icmpLen = ipLen - IPv4_HDR_LEN;
     origChksum = pkt->chksum;
     pkt->chksum = 0;
-    calChksum = checksum((void *) pkt, ICMP_HEADER_LEN);
-    
+    calChksum = netChecksum((void *) pkt, icmpLen);
+    pkt->chksum = origChksum;
     
     if (calChksum != origChksum)
         return SYSERR;
@@ -81,6 +101,8 @@ syscall icmpRecv(struct ipgram *ipPkt, uchar *srcAddr)
         return icmpHandleRequest(ipPkt, srcAddr);
     else if ( pkt->type == ICMP_ECHO_RPLY_T )
         return icmpHandleReply(ipPkt);
+    else
+        return icmpHandleError(ipPkt);
     
     return OK;
 }
@@ -97,45 +119,45 @@ syscall icmpHandleRequest(struct ipgram *ipPkt, uchar *srcAddr)
     int i;
     struct icmpPkt      *icmpPRecvd = NULL;
     struct icmpPkt      *icmpP = NULL;
-    ulong               icmpDataLen, icmpPktSize = 0;
+    ulong               icmpPktSize = 0;
+    ushort              oldTypeCode;
     char                *buf = NULL; 
     
     /* Debug: uncomment to test ping times */
     //sleep(10);
     
-    icmpPktSize = (ulong) (ntohs(ipPkt->len) - IPv4_HDR_LEN);
+    icmpPktSize = (ulong) (ipGetLen(ipPkt) - IPv4_HDR_LEN);
     
-    buf = (char *) malloc(icmpPktSize);
+    // Replies that fit a frame come from the transmit pool; reassembled
+    // requests bigger than that still go through the heap
+    if (icmpPktSize <= NET_FRAME_LEN)
+        buf = (char *) netBufGet(NET_POOL_TX);
+    else
+        buf = (char *) malloc(icmpPktSize);
     
     if (buf == NULL)
         return SYSERR;
     
-    // Zero out the packet buffer
-    bzero(buf, icmpPktSize);
-    
-    
     /* Set up ICMP header */
     icmpPRecvd = (struct icmpPkt *) &ipPkt->opts;
     icmpP = (struct icmpPkt *) buf;
-    icmpDataLen = ntohs(ipPkt->len) - IPv4_HDR_LEN - ICMP_HEADER_LEN;
     
+    // The reply is the request with a new type, so copy the whole
+    // message and patch the checksum for the type/code halfword
+    memcpy((void *) icmpP, (void *) icmpPRecvd, icmpPktSize);
+    oldTypeCode = *(ushort *) icmpP;
     icmpP->type = ICMP_ECHO_RPLY_T;
     icmpP->code = ICMP_ECHO_RPLY_C;
-    icmpP->chksum = 0;
-    icmpP->id = icmpPRecvd->id;
-    icmpP->seqNum = icmpPRecvd->seqNum;
-    
-    // Copy the received data into the data field of the ICMP reply
-    for (i = 0; i < icmpDataLen; i++)
-        icmpP->data[i] = icmpPRecvd->data[i];
-    
-    // Calculate the ICMP header checksum
-    icmpP->chksum = checksum((void *) icmpP, ICMP_HEADER_LEN);
+    icmpP->chksum = csumUpdate16(icmpP->chksum, oldTypeCode, *(ushort *) icmpP);
     
     /* Send packet */
-    ipWrite((void *) buf, ntohs(icmpP->id), icmpPktSize, IPv4_PROTO_ICMP, (uchar *) ipPkt->src);
+    ipWrite((void *) buf, icmpGetId(icmpP), icmpPktSize, IPv4_PROTO_ICMP,
+            IPv4_TTL, IPv4_TOS_INTCNTRL, ipPkt->src);
     
-    free((void *) buf);
+    if (icmpPktSize <= NET_FRAME_LEN)
+        netBufFree((void *) buf);
+    else
+        free((void *) buf);
     return OK;
 }
 
@@ -147,16 +169,21 @@ syscall icmpHandleRequest(struct ipgram *ipPkt, uchar *srcAddr)
  */
 syscall icmpHandleReply(struct ipgram *ipPkt)
 {
-    int i, ipEqual = 0;
+    int ipEqual = 0;
     ushort id;
     ushort seqNum;
+    ushort ipLen;
     struct icmpPkt      *icmpPRecvd = NULL;
     message msg;
     
     icmpPRecvd = (struct icmpPkt *) &ipPkt->opts;
-    id = ntohs(icmpPRecvd->id);
-    seqNum = ntohs(icmpPRecvd->seqNum);
+    id = icmpGetId(icmpPRecvd);
+    seqNum = icmpGetSeqNum(icmpPRecvd);
+    ipLen = ipGetLen(ipPkt);
     
+    // A traceroute probe reached its destination
+    if (id < ICMP_TBL_LEN && ICMP_PROBES_SENT == icmpTbl[id].flag)
+        return icmpProbeRecord(id, seqNum, ICMP_ECHO_RPLY_T, ipPkt->src);
     
     // Make sure the id is within the table's range
     if (id < ICMP_TBL_LEN)
@@ -171,15 +198,7 @@ syscall icmpHandleReply(struct ipgram *ipPkt)
              seqNum             == icmpTbl[id].seqNum )
         {
             // Check if the IP address matches
-            ipEqual = 1;
-            for (i = 0; i < IPv4_ADDR_LEN; i++)
-            {
-                if (icmpTbl[id].ipAddr[i] != ipPkt->src[i])
-                {
-                    ipEqual = 0;
-                    break;
-                }
-            }
+            ipEqual = (icmpTbl[id].ipAddr == ipPkt->src);
             
             // Set the flag and the ttl field, since we got an ICMP reply
             if (ipEqual)
@@ -187,7 +206,7 @@ syscall icmpHandleReply(struct ipgram *ipPkt)
                 icmpTbl[id].flag = ICMP_GOT_RPLY;
                 icmpTbl[id].ttl = ipPkt->ttl;
                 uchar4ToUlong(icmpPRecvd->data, &icmpTbl[id].recvdTime, BIG_ENDIAN);
-                icmpTbl[id].recvdBytes = ntohs(ipPkt->len);
+                icmpTbl[id].recvdBytes = ipLen;
             }
         }
         // Give back the semaphore
@@ -199,7 +218,7 @@ syscall icmpHandleReply(struct ipgram *ipPkt)
     if (ipEqual)
     {
         // Send a message to the waiting process
-        msg = (message) ntohs(ipPkt->len);
+        msg = (message) ipLen;
         send(icmpTbl[id].pid, msg);
     }
     
@@ -207,6 +226,91 @@ syscall icmpHandleReply(struct ipgram *ipPkt)
 }
 
 
+/**
+ * Handle ICMP time exceeded and destination unreachable errors that
+ * quote one of our echo probes
+ * @param ipPkt   received IPv4 packet
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall icmpHandleError(struct ipgram *ipPkt)
+{
+    ushort ipLen, origHdrLen;
+    struct icmpPkt      *icmpPRecvd = NULL;
+    struct icmpPkt      *origIcmpP = NULL;
+    struct ipgram       *origIpPkt = NULL;
+    
+    icmpPRecvd = (struct icmpPkt *) &ipPkt->opts;
+    origIpPkt = (struct ipgram *) icmpPRecvd->data;
+    
+    // The error must quote an IP header and 8 bytes of its data
+    ipLen = ipGetLen(ipPkt);
+    if (ipLen < IPv4_HDR_LEN + ICMP_HEADER_LEN + 
+                IPv4_HDR_LEN + ICMP_ERR_QUOTE_LEN)
+        return SYSERR;
+    
+    origHdrLen = ipGetHdrLen(origIpPkt);
+    if (origHdrLen < IPv4_HDR_LEN ||
+        ipLen < IPv4_HDR_LEN + ICMP_HEADER_LEN + 
+                origHdrLen + ICMP_ERR_QUOTE_LEN)
+        return SYSERR;
+    
+    // Only errors about echo requests we sent are of interest
+    if (origIpPkt->proto != IPv4_PROTO_ICMP)
+        return OK;
+    
+    if (origIpPkt->src != net.ipAddr)
+        return OK;
+    
+    origIcmpP = (struct icmpPkt *) ((uchar *) origIpPkt + origHdrLen);
+    if (origIcmpP->type != ICMP_ECHO_RQST_T)
+        return OK;
+    
+    return icmpProbeRecord(icmpGetId(origIcmpP), icmpGetSeqNum(origIcmpP),
+                           icmpPRecvd->type, ipPkt->src);
+}
+
+
+/**
+ * Record the answer to an outstanding traceroute probe and wake the
+ * process waiting on it
+ * @param id     ICMP identifier of the probe (ICMP table index)
+ * @param seqNum ICMP sequence number of the probe
+ * @param type   ICMP type of the answer
+ * @param ipAddr IPv4 address that answered
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall icmpProbeRecord(ushort id, ushort seqNum, uchar type, ipaddr ipAddr)
+{
+    int found = 0;
+    struct icmpProbe *probe;
+    
+    if (id >= ICMP_TBL_LEN)
+        return OK;
+    
+    wait(icmpTbl[id].sema);
+    
+    probe = &icmpTbl[id].probes[seqNum % ICMP_MAX_PROBES];
+    if ( ICMP_PROBES_SENT == icmpTbl[id].flag &&
+         ICMP_RQST_SENT   == probe->flag &&
+         seqNum           == probe->seqNum )
+    {
+        probe->flag = ICMP_GOT_RPLY;
+        probe->type = type;
+        probe->rtt = netTime() - probe->sentTime;
+        probe->ipAddr = ipAddr;
+        found = 1;
+    }
+    
+    signal(icmpTbl[id].sema);
+    
+    // The probe table holds the results, the message is only a wake up
+    if (found)
+        send(icmpTbl[id].pid, (message) 1);
+    
+    return OK;
+}
+
+
 /**
  * Converts a ulong to an array of 4 uchars
  * @param buf   uchar array
@@ -0,0 +1,146 @@
+/**
+ * @file icmpSendError.c
+ * @provides icmpSendError
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/3/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <ether.h>
+#include <icmp.h>
+
+/* Global ICMP error rate limiter */
+struct icmpErrLimit icmpErr;
+
+/* Private/helper functions */
+int icmpErrAllow(void);
+
+
+/**
+ * Send an ICMP error message (destination unreachable, time exceeded or
+ * parameter problem) back to the sender of a received IPv4 packet.
+ * Errors are never sent about ICMP errors, non-initial fragments or
+ * broadcast packets, and are rate limited by a token bucket.
+ * @param pkt   received IPv4 packet that caused the error
+ * @param type  ICMP error type
+ * @param code  ICMP error code
+ * @param param pointer to the bad octet (parameter problem only)
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall icmpSendError(struct ipgram *pkt, uchar type, uchar code, uchar param)
+{
+    struct icmpPkt      *icmpP = NULL;
+    struct icmpPkt      *origIcmpP = NULL;
+    ulong               *buf;
+    ushort              ipHdrLen, ipLen, quoteLen;
+    ulong               sum;
+    syscall             result;
+
+    if (pkt == NULL)
+        return SYSERR;
+
+    ipHdrLen = ipGetHdrLen(pkt);
+    ipLen = ipGetLen(pkt);
+
+    // Only the first fragment of a datagram may generate an error
+    if (ipGetFroff(pkt) != 0)
+        return OK;
+
+    // Never answer packets sent to or from a broadcast address
+    if (pkt->dst == IPv4_ADDR_BCAST ||
+        IP_BYTE(pkt->src, 0) == 0xFF || IP_BYTE(pkt->src, 0) == 0x00)
+        return OK;
+
+    // Never answer an ICMP error with another ICMP error
+    if (pkt->proto == IPv4_PROTO_ICMP)
+    {
+        origIcmpP = (struct icmpPkt *) ((uchar *) pkt + ipHdrLen);
+        if (ipLen < ipHdrLen + ICMP_HEADER_LEN ||
+            (origIcmpP->type != ICMP_ECHO_RQST_T &&
+             origIcmpP->type != ICMP_ECHO_RPLY_T))
+            return OK;
+    }
+
+    if (!icmpErrAllow())
+        return OK;
+
+    // Quote the offending IP header and the first 8 bytes of its data
+    quoteLen = ipHdrLen + ICMP_ERR_QUOTE_LEN;
+    if (quoteLen > ipLen)
+        quoteLen = ipLen;
+
+    buf = (ulong *) netBufGet(NET_POOL_CTL);
+    if (buf == NULL)
+        return SYSERR;
+
+    /* Set up ICMP header */
+    bzero(buf, ICMP_HEADER_LEN);
+    icmpP = (struct icmpPkt *) buf;
+
+    icmpP->type = type;
+    icmpP->code = code;
+    icmpP->chksum = 0;
+
+    // The id/seqNum words are unused, except for the parameter pointer
+    if (type == ICMP_PARAMPROB_T)
+        ((uchar *) &icmpP->id)[0] = param;
+
+    // Copy the quote and sum it in one pass, then add in the header;
+    // error messages are checksummed over the whole ICMP message
+    sum = csumPartialCopy((void *) icmpP->data, (void *) pkt, quoteLen, 0);
+    icmpP->chksum = csumFold(csumPartial((void *) icmpP, ICMP_HEADER_LEN, sum));
+
+    /* Send packet */
+    result = ipWrite((void *) buf, ipNextId(), ICMP_HEADER_LEN + quoteLen,
+                     IPv4_PROTO_ICMP, IPv4_TTL, IPv4_TOS_INTCNTRL, pkt->src);
+
+    netBufFree((void *) buf);
+    return result;
+}
+
+
+/**
+ * Refill the ICMP error token bucket and take a token from it.
+ * @return 1 if an error message may be sent, 0 if it must be suppressed
+ */
+int icmpErrAllow(void)
+{
+    irqmask im;
+    ulong now, newTokens;
+    int allow;
+
+    im = disable();
+
+    now = netTime();
+    newTokens = (now - icmpErr.lastRefill) / ICMP_ERR_INTERVAL;
+
+    // Only advance the refill time by whole tokens so no credit is lost
+    if (newTokens > 0)
+    {
+        icmpErr.tokens += newTokens;
+        icmpErr.lastRefill += newTokens * ICMP_ERR_INTERVAL;
+        if (icmpErr.tokens >= ICMP_ERR_BURST)
+        {
+            icmpErr.tokens = ICMP_ERR_BURST;
+            icmpErr.lastRefill = now;
+        }
+    }
+
+    if (icmpErr.tokens > 0)
+    {
+        icmpErr.tokens--;
+        icmpErr.sent++;
+        allow = 1;
+    }
+    else
+    {
+        icmpErr.suppressed++;
+        allow = 0;
+    }
+
+    restore(im);
+    return allow;
+}
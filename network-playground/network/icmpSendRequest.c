@@ -1,6 +1,6 @@
 /**
  * @file icmpSendRequest.c
- * @provides icmpSendRequest
+ * @provides icmpSendRequest and icmpSendProbe
  *
  */
 /* Author: Drew Vanderwiel, Jiayi Xin  */
@@ -20,18 +20,14 @@
  * @param seqNum ICMP sequence number
  * @return OK for success, SYSERR for syntax error
  */
-syscall icmpSendRequest(uchar *ipAddr,
+syscall icmpSendRequest(ipaddr ipAddr,
                         ushort id,
                         ushort seqNum)
 {
-    int i;
     struct icmpPkt       *icmpP = NULL;
     uchar               buf[ICMP_HEADER_LEN + 4];
     message             msg;
     
-    if (ipAddr == NULL )
-        return SYSERR;
-    
     /* Set up ICMP header */
     bzero(buf, ICMP_HEADER_LEN + 4);
     
@@ -47,20 +43,19 @@ syscall icmpSendRequest(uchar *ipAddr,
     ulongToUchar4(icmpP->data, clocktime, BIG_ENDIAN);
     
     // Calculate the checksum
-    icmpP->chksum = checksum((void *) icmpP, ICMP_HEADER_LEN);
+    icmpP->chksum = netChecksum((void *) icmpP, ICMP_HEADER_LEN + 4);
     
     // Grab semaphore
     wait(icmpTbl[id].sema);
     
-    ipWrite((void *) buf, id, ICMP_HEADER_LEN + 4, IPv4_PROTO_ICMP, ipAddr);
+    ipWrite((void *) buf, id, ICMP_HEADER_LEN + 4, IPv4_PROTO_ICMP, IPv4_TTL,
+            IPv4_TOS_ROUTINE, ipAddr);
     
     // Update icmpTbl entry
     icmpTbl[id].pid = getpid();
     icmpTbl[id].flag = ICMP_RQST_SENT;
     icmpTbl[id].seqNum = seqNum;
-    
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        icmpTbl[id].ipAddr[i] = ipAddr[i];
+    icmpTbl[id].ipAddr = ipAddr;
     
     // Give back the entry's semaphore
     signal(icmpTbl[id].sema);
@@ -72,3 +67,56 @@ syscall icmpSendRequest(uchar *ipAddr,
     
     return (syscall) msg;
 }
+
+
+/**
+ * Send a TTL-limited ICMP echo request without waiting for the answer.
+ * The answer (an echo reply or an ICMP error quoting the probe) is
+ * recorded in the entry's probe table by the netDaemon.
+ * @param ipAddr Destination IPv4 address
+ * @param id     ICMP identifier, used to index ICMP buffer
+ * @param seqNum ICMP sequence number
+ * @param ttl    IPv4 time to live of the probe
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall icmpSendProbe(ipaddr ipAddr, ushort id, ushort seqNum, uchar ttl)
+{
+    struct icmpPkt      *icmpP = NULL;
+    struct icmpProbe    *probe = NULL;
+    uchar               buf[ICMP_HEADER_LEN + 4];
+    
+    if (id >= ICMP_TBL_LEN)
+        return SYSERR;
+    
+    /* Set up ICMP header */
+    bzero(buf, ICMP_HEADER_LEN + 4);
+    
+    icmpP = (struct icmpPkt *) buf;
+    
+    icmpP->type = ICMP_ECHO_RQST_T;
+    icmpP->code = ICMP_ECHO_RQST_C;
+    icmpP->chksum = 0x0000;
+    icmpP->id = htons(id);
+    icmpP->seqNum = htons(seqNum);
+    
+    ulongToUchar4(icmpP->data, clocktime, BIG_ENDIAN);
+    
+    icmpP->chksum = netChecksum((void *) icmpP, ICMP_HEADER_LEN + 4);
+    
+    // Record the probe before sending it so a quick answer is not missed
+    wait(icmpTbl[id].sema);
+    
+    icmpTbl[id].pid = getpid();
+    icmpTbl[id].flag = ICMP_PROBES_SENT;
+    icmpTbl[id].ipAddr = ipAddr;
+    
+    probe = &icmpTbl[id].probes[seqNum % ICMP_MAX_PROBES];
+    probe->flag = ICMP_RQST_SENT;
+    probe->seqNum = seqNum;
+    probe->sentTime = netTime();
+    
+    signal(icmpTbl[id].sema);
+    
+    return ipWrite((void *) buf, id, ICMP_HEADER_LEN + 4, IPv4_PROTO_ICMP, ttl,
+                   IPv4_TOS_ROUTINE, ipAddr);
+}
@@ -11,10 +11,16 @@
 #include <network.h>
 #include <ether.h>
 #include <icmp.h>
+#include <udp.h>
+#include <tcp.h>
+#include <firewall.h>
 
 /* IPv4 Packet Fragmentation Storage Struct */
 struct ipFragEntry ipFrags[IPv4_FRAG_ENTS];
 
+/* Private/helper functions */
+void ipFragExpire(void);
+
 
 /**
  * Handle IPv4 Packets
@@ -23,10 +29,9 @@ struct ipFragEntry ipFrags[IPv4_FRAG_ENTS];
  */
 syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
 {
-    int i;
-    ushort eqFlag, demuxFlag, timeoutFlag;
-    ushort ipflags, ipid, ipLen, ipHdrLen, ipDataLen;
-    ushort origChksum, calChksum;
+    ushort demuxFlag, timeoutFlag, bcastFlag;
+    ushort flagsFroff, ipflags, ipid, ipLen, ipHdrLen, ipDataLen;
+    ushort origChksum, calChksum, oldField;
     ulong ipfroff;
     struct ipgram *demuxIpPkt = NULL;
     
@@ -49,59 +54,54 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
     if (pkt == NULL || srcAddr == NULL)
         return SYSERR;
     
+    // Give up on a fragmented datagram that has waited too long
+    if (ipFrags[0].flag == IPv4_FRAG_INCOMPLETE &&
+        (netTime() - ipFrags[0].startTime) > IPv4_FRAG_TIMEOUT)
+        ipFragExpire();
+    
     // Screen out packets with bad IPv4 headers
     if ( !(pkt->ver_ihl & 0x40) ||
          ((pkt->ver_ihl & IPv4_IHL) < 5) ||
-          (ntohs(pkt->len) < IPv4_HDR_LEN) )
+          (ipGetLen(pkt) < IPv4_HDR_LEN) )
         return SYSERR;
     
     // Screen out packets not addressed to us/are not broadcast messages
-    eqFlag = OK;
-    if (pkt->dst[0] != 0xFF) // It couldn't be a broadcast msg
+    bcastFlag = 0;
+    if (pkt->dst != net.ipAddr)
     {
-        for (i = 0; i < IPv4_ADDR_LEN; i++)
-        {
-            if (pkt->dst[i] != net.ipAddr[i])
-            {
-                eqFlag = SYSERR;
-                break;
-            }
-        }
-        
-        if (eqFlag == SYSERR)
+        if (pkt->dst != IPv4_ADDR_BCAST)
             return OK;
-    }
-    else // The packet could be a broadcast msg; check it
-    {
-        for (i = 0; i < IPv4_ADDR_LEN; i++)
-        {
-            if (pkt->dst[i] != 0xFF)
-            {
-                eqFlag = SYSERR;
-                break;
-            }
-        }
         
-        if (eqFlag == SYSERR)
-            return OK;
+        bcastFlag = 1;
     }
     
     // Screen out packets with a bad checksum
     origChksum = pkt->chksum;
     pkt->chksum = 0;
-    calChksum = checksum((void *) pkt, IPv4_HDR_LEN);
+    calChksum = netChecksum((void *) pkt, IPv4_HDR_LEN);
+    pkt->chksum = origChksum;
     
     if (calChksum != origChksum)
         return SYSERR;
     
     demuxFlag = 0;
-    ipfroff = (ntohs(pkt->flags_froff) & IPv4_FROFF) << 3;
-    ipflags = ntohs(pkt->flags_froff) & IPv4_FLAGS;
-    ipid =  ntohs(pkt->id);
-    ipLen = ntohs(pkt->len);
-    ipHdrLen = (pkt->ver_ihl & IPv4_IHL) << 2;
+    flagsFroff = ipGetFlagsFroff(pkt);
+    ipfroff = (ulong) (flagsFroff & IPv4_FROFF) << 3;
+    ipflags = flagsFroff & IPv4_FLAGS;
+    ipid = ipGetId(pkt);
+    ipLen = ipGetLen(pkt);
+    ipHdrLen = ipGetHdrLen(pkt);
     ipDataLen = ipLen - ipHdrLen;
     
+    // The header claims to be longer than the whole packet; point the
+    // sender at the IHL octet
+    if (ipHdrLen > ipLen)
+    {
+        if (!bcastFlag)
+            icmpSendError(pkt, ICMP_PARAMPROB_T, ICMP_PARAM_PTR_C, 0);
+        return SYSERR;
+    }
+    
     // If this packet is an IPv4 fragment packet, handle it
     if (ipfroff > 0 || ipflags == IPv4_FLAG_MF)
     {
@@ -111,11 +111,17 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
          
         if ( ipFrags[0].flag == IPv4_FRAG_INVALID || timeoutFlag )
         {
+            // Tell the sender of the abandoned datagram it timed out
+            if (timeoutFlag)
+                ipFragExpire();
+            
             // Start a new fragment
             ipFrags[0].flag = IPv4_FRAG_INCOMPLETE;
+            ipFrags[0].gotFirst = (ipfroff == 0);
             ipFrags[0].id = ipid;
             ipFrags[0].recvdBytes = ipDataLen;
             ipFrags[0].pktDataLen = 0;
+            ipFrags[0].startTime = netTime();
             
             // Copy the IP header
             memcpy((void *) ipFrags[0].pkt,(void *) pkt, ipHdrLen);
@@ -136,7 +142,10 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
                 ipFrags[0].pktDataLen = ipDataLen + ipfroff;
                 
                 demuxIpPkt = (struct ipgram *) ipFrags[0].pkt;
+                oldField = demuxIpPkt->len;
                 demuxIpPkt->len = htons(ipFrags[0].pktDataLen + ipHdrLen);
+                demuxIpPkt->chksum = csumUpdate16(demuxIpPkt->chksum,
+                                                  oldField, demuxIpPkt->len);
             }
         }
         else if (ipFrags[0].flag == IPv4_FRAG_INCOMPLETE)
@@ -147,6 +156,22 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
             
             demuxIpPkt = (struct ipgram *) ipFrags[0].pkt;
             
+            // Keep the header of fragment zero; it is the one quoted
+            // if reassembly times out
+            if (ipfroff == 0 &&
+                ipFrags[0].dataStart == &ipFrags[0].pkt[ipHdrLen])
+            {
+                ipFrags[0].gotFirst = 1;
+                memcpy((void *) ipFrags[0].pkt, (void *) pkt, ipHdrLen);
+                if (ipFrags[0].pktDataLen != 0)
+                {
+                    oldField = demuxIpPkt->len;
+                    demuxIpPkt->len = htons(ipFrags[0].pktDataLen + ipHdrLen);
+                    demuxIpPkt->chksum = csumUpdate16(demuxIpPkt->chksum,
+                                                      oldField, demuxIpPkt->len);
+                }
+            }
+            
             // Copy the data from the ip packet
             memcpy((void *) &ipFrags[0].dataStart[ipfroff], 
                    (void *) &pkt->opts[ipHdrLen - IPv4_HDR_LEN],
@@ -159,7 +184,10 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
                 // Total pkt data len = IP pkt data len + the last fragment's offset
                 ipFrags[0].pktDataLen = ipDataLen + ipfroff;
                 
+                oldField = demuxIpPkt->len;
                 demuxIpPkt->len = htons(ipFrags[0].pktDataLen + ipHdrLen);
+                demuxIpPkt->chksum = csumUpdate16(demuxIpPkt->chksum,
+                                                  oldField, demuxIpPkt->len);
             }
             
             // If all the fragments have been collected, then set the flag to invalid
@@ -168,10 +196,11 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
             {
                 ipFrags[0].flag = IPv4_FRAG_INVALID;
                 
-                // Clean up the complete packet header for the higher layers
+                // Clean up the complete packet header for the higher layers;
+                // the stored header's checksum is kept valid incrementally
+                oldField = demuxIpPkt->flags_froff;
                 demuxIpPkt->flags_froff = 0;
-                demuxIpPkt->chksum = 0x0000;
-                demuxIpPkt->chksum = checksum((void *) demuxIpPkt, IPv4_HDR_LEN);
+                demuxIpPkt->chksum = csumUpdate16(demuxIpPkt->chksum, oldField, 0);
                 
                 // Ready for demuxing
                 demuxFlag = 1;
@@ -198,11 +227,46 @@ syscall ipRecv(struct ipgram *pkt, uchar *srcAddr)
     // If this packet is complete (has all its fragments), then demux it
     if (demuxFlag)
     {
+        // Drop what the firewall refuses before any protocol sees it;
+        // reassembled datagrams are checked whole, ports and all
+        if ((fw.table != NULL || fw.policy == FW_DROP) &&
+            fwMatch(demuxIpPkt) == FW_DROP)
+            return OK;
+        
         // Handle the received packet based on its protocol
         if (demuxIpPkt->proto == IPv4_PROTO_ICMP)
         {
             return icmpRecv(demuxIpPkt, srcAddr);
         }
+        else if (demuxIpPkt->proto == IPv4_PROTO_UDP)
+        {
+            return udpRecv(demuxIpPkt);
+        }
+        else if (demuxIpPkt->proto == IPv4_PROTO_TCP)
+        {
+            // TCP is unicast only
+            if (bcastFlag)
+                return OK;
+            return tcpRecv(demuxIpPkt);
+        }
+        
+        // No handler for this protocol, let the sender fail fast
+        if (!bcastFlag)
+            icmpSendError(demuxIpPkt, ICMP_UNREACH_T, ICMP_PROTO_UNREACH_C, 0);
     }
     return OK;
 }
+
+
+/**
+ * Abandon the datagram being reassembled, sending a fragment reassembly
+ * time exceeded error if its first fragment was received (RFC 792)
+ */
+void ipFragExpire(void)
+{
+    ipFrags[0].flag = IPv4_FRAG_INVALID;
+    
+    if (ipFrags[0].gotFirst)
+        icmpSendError((struct ipgram *) ipFrags[0].pkt,
+                      ICMP_TIMEX_T, ICMP_FRAG_EXCEEDED_C, 0);
+}
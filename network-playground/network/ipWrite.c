@@ -1,6 +1,6 @@
 /**
  * @file ipWrite.c
- * @provides ipWrite
+ * @provides ipWrite, ipSend, and ipNextId
  *
  */
 /* Author: Drew Vanderwiel, Jiayi Xin  */
@@ -12,6 +12,11 @@
 #include <ether.h>
 #include <arp.h>
 
+/* Private/helper functions */
+syscall ipResolve(ipaddr ipAddr, uchar *hwAddr);
+void ipFillHdr(struct ipgram *ipP, ushort id, ushort pktSize, uchar proto,
+               uchar ttl, uchar tos, ipaddr ipAddr);
+
 
 /**
  * Send an IPv4 packet
@@ -19,21 +24,25 @@
  * @param id       id of the packet, set by the upper layers
  * @param dataLen  Length of the payload in bytes
  * @param proto    Protocol of IPv4 service
+ * @param ttl      Time to live of the packet, normally IPv4_TTL
+ * @param tos      Precedence, IPv4_TOS_*; picks the transmit queue
+ * @param ipAddr   Destination IPv4 address
  * @return OK for success, SYSERR for syntax error
  */
-syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto, uchar *ipAddr)
+syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto,
+                uchar ttl, uchar tos, ipaddr ipAddr)
 {
-    int i;
+    struct ethPktBuffer *frame = NULL;
     struct ipgram       *ipP = NULL;
-    uchar               pktBuf[ETH_MTU];
+    ulong               hdrBuf[IPv4_HDR_LEN / 4];   /* word aligned */
     uchar               dstHwAddr[ETH_ADDR_LEN];
     uchar               *dataBytes;
-    ushort              pktSize;
     ushort              dataSize;
     ushort              froff;
+    ushort              oldLen, oldFlags;
     int                 dataLeft;
     
-    if (data == NULL || ipAddr == NULL || dataLen > (0xFFFF - IPv4_HDR_LEN))
+    if (data == NULL || dataLen > (0xFFFF - IPv4_HDR_LEN))
         return SYSERR;
     
     /*
@@ -43,80 +52,36 @@ syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto, uchar *ipAdd
     netWrite function with a destination MAC address.
     */
     
-    if (SYSERR == arpResolve(ipAddr, dstHwAddr))
-        return SYSERR;
-    
-    // Zero out the packet buffer
-    bzero(pktBuf, ETH_MTU);
-    
-    ipP = (struct ipgram *) pktBuf;
-    dataBytes = (uchar *) data;
-    
-    // Version 5, IHL size 5 * (4 byte words) = 20
-    ipP->ver_ihl = 0x45;
-    ipP->tos = IPv4_TOS_ROUTINE;
-    
-    // Set the packet size
-    pktSize = IPv4_HDR_LEN + dataLen;
-    ipP->len = htons(pktSize);
-    
-    ipP->id = htons(id);
-    ipP->flags_froff = 0;
-    ipP->ttl = IPv4_TTL;
-    ipP->proto = proto;
-    ipP->chksum = 0x0000;
-    
-     // Source protocol addr (ours)
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        ipP->src[i] = net.ipAddr[i];
-    
-    // Dest protocol addr (requester's)
-    for (i = 0; i < IP_ADDR_LEN; i++)
-        ipP->dst[i] = ipAddr[i];
-    
-    ipP->chksum = checksum((void *) ipP, IPv4_HDR_LEN);
-    
-    // The total packet size can fit in a single Ethernet packet
-    if (pktSize <= ETH_MTU)
+    // The total packet size can fit in a single Ethernet packet: copy
+    // the payload into a driver frame and send that
+    if (IPv4_HDR_LEN + dataLen <= ETH_MTU)
     {
-        // Add in the payload to the packet
-        memcpy((void *) ipP->opts, (void *) dataBytes, dataLen);
-        
-        // Make sure the packet size is at least equal to the ETHER_MINPAYLOAD
-        if (pktSize < ETHER_MINPAYLOAD)
-            pktSize = ETHER_MINPAYLOAD;
+        frame = netFrameGet();
+        if (frame == NULL)
+            return SYSERR;
         
-        // Send the packet
-        return netWrite((void *) pktBuf, pktSize, ETYPE_IPv4, (uchar *) &dstHwAddr);
+        memcpy((void *) ipFramePayload(frame), data, dataLen);
+        return ipSend(frame, id, dataLen, proto, ttl, tos, ipAddr);
     }
     
     // Otherwise, fragment the packet
-    // Initialize the header of the first fragment
-    dataSize = ETH_MTU - IPv4_HDR_LEN;
-    ipP->len = htons(IPv4_HDR_LEN + dataSize);
-    ipP->flags_froff = htons(IPv4_FLAG_MF);
-    ipP->chksum = 0x0000;
-    
-    // Calculate the Checksum
-    ipP->chksum = checksum((void *) ipP, IPv4_HDR_LEN);
-    
-    // Add in the payload to the packet
-    memcpy((void *) ipP->opts, (void *) dataBytes, dataSize);
-    
-    // Move the payload pointer up
-    dataBytes += dataSize;
-    
-    // Send the first fragment
-    pktSize = IPv4_HDR_LEN + dataSize;
-    netWrite((void *) pktBuf, pktSize, ETYPE_IPv4, (uchar *) &dstHwAddr);
+    if (SYSERR == ipResolve(ipAddr, dstHwAddr))
+        return SYSERR;
     
-    // Prepare for the next fragment
+    // Initialize the header of the first fragment. Only len and
+    // flags_froff change between fragments, so the checksum is
+    // updated incrementally (RFC 1624) rather than recomputed.
+    ipP = (struct ipgram *) hdrBuf;
+    ipFillHdr(ipP, id, IPv4_HDR_LEN + dataLen, proto, ttl, tos, ipAddr);
+    dataBytes = (uchar *) data;
     dataLeft = dataLen;
-    dataLeft -= dataSize;
-    froff = dataSize/8;
+    froff = 0;
     
     while (dataLeft > 0)
     {
+        oldLen = ipP->len;
+        oldFlags = ipP->flags_froff;
+        
         if ( dataLeft > (ETH_MTU - IPv4_HDR_LEN) )
         {
             dataSize = ETH_MTU - IPv4_HDR_LEN;
@@ -129,22 +94,21 @@ syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto, uchar *ipAdd
         }
         // Initialize the header of the fragment
         ipP->len = htons(IPv4_HDR_LEN + dataSize);
-        ipP->chksum = 0x0000;
-        
-        // Calculate the Checksum
-        ipP->chksum = checksum((void *) ipP, IPv4_HDR_LEN);
-        
-        // Add in the payload to the packet
-        memcpy((void *) ipP->opts, (void *) dataBytes, dataSize);
         
-        pktSize = IPv4_HDR_LEN + dataSize;
+        // Update the Checksum
+        ipP->chksum = csumUpdate16(ipP->chksum, oldLen, ipP->len);
+        ipP->chksum = csumUpdate16(ipP->chksum, oldFlags, ipP->flags_froff);
         
-        // Make sure the packet size is at least equal to the ETHER_MINPAYLOAD
-        if (pktSize < ETHER_MINPAYLOAD)
-            pktSize = ETHER_MINPAYLOAD;
+        // Write the header and this piece of the payload into a frame
+        frame = netFrameGet();
+        if (frame == NULL)
+            return SYSERR;
+        memcpy((void *) netFramePayload(frame), (void *) ipP, IPv4_HDR_LEN);
+        memcpy((void *) ipFramePayload(frame), (void *) dataBytes, dataSize);
         
         // Send the fragment
-        netWrite((void *) pktBuf, pktSize, ETYPE_IPv4, (uchar *) &dstHwAddr);
+        netFrameSend(frame, IPv4_HDR_LEN + dataSize, ETYPE_IPv4, dstHwAddr,
+                     tos);
         
         // Prepare for the next fragment
         dataLeft -= dataSize;
@@ -156,3 +120,127 @@ syscall ipWrite(void *data, ushort id, ushort dataLen, uchar proto, uchar *ipAdd
     
     return OK;
 }
+
+
+/**
+ * Send an IPv4 packet whose payload is already in place in a frame from
+ * netFrameGet, at ipFramePayload. Only the headers are written, so the
+ * payload is never copied again. The frame is gone afterwards.
+ * @param frame    frame holding the payload
+ * @param id       id of the packet, set by the upper layers
+ * @param dataLen  Length of the payload in bytes, at most one frame
+ * @param proto    Protocol of IPv4 service
+ * @param ttl      Time to live of the packet, normally IPv4_TTL
+ * @param tos      Precedence, IPv4_TOS_*; picks the transmit queue
+ * @param ipAddr   Destination IPv4 address
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall ipSend(struct ethPktBuffer *frame, ushort id, ushort dataLen,
+               uchar proto, uchar ttl, uchar tos, ipaddr ipAddr)
+{
+    ulong               hdrBuf[IPv4_HDR_LEN / 4];   /* word aligned */
+    uchar               dstHwAddr[ETH_ADDR_LEN];
+    
+    if (frame == NULL)
+        return SYSERR;
+    
+    if (IPv4_HDR_LEN + dataLen > ETH_MTU ||
+        SYSERR == ipResolve(ipAddr, dstHwAddr))
+    {
+        netFrameFree(frame);
+        return SYSERR;
+    }
+    
+    // Build the header in cached memory; the frame is only written
+    ipFillHdr((struct ipgram *) hdrBuf, id, IPv4_HDR_LEN + dataLen, proto,
+              ttl, tos, ipAddr);
+    memcpy((void *) netFramePayload(frame), (void *) hdrBuf, IPv4_HDR_LEN);
+    
+    return netFrameSend(frame, IPv4_HDR_LEN + dataLen, ETYPE_IPv4, dstHwAddr,
+                        tos);
+}
+
+
+/**
+ * Take the id for the next IPv4 packet this host originates. Every
+ * transport and ICMP draws from this one counter, so no two packets
+ * sent close together share an id.
+ * @return IPv4 id
+ */
+ushort ipNextId(void)
+{
+    ushort id;
+    irqmask im;
+
+    im = disable();
+    id = net.ipId++;
+    restore(im);
+
+    return id;
+}
+
+
+/**
+ * Find the MAC address an IPv4 packet to a destination is sent to
+ * @param ipAddr   Destination IPv4 address
+ * @param hwAddr   mac address return value
+ * @return OK for success, SYSERR if the next hop did not resolve
+ */
+syscall ipResolve(ipaddr ipAddr, uchar *hwAddr)
+{
+    ipaddr nextHop;
+    int i;
+    
+    // Limited broadcasts go to every host on the wire without ARP, so
+    // they work before we have an address (DHCP)
+    if (ipAddr == IPv4_ADDR_BCAST)
+    {
+        for (i = 0; i < ETH_ADDR_LEN; i++)
+            hwAddr[i] = 0xFF;
+        return OK;
+    }
+    
+    // Destinations off our subnet are reached through the gateway
+    nextHop = ipAddr;
+    if ((ipAddr & net.netmask) != (net.ipAddr & net.netmask) &&
+        net.gateway != IPv4_ADDR_ANY)
+        nextHop = net.gateway;
+    
+    return arpResolve(nextHop, hwAddr);
+}
+
+
+/**
+ * Fill in an IPv4 header without options, checksum included
+ * @param ipP      header to fill in
+ * @param id       id of the packet, set by the upper layers
+ * @param pktSize  Length of the packet in bytes, header included
+ * @param proto    Protocol of IPv4 service
+ * @param ttl      Time to live of the packet
+ * @param tos      Precedence, IPv4_TOS_*
+ * @param ipAddr   Destination IPv4 address
+ */
+void ipFillHdr(struct ipgram *ipP, ushort id, ushort pktSize, uchar proto,
+               uchar ttl, uchar tos, ipaddr ipAddr)
+{
+    // Version 5, IHL size 5 * (4 byte words) = 20
+    ipP->ver_ihl = 0x45;
+    ipP->tos = (tos & 0x7) << IPv4_TOS_PREC_SHIFT;
+    
+    // Set the packet size
+    ipP->len = htons(pktSize);
+    
+    ipP->id = htons(id);
+    ipP->flags_froff = 0;
+    ipP->ttl = ttl;
+    ipP->proto = proto;
+    ipP->chksum = 0x0000;
+    
+    // Source protocol addr (ours)
+    ipP->src = net.ipAddr;
+    
+    // Dest protocol addr (requester's)
+    ipP->dst = ipAddr;
+    
+    ipP->chksum = netChecksum((void *) ipP, IPv4_HDR_LEN);
+}
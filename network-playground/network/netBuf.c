@@ -0,0 +1,121 @@
+/**
+ * @file netBuf.c
+ * @provides netBufInit, netBufGet, and netBufFree
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/11/2016       */
+
+#include <xinu.h>
+#include <network.h>
+
+
+/**
+ * Create the network buffer pools: frames for the receive path, frames
+ * for the transmit path, and small buffers for control packets
+ * @return OK for success, SYSERR if a pool could not be made, in which
+ *         case none are left allocated
+ */
+syscall netBufInit(void)
+{
+    int i;
+    syscall result = OK;
+
+    net.pools[NET_POOL_RX].size = NET_FRAME_LEN;
+    net.pools[NET_POOL_RX].count = NET_RX_BUFS;
+    net.pools[NET_POOL_TX].size = NET_FRAME_LEN;
+    net.pools[NET_POOL_TX].count = NET_TX_BUFS;
+    net.pools[NET_POOL_CTL].size = NET_CTL_LEN;
+    net.pools[NET_POOL_CTL].count = NET_CTL_BUFS;
+
+    for (i = 0; i < NET_POOLS; i++)
+    {
+        net.pools[i].inUse = 0;
+        net.pools[i].highWater = 0;
+        net.pools[i].fails = 0;
+        net.pools[i].id = bfpalloc(net.pools[i].size, net.pools[i].count);
+        if (net.pools[i].id == SYSERR)
+            result = SYSERR;
+    }
+
+    // Give back the pools that were made if any one failed
+    if (result == SYSERR)
+    {
+        for (i = 0; i < NET_POOLS; i++)
+        {
+            if (net.pools[i].id != SYSERR)
+                bfpfree(net.pools[i].id);
+            net.pools[i].id = SYSERR;
+        }
+    }
+
+    return result;
+}
+
+
+/**
+ * Take a buffer from a network pool without blocking. Buffers are word
+ * aligned and net.pools[pool].size bytes long.
+ * @param pool NET_POOL_RX, NET_POOL_TX or NET_POOL_CTL
+ * @return buffer, NULL if the pool is empty
+ */
+void *netBufGet(int pool)
+{
+    struct netPool *p = NULL;
+    void *buf = NULL;
+    irqmask im;
+
+    if (pool < 0 || pool >= NET_POOLS)
+        return NULL;
+
+    p = &net.pools[pool];
+
+    // bufget blocks on an empty pool; the network paths drop instead
+    im = disable();
+    if (p->id == SYSERR || semcount(bfptab[p->id].freebuf) <= 0)
+    {
+        p->fails++;
+        restore(im);
+        return NULL;
+    }
+
+    buf = bufget(p->id);
+    if (++p->inUse > p->highWater)
+        p->highWater = p->inUse;
+    restore(im);
+
+    return buf;
+}
+
+
+/**
+ * Give a buffer from netBufGet back to its pool
+ * @param buf buffer to free
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netBufFree(void *buf)
+{
+    struct poolbuf *hdr = NULL;
+    irqmask im;
+    int i;
+
+    if (buf == NULL)
+        return SYSERR;
+
+    // The pool id sits in the header bufget put before the buffer
+    hdr = (struct poolbuf *) buf - 1;
+
+    im = disable();
+    for (i = 0; i < NET_POOLS; i++)
+    {
+        if (net.pools[i].id == hdr->poolid)
+        {
+            net.pools[i].inUse--;
+            break;
+        }
+    }
+    restore(im);
+
+    return buffree(buf);
+}
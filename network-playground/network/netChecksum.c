@@ -0,0 +1,246 @@
+/**
+ * @file netChecksum.c
+ * @provides csumPartial, csumPartialCopy, csumFold, netChecksum,
+ *           csumUpdate16, and ipPseudoSum
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/5/2016        */
+
+#include <xinu.h>
+#include <network.h>
+
+/**
+ * Add a word to a 32-bit one's complement sum. Carries out of bit 31
+ * are counted separately and folded back in once at the end.
+ */
+#define CSUM_ADD(sum, carry, w) \
+    { (sum) += (w); (carry) += ((sum) < (w)); }
+
+/** Two bytes in memory order, read as a host order halfword */
+union csumHalf
+{
+    ushort half;
+    uchar  bytes[2];
+};
+
+
+/**
+ * Accumulate the Internet checksum of a buffer into a running 32-bit
+ * partial sum. Words are summed in host byte order, like checksum().
+ * Every buffer but the last one of a chain must have an even length.
+ * @param buf  data to sum
+ * @param len  length of the data in bytes
+ * @param sum  partial sum of the preceding data, 0 to start
+ * @return partial sum including this buffer (fold with csumFold)
+ */
+ulong csumPartial(const void *buf, int len, ulong sum)
+{
+    const uchar     *p = (const uchar *) buf;
+    const ulong     *wp;
+    ulong           carry = 0, w;
+    union csumHalf  h;
+
+    if ((ulong) p & 1)
+    {
+        // Odd addresses cannot use halfword or word loads
+        while (len > 1)
+        {
+            h.bytes[0] = p[0];
+            h.bytes[1] = p[1];
+            w = h.half;
+            CSUM_ADD(sum, carry, w);
+            p += 2;
+            len -= 2;
+        }
+    }
+    else
+    {
+        // Step up to a word boundary
+        if (((ulong) p & 2) && len >= 2)
+        {
+            w = *(const ushort *) p;
+            CSUM_ADD(sum, carry, w);
+            p += 2;
+            len -= 2;
+        }
+
+        // Main loop, eight words per iteration
+        wp = (const ulong *) p;
+        while (len >= 32)
+        {
+            w = wp[0]; CSUM_ADD(sum, carry, w);
+            w = wp[1]; CSUM_ADD(sum, carry, w);
+            w = wp[2]; CSUM_ADD(sum, carry, w);
+            w = wp[3]; CSUM_ADD(sum, carry, w);
+            w = wp[4]; CSUM_ADD(sum, carry, w);
+            w = wp[5]; CSUM_ADD(sum, carry, w);
+            w = wp[6]; CSUM_ADD(sum, carry, w);
+            w = wp[7]; CSUM_ADD(sum, carry, w);
+            wp += 8;
+            len -= 32;
+        }
+        while (len >= 4)
+        {
+            w = *wp++;
+            CSUM_ADD(sum, carry, w);
+            len -= 4;
+        }
+        p = (const uchar *) wp;
+
+        if (len >= 2)
+        {
+            w = *(const ushort *) p;
+            CSUM_ADD(sum, carry, w);
+            p += 2;
+            len -= 2;
+        }
+    }
+
+    // A trailing byte is padded with a zero byte
+    if (len == 1)
+    {
+        h.bytes[0] = p[0];
+        h.bytes[1] = 0;
+        w = h.half;
+        CSUM_ADD(sum, carry, w);
+    }
+
+    // Fold the deferred carries back in
+    sum += carry;
+    if (sum < carry)
+        sum++;
+    return sum;
+}
+
+
+/**
+ * Copy a buffer and accumulate its Internet checksum in the same pass.
+ * Word aligned buffers are copied and summed a word at a time. The
+ * destination is only written, never read back, so it may be an
+ * uncached DMA buffer.
+ * @param dst  destination buffer
+ * @param src  source buffer
+ * @param len  length of the data in bytes
+ * @param sum  partial sum of the preceding data, 0 to start
+ * @return partial sum including this buffer (fold with csumFold)
+ */
+ulong csumPartialCopy(void *dst, const void *src, int len, ulong sum)
+{
+    const ulong *sp;
+    ulong       *dp;
+    ulong       carry = 0, w;
+    int         words;
+
+    if (((ulong) dst | (ulong) src) & 3)
+    {
+        memcpy(dst, (void *) src, len);
+        return csumPartial(src, len, sum);
+    }
+
+    sp = (const ulong *) src;
+    dp = (ulong *) dst;
+    words = len >> 2;
+
+    while (words >= 4)
+    {
+        w = sp[0]; dp[0] = w; CSUM_ADD(sum, carry, w);
+        w = sp[1]; dp[1] = w; CSUM_ADD(sum, carry, w);
+        w = sp[2]; dp[2] = w; CSUM_ADD(sum, carry, w);
+        w = sp[3]; dp[3] = w; CSUM_ADD(sum, carry, w);
+        sp += 4;
+        dp += 4;
+        words -= 4;
+    }
+    while (words > 0)
+    {
+        w = *sp++;
+        *dp++ = w;
+        CSUM_ADD(sum, carry, w);
+        words--;
+    }
+
+    sum += carry;
+    if (sum < carry)
+        sum++;
+
+    // Copy and sum the last 0-3 bytes
+    len &= 3;
+    if (len > 0)
+    {
+        memcpy((void *) dp, (void *) sp, len);
+        sum = csumPartial(sp, len, sum);
+    }
+
+    return sum;
+}
+
+
+/**
+ * Fold a 32-bit partial sum into a 16-bit Internet checksum.
+ * @param sum partial sum from csumPartial or csumPartialCopy
+ * @return one's complement checksum, ready to store in a header
+ */
+ushort csumFold(ulong sum)
+{
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (ushort) ~sum;
+}
+
+
+/**
+ * Compute the Internet checksum of a buffer. Drop-in replacement for
+ * checksum() that sums a word at a time.
+ * @param buf  data to sum
+ * @param len  length of the data in bytes
+ * @return one's complement checksum, ready to store in a header
+ */
+ushort netChecksum(const void *buf, int len)
+{
+    return csumFold(csumPartial(buf, len, 0));
+}
+
+
+/**
+ * Update an Internet checksum after one 16-bit field of the summed data
+ * changes, without touching the rest of the data (RFC 1624, eqn. 3).
+ * The field values must be in the same byte order the data was summed in.
+ * @param chksum checksum currently stored in the header
+ * @param oldVal previous value of the field
+ * @param newVal new value of the field
+ * @return updated checksum, ready to store in the header
+ */
+ushort csumUpdate16(ushort chksum, ushort oldVal, ushort newVal)
+{
+    ulong sum;
+
+    // HC' = ~(~HC + ~m + m')
+    sum = (ushort) ~chksum;
+    sum += (ushort) ~oldVal;
+    sum += newVal;
+    return csumFold(sum);
+}
+
+
+/**
+ * Sum the IPv4 pseudo-header that the UDP and TCP checksums cover.
+ * @param src   source IPv4 address
+ * @param dst   destination IPv4 address
+ * @param proto IPv4 protocol
+ * @param len   transport length, header included
+ * @return partial sum, continue it over the transport header and data
+ */
+ulong ipPseudoSum(ipaddr src, ipaddr dst, uchar proto, ushort len)
+{
+    struct ipPseudo ph;
+
+    ph.src = src;
+    ph.dst = dst;
+    ph.zero = 0;
+    ph.proto = proto;
+    ph.len = htons(len);
+
+    return csumPartial((void *) &ph, sizeof(ph), 0);
+}
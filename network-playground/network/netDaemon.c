@@ -11,6 +11,8 @@
 #include <xinu.h>
 #include <network.h>
 #include <arp.h>
+#include <dcache.h>
+#include <capture.h>
 
 
 /**
@@ -18,27 +20,78 @@
  */
 void netDaemon(void)
 {
-    uchar               packet[PKTSZ];
+    uchar               *pktBuf;
+    uchar               *packet;
+    int                 len;
     ushort              type = 0x0;
+    struct ethPktBuffer *rxPkt = NULL;
     struct ethergram    *egram = NULL;
+    struct ether        *ethptr = (struct ether *) devtab[ETH0].dvioblk;
     
-    // Zero out the packet buffer.
-    bzero(packet, PKTSZ);
+    // Bounce frame for a driver that was opened without etherRxAlign,
+    // offset so the IPv4 header lands on a word boundary
+    pktBuf = (uchar *) netBufGet(NET_POOL_RX);
+    if (pktBuf == NULL)
+        return;
+    packet = pktBuf + NET_IP_ALIGN;
     
     while(1)
     {
-        read(ETH0, (void *) &packet, PKTSZ);
+        // Give up the CPU for a while after a long run of frames
+        netRxQuota(ethptr->icount);
         
-        egram = (struct ethergram *) packet;
+        // Harvest the receive ring ourselves while its interrupt is
+        // masked; this rearms the interrupt once the ring runs dry
+        etherPoll(&devtab[ETH0], NET_RX_BUDGET);
         
-        type = ntohs(egram->type);
+        // Borrow the driver's receive buffer and parse the frame where
+        // the DMA engine wrote it
+        len = etherReadBuf(&devtab[ETH0], &rxPkt);
+        if (len <= 0 || rxPkt == NULL)
+        {
+            if (rxPkt != NULL)
+                etherReturnBuf(&devtab[ETH0], rxPkt);
+            continue;
+        }
+        
+        egram = (struct ethergram *) dcacheRxFrame(rxPkt);
+        
+        // Capture the frame as it arrived, before anything drops it
+        if (capture.on)
+            captureFrame(egram, len, CAPTURE_RX);
+        
+        // Drop frames for other stations and protocols before any
+        // copying or protocol code
+        if (SYSERR == netRxFilter(egram, len))
+        {
+            etherReturnBuf(&devtab[ETH0], rxPkt);
+            continue;
+        }
+        
+        // Shed the least valuable frames while the input queue backs up
+        if (SYSERR == netRxShed(egram, ethptr->icount))
+        {
+            etherReturnBuf(&devtab[ETH0], rxPkt);
+            continue;
+        }
+        
+        if ((ulong) egram->data & 0x3)
+        {
+            if (len > PKTSZ)
+                len = PKTSZ;
+            memcpy((void *) packet, (void *) egram, len);
+            egram = (struct ethergram *) packet;
+        }
+        
+        type = etherGetType(egram);
         
         if (ETYPE_IPv4 == type)
             ipRecv((struct ipgram *) &egram->data, (uchar *) &egram->src);
         else if(ETYPE_ARP == type)
             arpRecv((struct arpPkt *) &egram->data);
+        
+        etherReturnBuf(&devtab[ETH0], rxPkt);
     }
     
     return;
 }
-
@@ -0,0 +1,165 @@
+/**
+ * @file netFilter.c
+ * @provides netFilterInit, netRxFilter, netMcastJoin, and netMcastLeave
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <network.h>
+
+/* Private/helper functions */
+int netMcastHash(const uchar *hwAddr);
+
+
+/**
+ * Clear the receive filter's counters and multicast subscriptions, and
+ * the load shedding counters
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netFilterInit(void)
+{
+    bzero((void *) net.mcastRefs, sizeof(net.mcastRefs));
+    bzero((void *) net.rxDrops, sizeof(net.rxDrops));
+    bzero((void *) net.rxShed, sizeof(net.rxShed));
+    net.rxAccepted = 0;
+    net.rxRests = 0;
+    net.rxSliceStart = 0;
+
+    return OK;
+}
+
+
+/**
+ * Decide whether netDaemon should hand a received frame to the protocol
+ * code. A frame is kept if it is addressed to this host's MAC, to
+ * broadcast, or to a multicast group that hashes to a joined bucket,
+ * and it carries IPv4 or ARP. Anything else is counted by reason in
+ * net.rxDrops.
+ * @param eg received frame
+ * @param len length of the frame in bytes
+ * @return OK to keep the frame, SYSERR to drop it
+ */
+syscall netRxFilter(const struct ethergram *eg, int len)
+{
+    const ushort *dst = (const ushort *) eg->dst;
+    const ushort *ours = (const ushort *) net.hwAddr;
+    ushort type;
+
+    if (len < ETHER_SIZE)
+    {
+        net.rxDrops[NET_DROP_RUNT]++;
+        return SYSERR;
+    }
+
+    if (!(eg->dst[0] & 0x01))
+    {
+        // Unicast; frames are halfword aligned, so compare halfwords
+        if (dst[0] != ours[0] || dst[1] != ours[1] || dst[2] != ours[2])
+        {
+            net.rxDrops[NET_DROP_MAC]++;
+            return SYSERR;
+        }
+    }
+    else if (dst[0] != 0xFFFF || dst[1] != 0xFFFF || dst[2] != 0xFFFF)
+    {
+        if (net.mcastRefs[netMcastHash(eg->dst)] == 0)
+        {
+            net.rxDrops[NET_DROP_MCAST]++;
+            return SYSERR;
+        }
+    }
+
+    type = etherGetType(eg);
+    if (type != ETYPE_IPv4 && type != ETYPE_ARP)
+    {
+        net.rxDrops[NET_DROP_ETYPE]++;
+        return SYSERR;
+    }
+
+    net.rxAccepted++;
+    return OK;
+}
+
+
+/**
+ * Accept frames sent to a multicast group. Groups are hashed into
+ * NET_MCAST_HASH buckets, so a few other groups may get through too;
+ * the protocol code still checks the address it cares about.
+ * @param hwAddr multicast MAC address of the group
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netMcastJoin(const uchar *hwAddr)
+{
+    int bucket;
+    irqmask im;
+
+    if (hwAddr == NULL || !(hwAddr[0] & 0x01))
+        return SYSERR;
+
+    bucket = netMcastHash(hwAddr);
+
+    im = disable();
+    if (net.mcastRefs[bucket] == 0xFF)
+    {
+        restore(im);
+        return SYSERR;
+    }
+    net.mcastRefs[bucket]++;
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Stop accepting frames sent to a multicast group joined with
+ * netMcastJoin
+ * @param hwAddr multicast MAC address of the group
+ * @return OK for success, SYSERR if the group was not joined
+ */
+syscall netMcastLeave(const uchar *hwAddr)
+{
+    int bucket;
+    irqmask im;
+
+    if (hwAddr == NULL || !(hwAddr[0] & 0x01))
+        return SYSERR;
+
+    bucket = netMcastHash(hwAddr);
+
+    im = disable();
+    if (net.mcastRefs[bucket] == 0)
+    {
+        restore(im);
+        return SYSERR;
+    }
+    net.mcastRefs[bucket]--;
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Hash a MAC address into a multicast bucket: the top bits of its
+ * Ethernet CRC-32, as NIC multicast hash filters use
+ * @param hwAddr MAC address
+ * @return bucket, 0 to NET_MCAST_HASH - 1
+ */
+int netMcastHash(const uchar *hwAddr)
+{
+    ulong crc = 0xFFFFFFFF;
+    int i, bit;
+
+    for (i = 0; i < ETH_ADDR_LEN; i++)
+    {
+        crc ^= hwAddr[i];
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+
+    return (~crc >> 26) & (NET_MCAST_HASH - 1);
+}
@@ -1,6 +1,6 @@
 /**
  * @file netInit.c
- * @provides netInit.
+ * @provides netInit, netTime, and netCycles.
  *
  */
 /* Author: Drew Vanderwiel, Jiayi Xin  */
@@ -12,6 +12,13 @@
 #include <ether.h>
 #include <icmp.h>
 #include <arp.h>
+#include <udp.h>
+#include <tcp.h>
+#include <dhcp.h>
+#include <slab.h>
+#include <dcache.h>
+#include <shape.h>
+#include <firewall.h>
 
 /* Network Information Struct */
 struct netInfo net;
@@ -22,12 +29,47 @@ struct netInfo net;
  */
 void netInit(void)
 {
+    // Create the packet buffer pools before anything sends, and the
+    // object caches before the tables that allocate from them. Every
+    // layer takes its buffers from the pools, so there is no network
+    // without them.
+    if (SYSERR == netBufInit())
+        return;
+    slabInit();
+    netFilterInit();
+    
+    // Have the DMA engine word align the IPv4 header of each frame, so
+    // netDaemon can parse frames in the driver's receive buffers
+    etherRxAlign(&devtab[ETH0], NET_IP_ALIGN);
+    
+    // Parse and build frames in cached memory, maintaining only the
+    // lines each frame occupies
+    dcacheMode(DCACHE_BATCHED);
+    
     // Open the Ethernet device
     open(ETH0);
     
+    // Give the driver a spare for each receive buffer netDaemon holds
+    etherReserveBufs(&devtab[ETH0], NET_RX_LOANS);
+    
+    // Take one receive interrupt per burst and poll out the rest
+    etherPollInit(&devtab[ETH0]);
+    
+    // Queue frames by precedence in front of a short TX DMA ring
+    netTxInit();
+    
     // Get this machine's ip addr
     dot2ip(nvramGet("lan_ipaddr\0"), (uchar *) &net.ipAddr);
     
+    // Get the subnet and default gateway, if the router has one
+    if (SYSERR == dot2ip(nvramGet("lan_netmask\0"), (uchar *) &net.netmask))
+        net.netmask = IPv4_ADDR_ANY;
+    if (SYSERR == dot2ip(nvramGet("lan_gateway\0"), (uchar *) &net.gateway))
+        net.gateway = IPv4_ADDR_ANY;
+    
+    // Number the packets this host originates from one counter
+    net.ipId = 0;
+    
     // Get this machine's mac addr
     etherControl(&devtab[ETH0], ETH_CTRL_GET_MAC, (long) &net.hwAddr, 0);
     
@@ -37,11 +79,29 @@ void netInit(void)
     // Initialize the ICMP table
     icmpInit();
     
+    // Initialize the UDP socket table
+    udpInit();
+    
+    // Initialize the TCP connection table and timer
+    tcpInit();
+    
+    // Start the traffic shaper, with no rules
+    shapeInit();
+    
+    // Start the firewall with no rules, accepting every packet
+    fwInit();
+    
     // Create net daemon process
     net.dId = create((void *)netDaemon, INITSTK, 3, "NET_DAEMON", 0);
     
     // Start the network daemon
     ready(net.dId, 1);
+    
+    // Start the DHCP client, which confirms or replaces the address
+    // above in the background. Without it the static address stays
+    // in use and there is no lease to show or renew.
+    if (SYSERR == dhcpInit())
+        dhcp.cId = BADPID;
 
     return;
 }
@@ -53,4 +113,36 @@ void netInit(void)
 syscall getpid(void)
 {
     return (currpid);
-}
\ No newline at end of file
+}
+
+
+/**
+ * ctr_mS counts down from 1000 within each second of clocktime, so
+ * combine the two into a single monotonic millisecond counter.
+ * @return milliseconds since boot
+ */
+ulong netTime(void)
+{
+    irqmask im;
+    ulong ms;
+    
+    im = disable();
+    ms = clocktime * 1000 + (1000 - ctr_mS);
+    restore(im);
+    
+    return ms;
+}
+
+
+/**
+ * Read the CP0 Count register, which ticks at platform.time_base_freq,
+ * for timing shorter than netTime can
+ * @return current Count value
+ */
+ulong netCycles(void)
+{
+    ulong count;
+    
+    asm volatile ("mfc0 %0, $9" : "=r" (count));
+    return count;
+}
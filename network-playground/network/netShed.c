@@ -0,0 +1,123 @@
+/**
+ * @file netShed.c
+ * @provides netRxClass, netRxShed, and netRxQuota
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <network.h>
+#include <icmp.h>
+#include <tcp.h>
+
+/* Input queue depth at which each class is shed, indexed by class */
+static int netShedDepth[NET_CLASSES] =
+    { NET_SHED_ECHO, NET_SHED_ARP, NET_SHED_NEW, ETH_IBLEN + 1 };
+
+
+/**
+ * Sort a received frame by how much is lost if it is dropped, looking
+ * only at headers. Frames may be unaligned, so fields are read a byte
+ * at a time.
+ * @param eg frame that passed netRxFilter
+ * @return NET_CLASS_ECHO, NET_CLASS_ARP, NET_CLASS_NEW or
+ *         NET_CLASS_SESSION
+ */
+int netRxClass(const struct ethergram *eg)
+{
+    const struct ipgram *ip = NULL;
+    const uchar *l4 = NULL;
+    const uchar *froff = NULL;
+    int sd;
+    irqmask im;
+
+    if (etherGetType(eg) == ETYPE_ARP)
+        return NET_CLASS_ARP;
+
+    ip = (const struct ipgram *) eg->data;
+    froff = (const uchar *) &ip->flags_froff;
+
+    // Later fragments carry no transport header
+    if ((froff[0] & 0x1F) != 0 || froff[1] != 0)
+        return NET_CLASS_NEW;
+
+    l4 = (const uchar *) ip + ipGetHdrLen(ip);
+
+    if (ip->proto == IPv4_PROTO_ICMP && l4[0] == ICMP_ECHO_RQST_T)
+        return NET_CLASS_ECHO;
+
+    // Only segments of a connection in the table are worth keeping; a
+    // stray or forged segment would just be answered with a reset. The
+    // table is scanned with interrupts off rather than under tcp.sema,
+    // so netDaemon never blocks here.
+    if (ip->proto == IPv4_PROTO_TCP &&
+        (((const struct tcpgram *) l4)->flags &
+         (TCP_FLAG_SYN | TCP_FLAG_ACK)) != TCP_FLAG_SYN)
+    {
+        im = disable();
+        sd = tcpLookup(IP_LOAD((const uchar *) &ip->src),
+                       (l4[0] << 8) | l4[1], (l4[2] << 8) | l4[3]);
+        restore(im);
+        if (sd != TCP_NO_CONN)
+            return NET_CLASS_SESSION;
+    }
+
+    return NET_CLASS_NEW;
+}
+
+
+/**
+ * Decide whether to shed a received frame because netDaemon is falling
+ * behind. The deeper the driver's input queue, the more classes are
+ * shed: echo requests first, then ARP, then everything but segments of
+ * open TCP connections. Shed frames are counted in net.rxShed.
+ * @param eg frame that passed netRxFilter
+ * @param depth frames waiting in the driver's input queue
+ * @return OK to keep the frame, SYSERR to drop it
+ */
+syscall netRxShed(const struct ethergram *eg, int depth)
+{
+    int class;
+
+    if (depth < NET_SHED_ECHO)
+        return OK;
+
+    class = netRxClass(eg);
+    if (depth < netShedDepth[class])
+        return OK;
+
+    net.rxShed[class]++;
+    return SYSERR;
+}
+
+
+/**
+ * Cap netDaemon's share of the CPU. Once it has run NET_RX_SLICE ms
+ * without finding its input queue empty, it sleeps NET_RX_REST ms so
+ * other processes run; frames queue up meanwhile, and netRxShed sheds
+ * them by class.
+ * @param depth frames waiting in the driver's input queue
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netRxQuota(int depth)
+{
+    ulong now = netTime();
+
+    // About to block for the next frame: the slice starts over
+    if (depth <= 0)
+    {
+        net.rxSliceStart = now;
+        return OK;
+    }
+
+    if (now - net.rxSliceStart < NET_RX_SLICE)
+        return OK;
+
+    net.rxRests++;
+    sleep(NET_RX_REST);
+    net.rxSliceStart = netTime();
+
+    return OK;
+}
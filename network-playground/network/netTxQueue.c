@@ -0,0 +1,264 @@
+/**
+ * @file netTxQueue.c
+ * @provides netTxInit, netTxEnqueue, netTxKick, netTxClear, and
+ *           netTxLatency
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <network.h>
+#include <ether.h>
+#include <capture.h>
+
+/* Global transmit queue state definition */
+struct netTxInfo netTx;
+
+/* Frames sent per weighted round-robin turn, indexed by queue */
+static int netTxWeight[NET_TXQS] =
+    { 0, NET_TXQ_WEIGHT_MID, NET_TXQ_WEIGHT_LOW };
+
+/* Private/helper functions */
+int netTxPick(void);
+void netTxRecord(struct netTxQueue *q, ulong stamp);
+
+
+/**
+ * Set up the transmit queues and hold the TX DMA ring to
+ * NET_TX_RING_LIMIT frames, so a frame queued behind a burst waits for
+ * at most that many frames already posted. Must follow etherPollInit,
+ * which calls netTxKick after each TX interrupt.
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netTxInit(void)
+{
+    bzero((void *) &netTx, sizeof(netTx));
+    netTx.turn = NET_TXQ_MID;
+    netTx.credit = netTxWeight[NET_TXQ_MID];
+    netTx.mhz = platform.time_base_freq / 1000000;
+    if (netTx.mhz == 0)
+        netTx.mhz = 1;
+
+    if (SYSERR == etherTxLimit(&devtab[ETH0], NET_TX_RING_LIMIT))
+        return SYSERR;
+    ethTx.txDone = netTxKick;
+
+    return OK;
+}
+
+
+/**
+ * Queue a frame by precedence and post as much as the TX DMA ring has
+ * room for. Internetwork and network control go to NET_TXQ_HIGH, which
+ * is always served first; routine traffic goes to NET_TXQ_LOW, and the
+ * rest to NET_TXQ_MID, which share what is left by weighted round-robin.
+ * @param frame frame from netFrameGet, Ethernet header filled in
+ * @param len   length of the frame in bytes
+ * @param tos   precedence, IPv4_TOS_*
+ * @return OK for success, SYSERR if the queue is full; the caller still
+ *         owns the frame then
+ */
+syscall netTxEnqueue(struct ethPktBuffer *frame, ushort len, uchar tos)
+{
+    struct netTxQueue *q = NULL;
+    int slot;
+    irqmask im;
+
+    if (frame == NULL)
+        return SYSERR;
+
+    if (tos >= IPv4_TOS_INTCNTRL)
+        q = &netTx.queues[NET_TXQ_HIGH];
+    else if (tos > IPv4_TOS_ROUTINE)
+        q = &netTx.queues[NET_TXQ_MID];
+    else
+        q = &netTx.queues[NET_TXQ_LOW];
+
+    im = disable();
+    if (q->count == NET_TXQ_LEN)
+    {
+        q->drops++;
+        restore(im);
+        return SYSERR;
+    }
+
+    // Captured only once it is sure to be queued, and only as it is; a
+    // shaped frame shows when the shaper let it go
+    if (capture.on)
+        captureFrame((void *) frame->data, len, CAPTURE_TX);
+
+    slot = (q->head + q->count) % NET_TXQ_LEN;
+    q->frames[slot] = frame;
+    q->lens[slot] = len;
+    q->stamps[slot] = netCycles();
+    q->count++;
+    if (q->count > q->maxDepth)
+        q->maxDepth = q->count;
+
+    netTxKick();
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Move queued frames into the TX DMA ring while it is under its limit,
+ * highest priority first. Called after queueing a frame and, through
+ * ethTx.txDone, after each TX interrupt. If that frees room in the
+ * queues, netTx.wake is called for senders waiting on it.
+ * Caution: This function must be called with interrupts disabled.
+ */
+void netTxKick(void)
+{
+    struct netTxQueue *q = NULL;
+    struct ethPktBuffer *frame = NULL;
+    int space, which, moved;
+    ushort len;
+
+    moved = 0;
+
+    // Frames posted without IOC are only freed by a reclaim
+    etherTxReclaim(&devtab[ETH0]);
+    space = etherTxSpace(&devtab[ETH0]);
+
+    while (space > 0 && (which = netTxPick()) != SYSERR)
+    {
+        q = &netTx.queues[which];
+        frame = q->frames[q->head];
+        len = q->lens[q->head];
+        netTxRecord(q, q->stamps[q->head]);
+        q->head = (q->head + 1) % NET_TXQ_LEN;
+        q->count--;
+        moved++;
+
+        if (SYSERR == etherWriteBuf(&devtab[ETH0], frame, len))
+        {
+            netFrameFree(frame);
+            continue;
+        }
+        q->sent++;
+        space--;
+    }
+
+    if (moved > 0 && netTx.wake != NULL)
+        (*netTx.wake)();
+}
+
+
+/**
+ * Clear the transmit queue counters and wait histograms. Queued frames
+ * are left alone.
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netTxClear(void)
+{
+    struct netTxQueue *q = NULL;
+    irqmask im;
+    int i;
+
+    im = disable();
+    for (i = 0; i < NET_TXQS; i++)
+    {
+        q = &netTx.queues[i];
+        q->sent = 0;
+        q->drops = 0;
+        q->maxDepth = q->count;
+        q->maxWait = 0;
+        bzero((void *) q->hist, sizeof(q->hist));
+    }
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Estimate a percentile of the time frames in a queue waited for the
+ * TX DMA ring, from its histogram
+ * @param queue NET_TXQ_*
+ * @param pct   percentile, 1 to 100
+ * @return upper bound of the percentile's bucket in us, 0 if nothing
+ *         was sent
+ */
+ulong netTxLatency(int queue, int pct)
+{
+    struct netTxQueue *q = NULL;
+    ulong total, target, seen;
+    int b;
+
+    if (queue < 0 || queue >= NET_TXQS || pct < 1 || pct > 100)
+        return 0;
+
+    q = &netTx.queues[queue];
+    total = 0;
+    for (b = 0; b < NET_TX_HIST; b++)
+        total += q->hist[b];
+    if (total == 0)
+        return 0;
+
+    target = (total * pct + 99) / 100;
+    seen = 0;
+    for (b = 0; b < NET_TX_HIST - 1; b++)
+    {
+        seen += q->hist[b];
+        if (seen >= target)
+            break;
+    }
+
+    return 1UL << b;
+}
+
+
+/**
+ * Choose the queue to post from next: NET_TXQ_HIGH whenever it has a
+ * frame, otherwise NET_TXQ_MID and NET_TXQ_LOW in turns of their weight.
+ * A turn ends early if its queue runs dry.
+ * Caution: This function must be called with interrupts disabled.
+ * @return NET_TXQ_*, SYSERR if every queue is empty
+ */
+int netTxPick(void)
+{
+    int i;
+
+    if (netTx.queues[NET_TXQ_HIGH].count > 0)
+        return NET_TXQ_HIGH;
+
+    // Three looks: the current turn, the other queue's, and back again
+    // with fresh credit
+    for (i = 0; i < 3; i++)
+    {
+        if (netTx.credit > 0 && netTx.queues[netTx.turn].count > 0)
+        {
+            netTx.credit--;
+            return netTx.turn;
+        }
+        netTx.turn = (netTx.turn == NET_TXQ_MID) ? NET_TXQ_LOW : NET_TXQ_MID;
+        netTx.credit = netTxWeight[netTx.turn];
+    }
+
+    return SYSERR;
+}
+
+
+/**
+ * Add how long a frame waited in its queue to the queue's histogram
+ * Caution: This function must be called with interrupts disabled.
+ * @param q     queue the frame is leaving
+ * @param stamp netCycles when it was queued
+ */
+void netTxRecord(struct netTxQueue *q, ulong stamp)
+{
+    ulong us;
+    int b;
+
+    us = (netCycles() - stamp) / netTx.mhz;
+    if (us > q->maxWait)
+        q->maxWait = us;
+
+    for (b = 0; b < NET_TX_HIST - 1 && (us >> b) != 0; b++)
+        ;
+    q->hist[b]++;
+}
@@ -1,6 +1,6 @@
 /**
  * @file netWrite.c
- * @provides netWrite
+ * @provides netWrite, netFrameGet, netFrameSend, and netFrameFree
  *
  */
 /* Author: Drew Vanderwiel, Jiayi Xin  */
@@ -10,6 +10,7 @@
 #include <xinu.h>
 #include <network.h>
 #include <ether.h>
+#include <shape.h>
 
 
 /**
@@ -18,22 +19,69 @@
  * @param payloadLen    length in bytes of the payload
  * @param type          Ethernet packet type
  * @param mac           Destination HW MAC address
+ * @param tos           Precedence, IPv4_TOS_*; picks the transmit queue
  * @return OK for success, SYSERR for syntax error
  */
-syscall netWrite(void *payload, ushort payloadLen, ushort type, uchar *hwAddr)
+syscall netWrite(void *payload, ushort payloadLen, ushort type, uchar *hwAddr,
+                 uchar tos)
+{
+    struct ethPktBuffer *frame = NULL;
+    
+    if (payload == NULL || hwAddr == NULL || payloadLen > ETH_MTU)
+        return SYSERR;
+    
+    frame = netFrameGet();
+    if (frame == NULL)
+        return SYSERR;
+    
+    memcpy((void *) netFramePayload(frame), payload, payloadLen);
+    
+    return netFrameSend(frame, payloadLen, type, hwAddr, tos);
+}
+
+
+/**
+ * Take a transmit buffer from the driver to build a frame in. The frame
+ * starts NET_IP_ALIGN bytes in, so its payload is word aligned; callers
+ * write the payload at netFramePayload and netFrameSend fills in the
+ * Ethernet header in front of it.
+ * @return frame, NULL if the device is down
+ */
+struct ethPktBuffer *netFrameGet(void)
+{
+    return etherGetBuf(&devtab[ETH0], NET_IP_ALIGN);
+}
+
+
+/**
+ * Fill in the Ethernet header of a frame from netFrameGet and queue the
+ * frame for the DMA engine by its precedence, through the shaper if its
+ * destination is shaped. The frame is gone afterwards, sent or not.
+ * @param frame       frame holding the payload
+ * @param payloadLen  length in bytes of the payload
+ * @param type        Ethernet packet type
+ * @param hwAddr      Destination HW MAC address
+ * @param tos         Precedence, IPv4_TOS_*; picks the transmit queue
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netFrameSend(struct ethPktBuffer *frame, ushort payloadLen,
+                     ushort type, uchar *hwAddr, uchar tos)
 {
     int i;
     struct ethergram    *egram = NULL;
-    uchar               pktBuf[PKTSZ];
+    syscall             result;
     
-    if (payload == NULL || hwAddr == NULL || payloadLen > ETH_MTU)
+    if (frame == NULL)
         return SYSERR;
     
-    // Zero out the packet buffer
-    bzero(pktBuf, PKTSZ);
+    if (hwAddr == NULL || payloadLen > ETH_MTU)
+    {
+        netFrameFree(frame);
+        return SYSERR;
+    }
     
     /* Set up Ethergram header */
-    egram = (struct ethergram *) pktBuf;
+    egram = (struct ethergram *) frame->data;
     
     for (i = 0; i < ETH_ADDR_LEN; i++)
         egram->dst[i] = hwAddr[i];
@@ -43,9 +91,36 @@ syscall netWrite(void *payload, ushort payloadLen, ushort type, uchar *hwAddr)
     
     egram->type = htons(type);
     
-    memcpy((void *) egram->data, payload, payloadLen);
+    // Driver buffers are reused, so short frames are padded with zeros
+    // rather than whatever the last frame left there
+    if (payloadLen < ETHER_MINPAYLOAD)
+    {
+        bzero((void *) &egram->data[payloadLen], ETHER_MINPAYLOAD - payloadLen);
+        payloadLen = ETHER_MINPAYLOAD;
+    }
     
-    write(ETH0, (uchar *) pktBuf, ETH_HEADER_LEN + payloadLen);
+    // IPv4 frames go through the shaper only while it has rules, so
+    // unshaped traffic pays one compare
+    if (shape.active > 0 && type == ETYPE_IPv4)
+        result = shapeSend(frame, ETH_HEADER_LEN + payloadLen, tos);
+    else
+        result = netTxEnqueue(frame, ETH_HEADER_LEN + payloadLen, tos);
     
+    if (SYSERR == result)
+    {
+        netFrameFree(frame);
+        return SYSERR;
+    }
     return OK;
 }
+
+
+/**
+ * Give back a frame from netFrameGet that will not be sent
+ * @param frame frame to free
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall netFrameFree(struct ethPktBuffer *frame)
+{
+    return etherReturnBuf(&devtab[ETH0], frame);
+}
@@ -0,0 +1,389 @@
+/**
+ * @file shape.c
+ * @provides shapeInit, shapeDaemon, shapeKick, shapeAdd, shapeRemove,
+ *           and shapeSend
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+#include <xinu.h>
+#include <shape.h>
+
+/* Global traffic shaper definition */
+struct shapeInfo shape;
+
+/* Private/helper functions */
+void shapeRefill(struct shapeRule *r, ulong now);
+ulong shapeRelease(void);
+int shapeFlush(struct shapeRule *r);
+
+
+/**
+ * Clear the shaping rules and start the shaper process, which sends
+ * held frames as their buckets refill
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall shapeInit(void)
+{
+    bzero((void *) shape.rules, sizeof(shape.rules));
+    shape.active = 0;
+    shape.held = 0;
+    shape.blocked = FALSE;
+
+    shape.sId = create((void *)shapeDaemon, INITSTK, 3, "SHAPER", 0);
+    if (shape.sId == SYSERR)
+        return SYSERR;
+
+    // Held frames that found the transmit queues full are retried as
+    // soon as they drain
+    netTx.wake = shapeKick;
+
+    ready(shape.sId, 1);
+
+    return OK;
+}
+
+
+/**
+ * Shaper process: sends held frames once their buckets have the tokens,
+ * then waits until the next one can go, or for a message if none are
+ * held. shapeSend and the rule changes send one whenever the soonest
+ * frame may have moved, so a slow rule does not hold up the others, and
+ * shapeKick sends one when the transmit queues take frames again.
+ */
+void shapeDaemon(void)
+{
+    ulong delay;
+
+    while (TRUE)
+    {
+        // A message sent while releasing is kept for the wait below
+        recvclr();
+        delay = shapeRelease();
+        if (delay == 0)
+            receive();
+        else
+            recvtime(delay);
+    }
+}
+
+
+/**
+ * Wake the shaper process if a held frame found the transmit queues
+ * full. Called through netTx.wake once netTxKick has made room.
+ * Caution: This function must be called with interrupts disabled.
+ */
+void shapeKick(void)
+{
+    if (shape.blocked)
+    {
+        shape.blocked = FALSE;
+        send(shape.sId, (message) 1);
+    }
+}
+
+
+/**
+ * Shape the traffic to a destination prefix. Frames to it go out at no
+ * more than kbps on average, with bursts of up to burst bytes; the rest
+ * are held back in order, not dropped, unless SHAPE_QLEN are already
+ * waiting. Adding a prefix again changes its rate.
+ * @param dst   destination prefix
+ * @param mask  its netmask, IPv4_ADDR_BCAST for a single host
+ * @param kbps  average rate in kbit/s
+ * @param burst bucket depth in bytes, at least SHAPE_BURST_MIN
+ * @return OK for success, SYSERR for syntax error or a full table
+ */
+syscall shapeAdd(ipaddr dst, ipaddr mask, ulong kbps, ulong burst)
+{
+    struct shapeRule *r = NULL;
+    irqmask im;
+    int i;
+
+    if (kbps == 0 || kbps > SHAPE_RATE_MAX ||
+        burst < SHAPE_BURST_MIN || burst > SHAPE_BURST_MAX)
+        return SYSERR;
+
+    im = disable();
+    for (i = 0; i < SHAPE_RULES; i++)
+    {
+        if (shape.rules[i].rate != 0 && shape.rules[i].dst == (dst & mask) &&
+            shape.rules[i].mask == mask)
+            break;
+    }
+    if (i == SHAPE_RULES)
+    {
+        for (i = 0; i < SHAPE_RULES && shape.rules[i].rate != 0; i++)
+            ;
+        if (i == SHAPE_RULES)
+        {
+            restore(im);
+            return SYSERR;
+        }
+        r = &shape.rules[i];
+        bzero((void *) r, sizeof(*r));
+        r->dst = dst & mask;
+        r->mask = mask;
+        r->tokens = burst * 8;
+        r->last = netTime();
+        shape.active++;
+    }
+    else
+    {
+        // Tokens earned so far are earned at the old rate. A rule
+        // still sending what it held when removed is shaped again.
+        r = &shape.rules[i];
+        shapeRefill(r, netTime());
+        r->removed = FALSE;
+    }
+
+    r->rate = kbps;
+    r->burst = burst * 8;
+    if (r->tokens > r->burst)
+        r->tokens = r->burst;
+    restore(im);
+
+    // Held frames may be able to go sooner now
+    send(shape.sId, (message) 1);
+
+    return OK;
+}
+
+
+/**
+ * Stop shaping the traffic to a destination prefix. Frames it was
+ * holding are sent at once; those the transmit queues cannot take yet
+ * stay held, and the rule is only freed once the shaper process has
+ * sent them, so frames to the prefix keep their order.
+ * @param dst   destination prefix given to shapeAdd
+ * @param mask  its netmask
+ * @return OK for success, SYSERR if the prefix was not shaped
+ */
+syscall shapeRemove(ipaddr dst, ipaddr mask)
+{
+    struct shapeRule *r = NULL;
+    irqmask im;
+    int i;
+
+    im = disable();
+    for (i = 0; i < SHAPE_RULES; i++)
+    {
+        r = &shape.rules[i];
+        if (r->rate != 0 && !r->removed && r->dst == (dst & mask) &&
+            r->mask == mask)
+        {
+            r->removed = TRUE;
+            shapeFlush(r);
+            if (r->count == 0)
+            {
+                r->removed = FALSE;
+                r->rate = 0;
+                shape.active--;
+            }
+            restore(im);
+
+            // The shaper process may be waiting on this rule
+            send(shape.sId, (message) 1);
+            return OK;
+        }
+    }
+    restore(im);
+
+    return SYSERR;
+}
+
+
+/**
+ * Send an IPv4 frame through the shaper. A frame for a shaped prefix
+ * goes straight to the transmit queues if its bucket has the tokens and
+ * nothing is held ahead of it; otherwise it is held until the shaper
+ * process sends it. Frames for other destinations pass untouched.
+ * A removed rule still holding frames always has some held, so new
+ * frames queue behind them.
+ * @param frame frame from netFrameGet, headers filled in
+ * @param len   length of the frame in bytes
+ * @param tos   precedence, IPv4_TOS_*
+ * @return OK for success, SYSERR if the frame could not be queued; the
+ *         caller still owns the frame then
+ */
+syscall shapeSend(struct ethPktBuffer *frame, ushort len, uchar tos)
+{
+    struct shapeRule *r = NULL;
+    const struct ipgram *ip = NULL;
+    ulong bits;
+    irqmask im;
+    bool wake;
+    int i, slot;
+
+    ip = (const struct ipgram *) netFramePayload(frame);
+    for (i = 0; i < SHAPE_RULES; i++)
+    {
+        r = &shape.rules[i];
+        if (r->rate != 0 && (ip->dst & r->mask) == r->dst)
+            break;
+    }
+    if (i == SHAPE_RULES)
+        return netTxEnqueue(frame, len, tos);
+
+    bits = (ulong) len * 8;
+
+    im = disable();
+    shapeRefill(r, netTime());
+    if (r->count == 0 && r->tokens >= bits)
+    {
+        r->tokens -= bits;
+        r->passed++;
+        r->bytes += len;
+        restore(im);
+        return netTxEnqueue(frame, len, tos);
+    }
+
+    if (r->count == SHAPE_QLEN)
+    {
+        r->dropped++;
+        restore(im);
+        return SYSERR;
+    }
+
+    slot = (r->head + r->count) % SHAPE_QLEN;
+    r->frames[slot] = frame;
+    r->lens[slot] = len;
+    r->tos[slot] = tos;
+    wake = (r->count++ == 0);
+    shape.held++;
+    restore(im);
+
+    // The frame at the head of a queue sets when the shaper process
+    // next wakes; frames behind it go no sooner
+    if (wake)
+        send(shape.sId, (message) 1);
+
+    return OK;
+}
+
+
+/**
+ * Add the tokens a bucket earned since its last refill, up to its depth
+ * Caution: This function must be called with interrupts disabled.
+ * @param r    rule to refill
+ * @param now  netTime
+ */
+void shapeRefill(struct shapeRule *r, ulong now)
+{
+    ulong elapsed = now - r->last;
+
+    r->last = now;
+
+    // Long enough to fill the bucket; also keeps elapsed * rate in range
+    if (elapsed > r->burst / r->rate)
+        r->tokens = r->burst;
+    else if (r->tokens + elapsed * r->rate > r->burst)
+        r->tokens = r->burst;
+    else
+        r->tokens += elapsed * r->rate;
+}
+
+
+/**
+ * Send every held frame whose bucket has the tokens, oldest first.
+ * Tokens are only spent on a frame the transmit queues took; one they
+ * could not take stays at the head of its rule, and shape.blocked has
+ * shapeKick wake the shaper process to try it again. Removed rules send
+ * without tokens and are freed once they hold nothing.
+ * @return ms until the next held frame has the tokens to go, 0 if none
+ *         is waiting on tokens
+ */
+ulong shapeRelease(void)
+{
+    struct shapeRule *r = NULL;
+    struct ethPktBuffer *frame = NULL;
+    ulong bits, delay, next;
+    ushort len;
+    irqmask im;
+    int i;
+
+    next = 0;
+
+    for (i = 0; i < SHAPE_RULES; i++)
+    {
+        r = &shape.rules[i];
+
+        im = disable();
+        if (r->rate == 0 || r->count == 0)
+        {
+            restore(im);
+            continue;
+        }
+
+        shapeRefill(r, netTime());
+        while (r->count > 0)
+        {
+            len = r->lens[r->head];
+            bits = (ulong) len * 8;
+            if (!r->removed && r->tokens < bits)
+                break;
+
+            frame = r->frames[r->head];
+            if (SYSERR == netTxEnqueue(frame, len, r->tos[r->head]))
+            {
+                shape.blocked = TRUE;
+                break;
+            }
+            r->tokens = (r->tokens > bits) ? r->tokens - bits : 0;
+            r->delayed++;
+            r->bytes += len;
+            r->head = (r->head + 1) % SHAPE_QLEN;
+            r->count--;
+            shape.held--;
+        }
+
+        if (r->removed && r->count == 0)
+        {
+            r->removed = FALSE;
+            r->rate = 0;
+            shape.active--;
+        }
+        else if (r->count > 0 && !r->removed && r->tokens < bits)
+        {
+            delay = (bits - r->tokens + r->rate - 1) / r->rate;
+            if (next == 0 || delay < next)
+                next = delay;
+        }
+        restore(im);
+    }
+
+    return next;
+}
+
+
+/**
+ * Send every frame a rule is holding, tokens or not, until the transmit
+ * queues are full. Frames they cannot take stay held, in order, and
+ * shape.blocked has shapeKick wake the shaper process to send them.
+ * Caution: This function must be called with interrupts disabled.
+ * @param r rule to empty
+ * @return count of frames sent
+ */
+int shapeFlush(struct shapeRule *r)
+{
+    struct ethPktBuffer *frame = NULL;
+    int sent = 0;
+
+    while (r->count > 0)
+    {
+        frame = r->frames[r->head];
+        if (SYSERR == netTxEnqueue(frame, r->lens[r->head], r->tos[r->head]))
+        {
+            shape.blocked = TRUE;
+            break;
+        }
+        sent++;
+        r->head = (r->head + 1) % SHAPE_QLEN;
+        r->count--;
+        shape.held--;
+    }
+
+    return sent;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file slab.c
+ * @provides slabInit, slabCreate, slabAlloc, and slabFree
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/12/2016       */
+
+#include <xinu.h>
+#include <slab.h>
+
+/* Global slab cache table definition */
+struct slabInfo slab;
+
+/* Private/helper functions */
+syscall slabGrow(struct slabCache *cache);
+
+
+/**
+ * Clear the slab cache table
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall slabInit(void)
+{
+    bzero((void *) &slab, sizeof(slab));
+    return OK;
+}
+
+
+/**
+ * Create a cache of objects of one type. The first slab is carved out
+ * now, so allocations up to perSlab objects never touch the heap.
+ * @param name type name shown by netstat
+ * @param size bytes per object
+ * @param perSlab objects carved from each slab
+ * @param maxSlabs most slabs the cache may take from the heap
+ * @return cache id for success, SYSERR if the table is full or out of
+ *         memory
+ */
+int slabCreate(char *name, ulong size, ulong perSlab, ulong maxSlabs)
+{
+    int id;
+    struct slabCache *cache = NULL;
+    irqmask im;
+
+    if (name == NULL || size == 0 || perSlab == 0 || maxSlabs == 0)
+        return SYSERR;
+
+    im = disable();
+    for (id = 0; id < SLAB_MAX_CACHES; id++)
+    {
+        if (slab.caches[id].name == NULL)
+            break;
+    }
+    if (id == SLAB_MAX_CACHES)
+    {
+        restore(im);
+        return SYSERR;
+    }
+
+    cache = &slab.caches[id];
+    bzero((void *) cache, sizeof(struct slabCache));
+    cache->name = name;
+    cache->objSize = slabRound((size < SLAB_MIN_OBJ) ? SLAB_MIN_OBJ : size);
+    cache->perSlab = perSlab;
+    cache->maxSlabs = maxSlabs;
+
+    if (slabGrow(cache) == SYSERR)
+    {
+        cache->name = NULL;
+        restore(im);
+        return SYSERR;
+    }
+    restore(im);
+
+    return id;
+}
+
+
+/**
+ * Take an object from a cache. Objects start on a D-cache line and are
+ * not cleared. Once a cache has grown this is a free list pop.
+ * @param id cache id from slabCreate
+ * @return object, NULL if the cache is at maxSlabs and empty
+ */
+void *slabAlloc(int id)
+{
+    struct slabCache *cache = NULL;
+    struct slabObj *obj = NULL;
+    irqmask im;
+
+    if (id < 0 || id >= SLAB_MAX_CACHES || slab.caches[id].name == NULL)
+        return NULL;
+
+    cache = &slab.caches[id];
+
+    im = disable();
+    if (cache->free == NULL && slabGrow(cache) == SYSERR)
+    {
+        cache->fails++;
+        restore(im);
+        return NULL;
+    }
+
+    obj = cache->free;
+    cache->free = obj->next;
+    cache->allocs++;
+    if (++cache->inUse > cache->highWater)
+        cache->highWater = cache->inUse;
+    restore(im);
+
+    return (void *) obj;
+}
+
+
+/**
+ * Give an object back to its cache. Slabs are never returned to the
+ * heap, so a type's churn cannot fragment the shared freelist.
+ * @param id cache id from slabCreate
+ * @param obj object from slabAlloc on the same cache
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall slabFree(int id, void *obj)
+{
+    struct slabCache *cache = NULL;
+    irqmask im;
+
+    if (obj == NULL || id < 0 || id >= SLAB_MAX_CACHES ||
+        slab.caches[id].name == NULL)
+        return SYSERR;
+
+    cache = &slab.caches[id];
+
+    im = disable();
+    ((struct slabObj *) obj)->next = cache->free;
+    cache->free = (struct slabObj *) obj;
+    cache->inUse--;
+    restore(im);
+
+    return OK;
+}
+
+
+/**
+ * Carve a new slab from the heap into free objects
+ * Caution: This function must be called with interrupts disabled.
+ * @param cache cache to grow
+ * @return OK for success, SYSERR if at maxSlabs or out of memory
+ */
+syscall slabGrow(struct slabCache *cache)
+{
+    uchar *mem = NULL;
+    struct slabObj *obj = NULL;
+    ulong i;
+
+    if (cache->slabs >= cache->maxSlabs)
+        return SYSERR;
+
+    // getmem only promises 8 byte alignment; take the slack to start
+    // the slab on a cache line
+    mem = (uchar *) getmem(cache->objSize * cache->perSlab +
+                           D_CACHE_LINE - 1);
+    if (mem == (uchar *) SYSERR || mem == NULL)
+        return SYSERR;
+    mem = (uchar *) slabRound((ulong) mem);
+
+    // Thread the objects so the lowest address is handed out first
+    for (i = cache->perSlab; i > 0; i--)
+    {
+        obj = (struct slabObj *) (mem + (i - 1) * cache->objSize);
+        obj->next = cache->free;
+        cache->free = obj;
+    }
+    cache->slabs++;
+
+    return OK;
+}
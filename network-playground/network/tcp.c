@@ -0,0 +1,263 @@
+/**
+ * @file tcp.c
+ * @provides tcpInit, tcpTimer, tcpAlloc, tcpFree, tcpUnlock, tcpWake,
+ *           tcpSetClosed, tcpDeadline, and tcpIss
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/8/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <tcp.h>
+#include <slab.h>
+
+/* Global TCP connection table definition */
+struct tcpInfo tcp;
+
+
+/**
+ * Initialize the TCP connection table and start the TCP timer process
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall tcpInit(void)
+{
+    int i;
+
+    tcp.sema = semcreate(1);
+    tcp.nextEphem = TCP_EPHEM_FIRST;
+    tcp.segsIn = 0;
+    tcp.segsOut = 0;
+    tcp.retransmits = 0;
+    tcp.badSum = 0;
+    tcp.outCount = 0;
+    tcp.outDrops = 0;
+
+    // Each connection takes one send and one receive ring, both made
+    // from the same slab
+    tcp.bufSlab = slabCreate("tcp ring",
+                             (TCP_SNDBUF > TCP_RCVBUF) ? TCP_SNDBUF : TCP_RCVBUF,
+                             2, TCP_MAX_CONNS);
+
+    for (i = 0; i < TCP_MAX_CONNS; i++)
+    {
+        tcp.tcbs[i].state = TCP_CLOSED;
+        tcp.tcbs[i].flags = 0;
+        tcp.tcbs[i].pid = TCP_NO_PID;
+        tcp.tcbs[i].sndBuf = NULL;
+        tcp.tcbs[i].rcvBuf = NULL;
+    }
+
+    /* Create TCP timer */
+    tcp.tId = create((void *)tcpTimer, INITSTK, 3, "TCP_TIMER", 0);
+
+    ready(tcp.tId, 1);
+
+    return OK;
+}
+
+
+/**
+ * TCP timer process: sends delayed ACKs, retransmits segments whose
+ * RTO has run out, probes closed windows, and ends TIME_WAIT and the
+ * FIN_WAIT_2 of orphaned connections
+ */
+void tcpTimer(void)
+{
+    int i;
+    ulong now;
+    struct tcb *t = NULL;
+
+    while (1)
+    {
+        sleep(TCP_TICK);
+        wait(tcp.sema);
+        now = netTime();
+        for (i = 0; i < TCP_MAX_CONNS; i++)
+        {
+            t = &tcp.tcbs[i];
+            if (!(t->flags & TCP_CF_INUSE) || t->state == TCP_CLOSED ||
+                t->state == TCP_LISTEN)
+                continue;
+
+            if (t->state == TCP_TIME_WAIT)
+            {
+                if (TCP_EXPIRED(now, t->waitTime))
+                    tcpSetClosed(t);
+                continue;
+            }
+
+            // Only an orphan has a FIN_WAIT_2 deadline
+            if (t->state == TCP_FIN_WAIT_2 && TCP_EXPIRED(now, t->waitTime))
+            {
+                tcpSetClosed(t);
+                continue;
+            }
+
+            if (TCP_EXPIRED(now, t->rtoTime))
+            {
+                tcpRetransmit(t);
+                if (t->state == TCP_CLOSED)
+                    continue;
+            }
+
+            if (TCP_EXPIRED(now, t->persistTime))
+                tcpProbe(t);
+
+            if (TCP_EXPIRED(now, t->ackTime))
+                tcpSendSegment(t, TCP_FLAG_ACK, t->sndNxt, 0);
+        }
+        tcpUnlock();
+    }
+
+    return;
+}
+
+
+/**
+ * Take a free connection and give it send and receive rings
+ * Caution: This function doesn't take the TCP semaphore.
+ * @return connection descriptor, SYSERR if the table is full or out of
+ *         memory
+ */
+int tcpAlloc(void)
+{
+    int sd;
+    struct tcb *t = NULL;
+
+    for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+    {
+        if (!(tcp.tcbs[sd].flags & TCP_CF_INUSE))
+            break;
+    }
+    if (sd == TCP_MAX_CONNS)
+        return SYSERR;
+
+    t = &tcp.tcbs[sd];
+    bzero((void *) t, sizeof(struct tcb));
+
+    t->sndBuf = (uchar *) slabAlloc(tcp.bufSlab);
+    t->rcvBuf = (uchar *) slabAlloc(tcp.bufSlab);
+    if (t->sndBuf == NULL || t->rcvBuf == NULL)
+    {
+        if (t->sndBuf != NULL)
+            slabFree(tcp.bufSlab, (void *) t->sndBuf);
+        if (t->rcvBuf != NULL)
+            slabFree(tcp.bufSlab, (void *) t->rcvBuf);
+        t->sndBuf = NULL;
+        t->rcvBuf = NULL;
+        return SYSERR;
+    }
+
+    t->state = TCP_CLOSED;
+    t->flags = TCP_CF_INUSE;
+    t->pid = TCP_NO_PID;
+    t->parent = TCP_NO_CONN;
+    t->mss = TCP_DEFAULT_MSS;
+    t->rto = TCP_RTO_INIT;
+    t->ssthresh = 65535;
+
+    return sd;
+}
+
+
+/**
+ * Give a connection back to the table, freeing its rings
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param sd connection descriptor
+ */
+void tcpFree(int sd)
+{
+    struct tcb *t = &tcp.tcbs[sd];
+
+    slabFree(tcp.bufSlab, (void *) t->sndBuf);
+    slabFree(tcp.bufSlab, (void *) t->rcvBuf);
+    t->sndBuf = NULL;
+    t->rcvBuf = NULL;
+    t->state = TCP_CLOSED;
+    t->flags = 0;
+    t->pid = TCP_NO_PID;
+}
+
+
+/**
+ * Release the TCP semaphore, then send the segments built while it was
+ * held. Sending can block in arpResolve, and nothing else may wait on
+ * the connection table meanwhile, netDaemon least of all.
+ * Caution: This function must be called with the TCP semaphore held.
+ */
+void tcpUnlock(void)
+{
+    struct tcpOutSeg segs[TCP_OUTQ];
+    int i, count;
+
+    count = tcp.outCount;
+    memcpy((void *) segs, (void *) tcp.outq, count * sizeof(struct tcpOutSeg));
+    tcp.outCount = 0;
+    signal(tcp.sema);
+
+    for (i = 0; i < count; i++)
+        ipSend(segs[i].frame, segs[i].id, segs[i].len, IPv4_PROTO_TCP,
+               IPv4_TTL, IPv4_TOS_ROUTINE, segs[i].dst);
+}
+
+
+/**
+ * Wake the process blocked on a connection, if there is one
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpWake(struct tcb *t)
+{
+    if (t->pid != TCP_NO_PID)
+    {
+        send(t->pid, (message) 1);
+        t->pid = TCP_NO_PID;
+    }
+}
+
+
+/**
+ * Move a connection to CLOSED, stopping its timers. A connection no
+ * process holds goes straight back to the table.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpSetClosed(struct tcb *t)
+{
+    t->state = TCP_CLOSED;
+    t->rtoTime = 0;
+    t->ackTime = 0;
+    t->waitTime = 0;
+    t->persistTime = 0;
+    tcpWake(t);
+
+    if (t->flags & TCP_CF_ORPHAN)
+        tcpFree(t - tcp.tcbs);
+}
+
+
+/**
+ * Turn a delay into a netTime deadline for the TCP timers
+ * @param ms milliseconds from now
+ * @return deadline, never 0 since 0 marks a timer as off
+ */
+ulong tcpDeadline(ulong ms)
+{
+    ulong t = netTime() + ms;
+
+    return (t == 0) ? 1 : t;
+}
+
+
+/**
+ * Pick an initial send sequence number. Like the RFC 793 clock it
+ * moves 250 per ms, so a new connection does not reuse the sequence
+ * space of an old one between the same ports.
+ * @return initial send sequence number
+ */
+ulong tcpIss(void)
+{
+    return netTime() * 250 + tcp.segsOut;
+}
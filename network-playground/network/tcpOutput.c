@@ -0,0 +1,401 @@
+/**
+ * @file tcpOutput.c
+ * @provides tcpOutput, tcpRetransmit, tcpSendSegment, tcpSendReset,
+ *           tcpStartTimers, tcpPersist, and tcpProbe
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/8/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <tcp.h>
+
+
+/**
+ * Send whatever the windows allow: queued data in segments of up to one
+ * MSS while the bytes in flight stay under the smaller of the peer's
+ * window and the congestion window, then our FIN once the user has
+ * closed and every byte is out. An ACK that is owed goes out on its own
+ * if no segment carried it. A zero window with data waiting arms the
+ * persist timer.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpOutput(struct tcb *t)
+{
+    ulong win, off, n;
+    uchar flags;
+
+    if (t->state == TCP_ESTABLISHED || t->state == TCP_CLOSE_WAIT ||
+        t->state == TCP_FIN_WAIT_1 || t->state == TCP_CLOSING ||
+        t->state == TCP_LAST_ACK)
+    {
+        win = (t->sndWnd < t->cwnd) ? t->sndWnd : t->cwnd;
+
+        // Bytes from sndUna already sent; the FIN goes last so this
+        // only counts data until it is out
+        off = t->sndNxt - t->sndUna;
+
+        while (!(t->flags & TCP_CF_FINSENT) && off < t->sndCount && off < win)
+        {
+            n = t->sndCount - off;
+            if (n > t->mss)
+                n = t->mss;
+            if (n > win - off)
+                n = win - off;
+
+            // Hold back a runt while earlier data is unacknowledged and
+            // more will fit once the window opens
+            if (n < t->mss && n < t->sndCount - off && off > 0)
+                break;
+
+            flags = TCP_FLAG_ACK;
+            if (off + n == t->sndCount)
+                flags |= TCP_FLAG_PSH;
+            tcpSendSegment(t, flags, t->sndNxt, n);
+            tcpStartTimers(t, t->sndNxt);
+
+            t->sndNxt += n;
+            off += n;
+        }
+
+        if ((t->flags & TCP_CF_USERCLOSED) && !(t->flags & TCP_CF_FINSENT) &&
+            off == t->sndCount)
+        {
+            tcpSendSegment(t, TCP_FLAG_FIN | TCP_FLAG_ACK, t->sndNxt, 0);
+            tcpStartTimers(t, t->sndNxt);
+            t->sndNxt++;
+            t->flags |= TCP_CF_FINSENT;
+
+            if (t->state == TCP_ESTABLISHED)
+                t->state = TCP_FIN_WAIT_1;
+            else if (t->state == TCP_CLOSE_WAIT)
+                t->state = TCP_LAST_ACK;
+        }
+    }
+
+    if (t->flags & TCP_CF_ACKNOW)
+        tcpSendSegment(t, TCP_FLAG_ACK, t->sndNxt, 0);
+
+    tcpPersist(t);
+}
+
+
+/**
+ * Handle a retransmission timeout: back off the RTO, fall back to slow
+ * start and send again from the oldest unacknowledged byte. A peer that
+ * stays silent for TCP_MAX_RETRIES timeouts aborts the connection.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpRetransmit(struct tcb *t)
+{
+    ulong inFlight;
+
+    t->rtoTime = 0;
+
+    // Probing a zero window is not a sign the peer is gone
+    if (t->sndWnd != 0 || t->state == TCP_SYN_SENT || t->state == TCP_SYN_RCVD)
+    {
+        if (++t->retries > TCP_MAX_RETRIES)
+        {
+            tcpSetClosed(t);
+            return;
+        }
+    }
+
+    tcp.retransmits++;
+
+    inFlight = t->sndNxt - t->sndUna;
+    t->ssthresh = (inFlight / 2 > 2 * t->mss) ? inFlight / 2 : 2 * t->mss;
+    t->cwnd = t->mss;
+    t->dupAcks = 0;
+
+    // Karn: back off, and take no RTT sample from a resent segment
+    t->rto = (t->rto * 2 < TCP_RTO_MAX) ? t->rto * 2 : TCP_RTO_MAX;
+    t->flags &= ~TCP_CF_RTTTIMING;
+
+    if (t->state == TCP_SYN_SENT)
+    {
+        tcpSendSegment(t, TCP_FLAG_SYN, t->iss, 0);
+        t->rtoTime = tcpDeadline(t->rto);
+        return;
+    }
+    if (t->state == TCP_SYN_RCVD)
+    {
+        tcpSendSegment(t, TCP_FLAG_SYN | TCP_FLAG_ACK, t->iss, 0);
+        t->rtoTime = tcpDeadline(t->rto);
+        return;
+    }
+
+    // Go back to the oldest unacknowledged byte, FIN included; ACKs
+    // for anything up to sndMax are still taken
+    t->sndNxt = t->sndUna;
+    t->flags &= ~TCP_CF_FINSENT;
+
+    if (t->sndWnd == 0 && t->sndCount > 0)
+    {
+        // Persist: push one byte past the closed window so the peer
+        // answers with its current window
+        tcpSendSegment(t, TCP_FLAG_ACK, t->sndNxt, 1);
+        t->sndNxt++;
+        t->rtoTime = tcpDeadline(t->rto);
+        return;
+    }
+
+    tcpOutput(t);
+}
+
+
+/**
+ * Build one segment and queue it for tcpUnlock to send. Data comes from
+ * the send ring, starting at the ring position of seq. A SYN carries
+ * our MSS option; any segment with an ACK advertises the free receive
+ * ring and clears a pending delayed ACK.
+ * Caution: This function must be called with the TCP semaphore held.
+ * @param t     connection
+ * @param flags TCP header flags
+ * @param seq   sequence number of the first byte
+ * @param len   bytes of data from the send ring, at most one MSS
+ * @return OK for success, SYSERR if out of frames or the queue is full
+ */
+syscall tcpSendSegment(struct tcb *t, uchar flags, ulong seq, ulong len)
+{
+    struct  ethPktBuffer *frame = NULL;
+    struct  tcpgram *seg = NULL;
+    struct  tcpOutSeg *out = NULL;
+    uchar   *data = NULL;
+    ushort  hdrLen, segLen;
+    ulong   pos, first, win, sum, part;
+
+    if (len > TCP_MSS)
+        return SYSERR;
+
+    // Build the segment in a driver frame, so the data is copied once,
+    // from the send ring to the wire
+    frame = netFrameGet();
+    if (frame == NULL)
+        return SYSERR;
+    seg = (struct tcpgram *) ipFramePayload(frame);
+
+    hdrLen = TCP_HDR_LEN;
+    if (flags & TCP_FLAG_SYN)
+    {
+        // MSS option: kind, length, then the MSS itself
+        seg->data[0] = TCP_OPT_MSS;
+        seg->data[1] = TCP_MSS_OPT_LEN;
+        seg->data[2] = (TCP_MSS >> 8) & 0xFF;
+        seg->data[3] = TCP_MSS & 0xFF;
+        hdrLen += TCP_MSS_OPT_LEN;
+    }
+    segLen = hdrLen + len;
+    sum = ipPseudoSum(net.ipAddr, t->remoteAddr, IPv4_PROTO_TCP, segLen);
+
+    // Copy and sum the data out of the send ring, in two pieces if it
+    // wraps. The frame is never read back.
+    if (len > 0)
+    {
+        data = (uchar *) seg + hdrLen;
+        pos = (t->sndHead + (seq - t->sndUna)) & (TCP_SNDBUF - 1);
+        first = TCP_SNDBUF - pos;
+        if (first > len)
+            first = len;
+        sum = csumPartialCopy((void *) data, (void *) (t->sndBuf + pos),
+                              first, sum);
+        if (first < len)
+        {
+            part = csumPartialCopy((void *) (data + first),
+                                   (void *) t->sndBuf, len - first, 0);
+
+            // After an odd first piece the second one is summed a byte
+            // out of step; swapping the bytes of its sum lines it up
+            if (first & 1)
+            {
+                part = (part & 0xFFFF) + (part >> 16);
+                part = (part & 0xFFFF) + (part >> 16);
+                part = ((part & 0xFF) << 8) | (part >> 8);
+            }
+            sum += part;
+            if (sum < part)
+                sum++;
+        }
+    }
+
+    win = TCP_RCVBUF - t->rcvCount;
+    if (win > 0xFFFF)
+        win = 0xFFFF;
+
+    /* Set up TCP header */
+    seg->srcPort = htons(t->localPort);
+    seg->dstPort = htons(t->remotePort);
+    seg->seq = htonl(seq);
+    seg->ack = (flags & TCP_FLAG_ACK) ? htonl(t->rcvNxt) : 0;
+    seg->offset = (hdrLen >> 2) << 4;
+    seg->flags = flags;
+    seg->window = htons(win);
+    seg->chksum = 0;
+    seg->urgent = 0;
+
+    seg->chksum = csumFold(csumPartial((void *) seg, hdrLen, sum));
+
+    // This segment carries every ACK we owe
+    if (flags & TCP_FLAG_ACK)
+    {
+        t->rcvAdv = t->rcvNxt + win;
+        t->ackTime = 0;
+        t->unacked = 0;
+        t->flags &= ~TCP_CF_ACKNOW;
+    }
+
+    if (flags & (TCP_FLAG_SYN | TCP_FLAG_FIN))
+        len++;
+    if (SEQ_GT(seq + len, t->sndMax))
+        t->sndMax = seq + len;
+    // Sent by tcpUnlock once the semaphore is released; a full queue
+    // loses the segment as the wire might, and the RTO sends it again
+    if (tcp.outCount >= TCP_OUTQ)
+    {
+        tcp.outDrops++;
+        netFrameFree(frame);
+        return SYSERR;
+    }
+    out = &tcp.outq[tcp.outCount++];
+    out->frame = frame;
+    out->len = segLen;
+    out->id = ipNextId();
+    out->dst = t->remoteAddr;
+    tcp.segsOut++;
+
+    return OK;
+}
+
+
+/**
+ * Answer a segment that belongs to no connection with a reset
+ * @param pkt     received IPv4 packet
+ * @param seg     its TCP segment
+ * @param dataLen bytes of data in the segment
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall tcpSendReset(struct ipgram *pkt, struct tcpgram *seg, ushort dataLen)
+{
+    struct tcpgram  *rst = NULL;
+    ulong           ack;
+    syscall         result;
+
+    // Never answer a reset with a reset
+    if (seg->flags & TCP_FLAG_RST)
+        return OK;
+
+    rst = (struct tcpgram *) netBufGet(NET_POOL_CTL);
+    if (rst == NULL)
+        return SYSERR;
+
+    /* Set up TCP header */
+    rst->srcPort = seg->dstPort;
+    rst->dstPort = seg->srcPort;
+    rst->offset = (TCP_HDR_LEN >> 2) << 4;
+    rst->window = 0;
+    rst->chksum = 0;
+    rst->urgent = 0;
+
+    if (seg->flags & TCP_FLAG_ACK)
+    {
+        // Take the sequence number the peer expects
+        rst->seq = seg->ack;
+        rst->ack = 0;
+        rst->flags = TCP_FLAG_RST;
+    }
+    else
+    {
+        // Acknowledge everything the segment carried
+        ack = tcpGetSeq(seg) + dataLen;
+        if (seg->flags & TCP_FLAG_SYN)
+            ack++;
+        if (seg->flags & TCP_FLAG_FIN)
+            ack++;
+        rst->seq = 0;
+        rst->ack = htonl(ack);
+        rst->flags = TCP_FLAG_RST | TCP_FLAG_ACK;
+    }
+
+    rst->chksum = csumFold(csumPartial((void *) rst, TCP_HDR_LEN,
+                                       ipPseudoSum(pkt->dst, pkt->src,
+                                                   IPv4_PROTO_TCP,
+                                                   TCP_HDR_LEN)));
+
+    wait(tcp.sema);
+    tcp.segsOut++;
+    signal(tcp.sema);
+
+    /* Send packet */
+    result = ipWrite((void *) rst, ipNextId(), TCP_HDR_LEN, IPv4_PROTO_TCP,
+                     IPv4_TTL, IPv4_TOS_ROUTINE, pkt->src);
+
+    netBufFree((void *) rst);
+    return result;
+}
+
+
+/**
+ * Arm the retransmit timer if it is off, and time this segment if no
+ * other segment is being timed
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t   connection
+ * @param seq sequence number of the segment just sent
+ */
+void tcpStartTimers(struct tcb *t, ulong seq)
+{
+    if (t->rtoTime == 0)
+        t->rtoTime = tcpDeadline(t->rto);
+
+    if (!(t->flags & TCP_CF_RTTTIMING))
+    {
+        t->rttSeq = seq;
+        t->rttStart = netTime();
+        t->flags |= TCP_CF_RTTTIMING;
+    }
+}
+
+
+/**
+ * Arm the persist timer while the peer's window is closed, data is
+ * waiting and nothing is in flight, so no retransmit timer would ever
+ * find out the window opened if the update were lost; stop it
+ * otherwise. The interval starts at the RTO.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpPersist(struct tcb *t)
+{
+    if (t->sndWnd == 0 && t->sndCount > 0 && t->sndNxt == t->sndUna &&
+        t->rtoTime == 0 && t->state != TCP_CLOSED)
+    {
+        if (t->persistTime == 0)
+        {
+            t->persistLen = t->rto;
+            t->persistTime = tcpDeadline(t->persistLen);
+        }
+    }
+    else
+        t->persistTime = 0;
+}
+
+
+/**
+ * Probe a closed window: send the next byte past it, which the peer
+ * answers with its current window, then back off. The byte does not
+ * count as sent, so the timer stays armed until the window opens.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection
+ */
+void tcpProbe(struct tcb *t)
+{
+    tcpSendSegment(t, TCP_FLAG_ACK, t->sndNxt, 1);
+
+    t->persistLen = (t->persistLen * 2 < TCP_RTO_MAX) ?
+                    t->persistLen * 2 : TCP_RTO_MAX;
+    t->persistTime = tcpDeadline(t->persistLen);
+}
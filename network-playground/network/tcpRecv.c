@@ -0,0 +1,622 @@
+/**
+ * @file tcpRecv.c
+ * @provides tcpRecv
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/8/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <tcp.h>
+
+/* Private/helper functions */
+int tcpLookupListener(ushort localPort);
+void tcpSpawn(int lsd, struct ipgram *pkt, struct tcpgram *seg);
+syscall tcpEstablishChild(struct tcb *t);
+void tcpParseMss(struct tcb *t, struct tcpgram *seg);
+void tcpRttSample(struct tcb *t, long rtt);
+void tcpAckIn(struct tcb *t, ulong ack, ushort window, ushort dataLen);
+void tcpDataIn(struct tcb *t, ulong seq, uchar *data, ushort dataLen,
+               uchar fin);
+
+
+/**
+ * Receive a TCP segment and run it through its connection. A SYN to a
+ * listening port spawns a new connection; anything else that belongs
+ * to no connection is answered with a reset.
+ * @param pkt received IPv4 packet
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall tcpRecv(struct ipgram *pkt)
+{
+    int sd;
+    ushort ipLen, ipHdrLen, segLen, hdrLen, dataLen, window, skip;
+    ulong seq, ack;
+    uchar flags;
+    uchar *data = NULL;
+    struct tcpgram *seg = NULL;
+    struct tcb *t = NULL;
+
+    if (pkt == NULL)
+        return SYSERR;
+
+    ipLen = ipGetLen(pkt);
+    ipHdrLen = ipGetHdrLen(pkt);
+    seg = (struct tcpgram *) ((uchar *) pkt + ipHdrLen);
+
+    // Screen out packets with bad TCP headers
+    if (ipLen < ipHdrLen + TCP_HDR_LEN)
+        return SYSERR;
+
+    segLen = ipLen - ipHdrLen;
+    hdrLen = tcpGetHdrLen(seg);
+    if (hdrLen < TCP_HDR_LEN || hdrLen > segLen)
+        return SYSERR;
+
+    // Screen out packets with a bad checksum
+    if (csumFold(csumPartial((void *) seg, segLen,
+                             ipPseudoSum(pkt->src, pkt->dst,
+                                         IPv4_PROTO_TCP, segLen))) != 0)
+    {
+        tcp.badSum++;
+        return SYSERR;
+    }
+
+    // Decode each header field once
+    dataLen = segLen - hdrLen;
+    data = (uchar *) seg + hdrLen;
+    seq = tcpGetSeq(seg);
+    ack = tcpGetAck(seg);
+    window = ntohs(seg->window);
+    flags = seg->flags;
+
+    wait(tcp.sema);
+    tcp.segsIn++;
+
+    sd = tcpLookup(pkt->src, ntohs(seg->srcPort), ntohs(seg->dstPort));
+    if (sd == TCP_NO_CONN)
+    {
+        sd = tcpLookupListener(ntohs(seg->dstPort));
+        if (sd != TCP_NO_CONN &&
+            (flags & (TCP_FLAG_SYN | TCP_FLAG_ACK | TCP_FLAG_RST)) == TCP_FLAG_SYN)
+        {
+            tcpSpawn(sd, pkt, seg);
+            tcpUnlock();
+            return OK;
+        }
+        tcpUnlock();
+
+        // Nobody is listening, let the sender fail fast
+        tcpSendReset(pkt, seg, dataLen);
+        return OK;
+    }
+
+    t = &tcp.tcbs[sd];
+
+    if (t->state == TCP_SYN_SENT)
+    {
+        if ((flags & TCP_FLAG_ACK) && ack != t->sndNxt)
+        {
+            tcpUnlock();
+            tcpSendReset(pkt, seg, dataLen);
+            return OK;
+        }
+        if (flags & TCP_FLAG_RST)
+        {
+            // Connection refused
+            if (flags & TCP_FLAG_ACK)
+                tcpSetClosed(t);
+            tcpUnlock();
+            return OK;
+        }
+
+        // Only a SYN|ACK opens the connection; a simultaneous open
+        // is not supported and the bare SYN is dropped
+        if ((flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) ==
+            (TCP_FLAG_SYN | TCP_FLAG_ACK))
+        {
+            t->irs = seq;
+            t->rcvNxt = seq + 1;
+            tcpParseMss(t, seg);
+            if ((t->flags & TCP_CF_RTTTIMING) && SEQ_GT(ack, t->rttSeq))
+                tcpRttSample(t, netTime() - t->rttStart);
+            t->flags &= ~TCP_CF_RTTTIMING;
+            t->sndUna = ack;
+            t->sndWnd = window;
+            t->rtoTime = 0;
+            t->retries = 0;
+            t->state = TCP_ESTABLISHED;
+            t->flags |= TCP_CF_ACKNOW;
+            tcpWake(t);
+            tcpOutput(t);
+        }
+        tcpUnlock();
+        return OK;
+    }
+
+    // Trim bytes already received off the front of the segment
+    if (dataLen > 0 && SEQ_LT(seq, t->rcvNxt) &&
+        SEQ_GT(seq + dataLen, t->rcvNxt))
+    {
+        skip = t->rcvNxt - seq;
+        data += skip;
+        dataLen -= skip;
+        seq = t->rcvNxt;
+    }
+
+    if (flags & TCP_FLAG_RST)
+    {
+        // Only a reset inside the receive window is believed
+        if (SEQ_GEQ(seq, t->rcvNxt) && SEQ_LT(seq, t->rcvNxt + TCP_RCVBUF))
+            tcpSetClosed(t);
+        tcpUnlock();
+        return OK;
+    }
+
+    if (flags & TCP_FLAG_SYN)
+    {
+        // The peer missed our SYN|ACK or our ACK of its SYN
+        if (t->state == TCP_SYN_RCVD && seq == t->irs)
+            tcpSendSegment(t, TCP_FLAG_SYN | TCP_FLAG_ACK, t->iss, 0);
+        else
+            t->flags |= TCP_CF_ACKNOW;
+        tcpOutput(t);
+        tcpUnlock();
+        return OK;
+    }
+
+    if (!(flags & TCP_FLAG_ACK))
+    {
+        tcpUnlock();
+        return OK;
+    }
+
+    if (t->state == TCP_SYN_RCVD)
+    {
+        if (ack != t->sndNxt)
+        {
+            tcpUnlock();
+            tcpSendReset(pkt, seg, dataLen);
+            return OK;
+        }
+        if ((t->flags & TCP_CF_RTTTIMING) && SEQ_GT(ack, t->rttSeq))
+            tcpRttSample(t, netTime() - t->rttStart);
+        t->flags &= ~TCP_CF_RTTTIMING;
+        t->sndUna = ack;
+        t->sndWnd = window;
+        t->rtoTime = 0;
+        t->retries = 0;
+        t->state = TCP_ESTABLISHED;
+
+        if (tcpEstablishChild(t) != OK)
+        {
+            // No room to accept it, give up on the connection
+            tcpSendSegment(t, TCP_FLAG_RST | TCP_FLAG_ACK, t->sndNxt, 0);
+            tcpSetClosed(t);
+            tcpUnlock();
+            return OK;
+        }
+    }
+    else
+    {
+        tcpAckIn(t, ack, window, dataLen);
+
+        // The ACK of our FIN in LAST_ACK ends the connection
+        if (t->state == TCP_CLOSED)
+        {
+            tcpUnlock();
+            return OK;
+        }
+    }
+
+    tcpDataIn(t, seq, data, dataLen, flags & TCP_FLAG_FIN);
+    tcpOutput(t);
+
+    tcpUnlock();
+    return OK;
+}
+
+
+/**
+ * Find the connection a segment belongs to
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param remoteAddr sender's IPv4 address
+ * @param remotePort sender's port
+ * @param localPort  our port
+ * @return connection descriptor, TCP_NO_CONN if there is none
+ */
+int tcpLookup(ipaddr remoteAddr, ushort remotePort, ushort localPort)
+{
+    int sd;
+    struct tcb *t = NULL;
+
+    for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+    {
+        t = &tcp.tcbs[sd];
+        if ((t->flags & TCP_CF_INUSE) && t->state != TCP_CLOSED &&
+            t->state != TCP_LISTEN && t->localPort == localPort &&
+            t->remotePort == remotePort && t->remoteAddr == remoteAddr)
+            return sd;
+    }
+    return TCP_NO_CONN;
+}
+
+
+/**
+ * Find the connection listening on a local port
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param localPort our port
+ * @return connection descriptor, TCP_NO_CONN if nobody is listening
+ */
+int tcpLookupListener(ushort localPort)
+{
+    int sd;
+
+    for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+    {
+        if ((tcp.tcbs[sd].flags & TCP_CF_INUSE) &&
+            tcp.tcbs[sd].state == TCP_LISTEN &&
+            tcp.tcbs[sd].localPort == localPort)
+            return sd;
+    }
+    return TCP_NO_CONN;
+}
+
+
+/**
+ * Answer a SYN to a listening port with a SYN|ACK from a new connection.
+ * The connection belongs to the listener until tcpAccept takes it, and
+ * the listener holds no more than TCP_BACKLOG of them.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param lsd listening connection descriptor
+ * @param pkt received IPv4 packet
+ * @param seg its TCP segment
+ */
+void tcpSpawn(int lsd, struct ipgram *pkt, struct tcpgram *seg)
+{
+    int sd, pending;
+    struct tcb *t = NULL;
+
+    // Count half-open and unaccepted connections of this listener
+    pending = tcp.tcbs[lsd].backlogCount;
+    for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+    {
+        if ((tcp.tcbs[sd].flags & TCP_CF_INUSE) &&
+            tcp.tcbs[sd].state == TCP_SYN_RCVD && tcp.tcbs[sd].parent == lsd)
+            pending++;
+    }
+    if (pending >= TCP_BACKLOG)
+        return;
+
+    sd = tcpAlloc();
+    if (sd == SYSERR)
+        return;
+
+    t = &tcp.tcbs[sd];
+    t->flags |= TCP_CF_ORPHAN;
+    t->parent = lsd;
+    t->localPort = tcp.tcbs[lsd].localPort;
+    t->remoteAddr = pkt->src;
+    t->remotePort = ntohs(seg->srcPort);
+
+    t->irs = tcpGetSeq(seg);
+    t->rcvNxt = t->irs + 1;
+    tcpParseMss(t, seg);
+    t->sndWnd = ntohs(seg->window);
+
+    t->iss = tcpIss();
+    t->sndUna = t->iss;
+    t->sndMax = t->iss;
+    t->state = TCP_SYN_RCVD;
+
+    tcpSendSegment(t, TCP_FLAG_SYN | TCP_FLAG_ACK, t->iss, 0);
+    tcpStartTimers(t, t->iss);
+    t->sndNxt = t->iss + 1;
+}
+
+
+/**
+ * Hand a newly established connection to its listener's backlog and
+ * wake the process in tcpAccept
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t connection spawned by tcpSpawn
+ * @return OK for success, SYSERR if the listener is gone or full
+ */
+syscall tcpEstablishChild(struct tcb *t)
+{
+    struct tcb *l = NULL;
+
+    if (t->parent == TCP_NO_CONN)
+        return SYSERR;
+
+    l = &tcp.tcbs[t->parent];
+    if (!(l->flags & TCP_CF_INUSE) || l->state != TCP_LISTEN ||
+        l->localPort != t->localPort || l->backlogCount >= TCP_BACKLOG)
+        return SYSERR;
+
+    // The listener holds the descriptor from here on
+    l->backlog[l->backlogCount++] = t - tcp.tcbs;
+    t->flags &= ~TCP_CF_ORPHAN;
+    tcpWake(l);
+
+    return OK;
+}
+
+
+/**
+ * Take the peer's MSS from the options of its SYN, and size the
+ * initial congestion window from it
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t   connection
+ * @param seg received SYN
+ */
+void tcpParseMss(struct tcb *t, struct tcpgram *seg)
+{
+    int i, optLen;
+    ushort mss;
+
+    optLen = tcpGetHdrLen(seg) - TCP_HDR_LEN;
+    i = 0;
+    while (i < optLen && seg->data[i] != TCP_OPT_END)
+    {
+        if (seg->data[i] == TCP_OPT_NOP)
+        {
+            i++;
+            continue;
+        }
+        if (i + 1 >= optLen || seg->data[i + 1] < 2)
+            break;
+
+        if (seg->data[i] == TCP_OPT_MSS && seg->data[i + 1] == TCP_MSS_OPT_LEN &&
+            i + TCP_MSS_OPT_LEN <= optLen)
+        {
+            mss = (seg->data[i + 2] << 8) | seg->data[i + 3];
+            if (mss > TCP_MSS)
+                mss = TCP_MSS;
+            if (mss > 0)
+                t->mss = mss;
+        }
+        i += seg->data[i + 1];
+    }
+
+    t->cwnd = 2 * t->mss;
+}
+
+
+/**
+ * Fold an RTT measurement into the smoothed RTT and its variation, and
+ * work out a new RTO from them (RFC 6298)
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t   connection
+ * @param rtt measured round trip, in ms
+ */
+void tcpRttSample(struct tcb *t, long rtt)
+{
+    long delta;
+    ulong rto;
+
+    if (t->srtt == 0)
+    {
+        // First sample: SRTT = R, RTTVAR = R/2
+        t->srtt = rtt << 3;
+        t->rttvar = rtt << 1;
+    }
+    else
+    {
+        // SRTT += (R - SRTT)/8, RTTVAR += (|R - SRTT| - RTTVAR)/4
+        delta = rtt - (t->srtt >> 3);
+        t->srtt += delta;
+        if (delta < 0)
+            delta = -delta;
+        t->rttvar += delta - (t->rttvar >> 2);
+    }
+
+    // RTO = SRTT + 4 * RTTVAR, and rttvar already holds 4 * RTTVAR
+    rto = (t->srtt >> 3) + t->rttvar;
+    if (rto < TCP_RTO_MIN)
+        rto = TCP_RTO_MIN;
+    if (rto > TCP_RTO_MAX)
+        rto = TCP_RTO_MAX;
+    t->rto = rto;
+}
+
+
+/**
+ * Process the acknowledgment field of a segment: free acknowledged
+ * bytes from the send ring, open the congestion window, and retransmit
+ * early after TCP_DUPACK_THRESH duplicate ACKs
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t       connection
+ * @param ack     acknowledgment number
+ * @param window  peer's advertised window
+ * @param dataLen bytes of data in the segment
+ */
+void tcpAckIn(struct tcb *t, ulong ack, ushort window, ushort dataLen)
+{
+    ulong acked, inFlight, n;
+    uchar finAcked = FALSE;
+
+    if (SEQ_GT(ack, t->sndMax))
+    {
+        // Acknowledges something never sent
+        t->flags |= TCP_CF_ACKNOW;
+        return;
+    }
+
+    if (SEQ_GT(ack, t->sndUna))
+    {
+        // One past the data is our FIN
+        acked = ack - t->sndUna;
+        if (acked > t->sndCount)
+        {
+            finAcked = TRUE;
+            acked = t->sndCount;
+        }
+
+        t->sndHead = (t->sndHead + acked) & (TCP_SNDBUF - 1);
+        t->sndCount -= acked;
+        t->sndUna = ack;
+        if (SEQ_GT(ack, t->sndNxt))
+            t->sndNxt = ack;
+        if (finAcked)
+            t->flags |= TCP_CF_FINSENT;
+
+        if ((t->flags & TCP_CF_RTTTIMING) && SEQ_GT(ack, t->rttSeq))
+        {
+            tcpRttSample(t, netTime() - t->rttStart);
+            t->flags &= ~TCP_CF_RTTTIMING;
+        }
+        t->retries = 0;
+        t->dupAcks = 0;
+
+        // Slow start below ssthresh, then about one MSS per RTT
+        if (t->cwnd < t->ssthresh)
+            t->cwnd += t->mss;
+        else
+            t->cwnd += (t->mss * t->mss) / t->cwnd + 1;
+        if (t->cwnd > 65535)
+            t->cwnd = 65535;
+
+        t->rtoTime = (t->sndNxt != t->sndUna) ? tcpDeadline(t->rto) : 0;
+        t->sndWnd = window;
+
+        // Room in the send ring for a blocked writer
+        tcpWake(t);
+
+        if (finAcked)
+        {
+            if (t->state == TCP_FIN_WAIT_1)
+            {
+                t->state = TCP_FIN_WAIT_2;
+
+                // No process will ever close an orphan, so a peer that
+                // never sends its FIN must not hold it forever
+                if (t->flags & TCP_CF_ORPHAN)
+                    t->waitTime = tcpDeadline(TCP_FIN_WAIT_2_LEN);
+            }
+            else if (t->state == TCP_CLOSING)
+            {
+                t->state = TCP_TIME_WAIT;
+                t->waitTime = tcpDeadline(TCP_TIME_WAIT_LEN);
+            }
+            else if (t->state == TCP_LAST_ACK)
+                tcpSetClosed(t);
+        }
+        return;
+    }
+
+    if (ack == t->sndUna)
+    {
+        if (dataLen == 0 && window == t->sndWnd && t->sndNxt != t->sndUna &&
+            ++t->dupAcks == TCP_DUPACK_THRESH)
+        {
+            // Fast retransmit: the peer is missing the oldest segment
+            inFlight = t->sndNxt - t->sndUna;
+            t->ssthresh = (inFlight / 2 > 2 * t->mss) ? inFlight / 2 : 2 * t->mss;
+            t->cwnd = t->ssthresh;
+            t->flags &= ~TCP_CF_RTTTIMING;
+
+            n = (t->sndCount < t->mss) ? t->sndCount : t->mss;
+            if (n > 0)
+            {
+                tcpSendSegment(t, TCP_FLAG_ACK, t->sndUna, n);
+                tcp.retransmits++;
+                t->rtoTime = tcpDeadline(t->rto);
+            }
+        }
+        t->sndWnd = window;
+    }
+}
+
+
+/**
+ * Process the data and FIN of a segment. Only in-order data is taken;
+ * anything else is dropped and answered at once with a duplicate ACK.
+ * An ACK for in-order data waits until a second segment arrives or
+ * TCP_DELACK runs out.
+ * Caution: This function doesn't take the TCP semaphore.
+ * @param t       connection
+ * @param seq     sequence number of the first byte
+ * @param data    segment data
+ * @param dataLen bytes of data in the segment
+ * @param fin     nonzero if the segment carries a FIN
+ */
+void tcpDataIn(struct tcb *t, ulong seq, uchar *data, ushort dataLen,
+               uchar fin)
+{
+    ulong pos, first, n;
+
+    if (t->state != TCP_ESTABLISHED && t->state != TCP_FIN_WAIT_1 &&
+        t->state != TCP_FIN_WAIT_2)
+    {
+        // The peer has sent its FIN, so this can only be a repeat
+        if (dataLen > 0 || fin)
+        {
+            t->flags |= TCP_CF_ACKNOW;
+            if (t->state == TCP_TIME_WAIT)
+                t->waitTime = tcpDeadline(TCP_TIME_WAIT_LEN);
+        }
+        return;
+    }
+
+    n = 0;
+    if (dataLen > 0)
+    {
+        if (seq != t->rcvNxt)
+        {
+            t->flags |= TCP_CF_ACKNOW;
+            return;
+        }
+
+        n = TCP_RCVBUF - t->rcvCount;
+        if (n > dataLen)
+            n = dataLen;
+
+        if (t->flags & TCP_CF_USERCLOSED)
+        {
+            // Nobody will read it; take it and throw it away
+            n = dataLen;
+        }
+        else
+        {
+            // Copy into the receive ring, in two pieces if it wraps
+            pos = (t->rcvHead + t->rcvCount) & (TCP_RCVBUF - 1);
+            first = TCP_RCVBUF - pos;
+            if (first > n)
+                first = n;
+            memcpy((void *) (t->rcvBuf + pos), (void *) data, first);
+            memcpy((void *) t->rcvBuf, (void *) (data + first), n - first);
+            t->rcvCount += n;
+        }
+        t->rcvNxt += n;
+
+        // Delay the ACK unless the ring is full or one is already owed
+        if (n < dataLen || ++t->unacked >= 2)
+            t->flags |= TCP_CF_ACKNOW;
+        else if (t->ackTime == 0)
+            t->ackTime = tcpDeadline(TCP_DELACK);
+
+        tcpWake(t);
+    }
+
+    // A FIN counts only once every byte before it is in
+    if (fin && n == dataLen && seq + n == t->rcvNxt)
+    {
+        t->rcvNxt++;
+        t->flags |= TCP_CF_FINRCVD | TCP_CF_ACKNOW;
+        tcpWake(t);
+
+        if (t->state == TCP_ESTABLISHED)
+            t->state = TCP_CLOSE_WAIT;
+        else if (t->state == TCP_FIN_WAIT_1)
+            t->state = TCP_CLOSING;
+        else
+        {
+            t->state = TCP_TIME_WAIT;
+            t->rtoTime = 0;
+            t->waitTime = tcpDeadline(TCP_TIME_WAIT_LEN);
+        }
+    }
+}
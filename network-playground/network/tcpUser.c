@@ -0,0 +1,463 @@
+/**
+ * @file tcpUser.c
+ * @provides tcpListen, tcpAccept, tcpConnect, tcpWrite, tcpRead, and
+ *           tcpClose
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/8/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <tcp.h>
+
+/* Private/helper functions */
+int tcpEphemeral(void);
+int tcpWaitWake(struct tcb *t, ulong start, int timeout);
+
+
+/**
+ * Listen for connections on a local port
+ * @param localPort port to accept connections on
+ * @return connection descriptor for tcpAccept, SYSERR if the port is
+ *         taken or the connection table is full
+ */
+int tcpListen(ushort localPort)
+{
+    int sd;
+    struct tcb *t = NULL;
+
+    if (localPort == 0)
+        return SYSERR;
+
+    wait(tcp.sema);
+
+    for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+    {
+        t = &tcp.tcbs[sd];
+        if ((t->flags & TCP_CF_INUSE) && t->state == TCP_LISTEN &&
+            t->localPort == localPort)
+        {
+            tcpUnlock();
+            return SYSERR;
+        }
+    }
+
+    sd = tcpAlloc();
+    if (sd == SYSERR)
+    {
+        tcpUnlock();
+        return SYSERR;
+    }
+
+    t = &tcp.tcbs[sd];
+    t->state = TCP_LISTEN;
+    t->localPort = localPort;
+    t->backlogCount = 0;
+
+    tcpUnlock();
+    return sd;
+}
+
+
+/**
+ * Take the oldest established connection from a listener, waiting for
+ * one if there is none
+ * @param sd      listening connection descriptor from tcpListen
+ * @param timeout milliseconds to wait, 0 to poll
+ * @return connection descriptor, TIMEOUT if nobody connected in time,
+ *         SYSERR for syntax error or a closed listener
+ */
+int tcpAccept(int sd, int timeout)
+{
+    struct tcb  *t = NULL;
+    ulong       start;
+    int         csd, i;
+
+    if (sd < 0 || sd >= TCP_MAX_CONNS)
+        return SYSERR;
+
+    t = &tcp.tcbs[sd];
+    start = netTime();
+
+    while (1)
+    {
+        wait(tcp.sema);
+
+        if (!(t->flags & TCP_CF_INUSE) || t->state != TCP_LISTEN)
+        {
+            tcpUnlock();
+            return SYSERR;
+        }
+
+        while (t->backlogCount > 0)
+        {
+            csd = t->backlog[0];
+            t->backlogCount--;
+            for (i = 0; i < t->backlogCount; i++)
+                t->backlog[i] = t->backlog[i + 1];
+
+            // Drop connections the peer reset before we got to them
+            if (tcp.tcbs[csd].state == TCP_CLOSED)
+            {
+                tcpFree(csd);
+                continue;
+            }
+
+            tcp.tcbs[csd].parent = TCP_NO_CONN;
+            tcpUnlock();
+            return csd;
+        }
+
+        if (tcpWaitWake(t, start, timeout) == TIMEOUT)
+            return TIMEOUT;
+    }
+}
+
+
+/**
+ * Open a connection to a remote port, waiting for the handshake
+ * @param remoteAddr peer's IPv4 address
+ * @param remotePort peer's port
+ * @param timeout    milliseconds to wait for the peer to answer
+ * @return connection descriptor, TIMEOUT if the peer did not answer in
+ *         time, SYSERR for syntax error, a refused connection or a full
+ *         connection table
+ */
+int tcpConnect(ipaddr remoteAddr, ushort remotePort, int timeout)
+{
+    struct tcb  *t = NULL;
+    ulong       start;
+    int         sd, port;
+
+    if (remotePort == 0 || remoteAddr == IPv4_ADDR_ANY ||
+        remoteAddr == IPv4_ADDR_BCAST)
+        return SYSERR;
+
+    wait(tcp.sema);
+
+    port = tcpEphemeral();
+    sd = (port == SYSERR) ? SYSERR : tcpAlloc();
+    if (sd == SYSERR)
+    {
+        tcpUnlock();
+        return SYSERR;
+    }
+
+    t = &tcp.tcbs[sd];
+    t->localPort = port;
+    t->remoteAddr = remoteAddr;
+    t->remotePort = remotePort;
+    t->cwnd = 2 * t->mss;
+
+    t->iss = tcpIss();
+    t->sndUna = t->iss;
+    t->sndMax = t->iss;
+    t->state = TCP_SYN_SENT;
+
+    tcpSendSegment(t, TCP_FLAG_SYN, t->iss, 0);
+    tcpStartTimers(t, t->iss);
+    t->sndNxt = t->iss + 1;
+
+    start = netTime();
+    while (1)
+    {
+        if (t->state == TCP_ESTABLISHED)
+        {
+            tcpUnlock();
+            return sd;
+        }
+
+        // Refused, or the SYN ran out of retries
+        if (t->state != TCP_SYN_SENT)
+        {
+            tcpFree(sd);
+            tcpUnlock();
+            return SYSERR;
+        }
+
+        if (tcpWaitWake(t, start, timeout) == TIMEOUT)
+        {
+            wait(tcp.sema);
+            if (t->state == TCP_ESTABLISHED)
+                continue;
+            tcpFree(sd);
+            tcpUnlock();
+            return TIMEOUT;
+        }
+        wait(tcp.sema);
+    }
+}
+
+
+/**
+ * Queue data on a connection and send what the windows allow. Blocks
+ * while the send ring is full.
+ * @param sd  connection descriptor
+ * @param buf data to send
+ * @param len length of the data in bytes
+ * @return number of bytes queued, SYSERR for syntax error or a
+ *         connection that can no longer send
+ */
+int tcpWrite(int sd, void *buf, int len)
+{
+    struct tcb  *t = NULL;
+    uchar       *src = (uchar *) buf;
+    ulong       pos, first, n;
+    int         done = 0;
+
+    if (sd < 0 || sd >= TCP_MAX_CONNS || (buf == NULL && len > 0) || len < 0)
+        return SYSERR;
+
+    t = &tcp.tcbs[sd];
+
+    while (1)
+    {
+        wait(tcp.sema);
+
+        if (!(t->flags & TCP_CF_INUSE) || (t->flags & TCP_CF_USERCLOSED) ||
+            (t->state != TCP_ESTABLISHED && t->state != TCP_CLOSE_WAIT))
+        {
+            tcpUnlock();
+            return (done > 0) ? done : SYSERR;
+        }
+
+        // Copy into the send ring, in two pieces if it wraps
+        n = TCP_SNDBUF - t->sndCount;
+        if (n > len - done)
+            n = len - done;
+        if (n > 0)
+        {
+            pos = (t->sndHead + t->sndCount) & (TCP_SNDBUF - 1);
+            first = TCP_SNDBUF - pos;
+            if (first > n)
+                first = n;
+            memcpy((void *) (t->sndBuf + pos), (void *) (src + done), first);
+            memcpy((void *) t->sndBuf, (void *) (src + done + first), n - first);
+            t->sndCount += n;
+            done += n;
+
+            tcpOutput(t);
+        }
+
+        if (done == len)
+        {
+            tcpUnlock();
+            return done;
+        }
+
+        // Wait for ACKs to make room
+        tcpWaitWake(t, netTime(), TCP_RTO_MAX);
+    }
+}
+
+
+/**
+ * Read data that has arrived on a connection, waiting for some if the
+ * receive ring is empty
+ * @param sd      connection descriptor
+ * @param buf     buffer for the data
+ * @param len     size of the buffer in bytes
+ * @param timeout milliseconds to wait, 0 to poll
+ * @return number of bytes read, 0 once the peer has closed, TIMEOUT if
+ *         nothing arrived in time, SYSERR for syntax error or a reset
+ *         connection
+ */
+int tcpRead(int sd, void *buf, int len, int timeout)
+{
+    struct tcb  *t = NULL;
+    uchar       *dst = (uchar *) buf;
+    ulong       start, first, n, avail, adv;
+
+    if (sd < 0 || sd >= TCP_MAX_CONNS || buf == NULL || len <= 0)
+        return SYSERR;
+
+    t = &tcp.tcbs[sd];
+    start = netTime();
+
+    while (1)
+    {
+        wait(tcp.sema);
+
+        if (!(t->flags & TCP_CF_INUSE) || t->state == TCP_LISTEN)
+        {
+            tcpUnlock();
+            return SYSERR;
+        }
+
+        if (t->rcvCount > 0)
+        {
+            // Copy out of the receive ring, in two pieces if it wraps
+            n = (t->rcvCount < len) ? t->rcvCount : len;
+            first = TCP_RCVBUF - t->rcvHead;
+            if (first > n)
+                first = n;
+            memcpy((void *) dst, (void *) (t->rcvBuf + t->rcvHead), first);
+            memcpy((void *) (dst + first), (void *) t->rcvBuf, n - first);
+            t->rcvHead = (t->rcvHead + n) & (TCP_RCVBUF - 1);
+            t->rcvCount -= n;
+
+            // Tell the peer once the window has opened by two segments,
+            // or past one segment from under it
+            avail = TCP_RCVBUF - t->rcvCount;
+            adv = t->rcvAdv - t->rcvNxt;
+            if (t->state != TCP_CLOSED &&
+                (avail >= adv + 2 * TCP_MSS || (adv < TCP_MSS && avail >= TCP_MSS)))
+            {
+                t->flags |= TCP_CF_ACKNOW;
+                tcpOutput(t);
+            }
+
+            tcpUnlock();
+            return n;
+        }
+
+        // End of stream
+        if (t->flags & TCP_CF_FINRCVD)
+        {
+            tcpUnlock();
+            return 0;
+        }
+        if (t->state == TCP_CLOSED)
+        {
+            tcpUnlock();
+            return SYSERR;
+        }
+
+        if (tcpWaitWake(t, start, timeout) == TIMEOUT)
+            return TIMEOUT;
+    }
+}
+
+
+/**
+ * Close a connection. Queued data still goes out, followed by a FIN;
+ * the connection returns to the table once the peer has closed too.
+ * Closing a listener resets the connections nobody accepted.
+ * @param sd connection descriptor
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall tcpClose(int sd)
+{
+    struct tcb  *t = NULL;
+    struct tcb  *c = NULL;
+    int         i;
+
+    if (sd < 0 || sd >= TCP_MAX_CONNS)
+        return SYSERR;
+
+    t = &tcp.tcbs[sd];
+
+    wait(tcp.sema);
+
+    if (!(t->flags & TCP_CF_INUSE) || (t->flags & TCP_CF_ORPHAN))
+    {
+        tcpUnlock();
+        return SYSERR;
+    }
+
+    if (t->state == TCP_LISTEN)
+    {
+        for (i = 0; i < TCP_MAX_CONNS; i++)
+        {
+            c = &tcp.tcbs[i];
+            if (!(c->flags & TCP_CF_INUSE) || c->parent != sd ||
+                c->state == TCP_LISTEN)
+                continue;
+
+            c->parent = TCP_NO_CONN;
+            c->flags |= TCP_CF_ORPHAN;
+            if (c->state != TCP_CLOSED)
+                tcpSendSegment(c, TCP_FLAG_RST | TCP_FLAG_ACK, c->sndNxt, 0);
+            tcpSetClosed(c);
+        }
+        tcpWake(t);
+        tcpFree(sd);
+        tcpUnlock();
+        return OK;
+    }
+
+    // Whatever arrives from here on is thrown away
+    t->flags |= TCP_CF_USERCLOSED | TCP_CF_ORPHAN;
+    t->rcvCount = 0;
+    tcpWake(t);
+
+    if (t->state == TCP_CLOSED || t->state == TCP_SYN_SENT ||
+        t->state == TCP_SYN_RCVD)
+        tcpSetClosed(t);
+    else
+        tcpOutput(t);
+
+    tcpUnlock();
+    return OK;
+}
+
+
+/**
+ * Pick an ephemeral port no connection uses
+ * Caution: This function doesn't take the TCP semaphore.
+ * @return port number, SYSERR if every ephemeral port is taken
+ */
+int tcpEphemeral(void)
+{
+    int i, sd;
+    ushort port;
+
+    for (i = 0; i <= TCP_EPHEM_LAST - TCP_EPHEM_FIRST; i++)
+    {
+        port = tcp.nextEphem;
+
+        if (tcp.nextEphem == TCP_EPHEM_LAST)
+            tcp.nextEphem = TCP_EPHEM_FIRST;
+        else
+            tcp.nextEphem++;
+
+        for (sd = 0; sd < TCP_MAX_CONNS; sd++)
+        {
+            if ((tcp.tcbs[sd].flags & TCP_CF_INUSE) &&
+                tcp.tcbs[sd].localPort == port)
+                break;
+        }
+        if (sd == TCP_MAX_CONNS)
+            return port;
+    }
+    return SYSERR;
+}
+
+
+/**
+ * Give up the TCP semaphore and sleep until the connection is woken or
+ * the time runs out. Called with the TCP semaphore held; returns
+ * without it.
+ * @param t       connection
+ * @param start   netTime when the caller began waiting
+ * @param timeout milliseconds the caller waits in all
+ * @return OK if woken or there is time left, TIMEOUT if not
+ */
+int tcpWaitWake(struct tcb *t, ulong start, int timeout)
+{
+    ulong elapsed;
+
+    elapsed = netTime() - start;
+    if (elapsed >= timeout)
+    {
+        tcpUnlock();
+        return TIMEOUT;
+    }
+
+    // Ask for a wake up, then sleep until one arrives
+    recvclr();
+    t->pid = getpid();
+    tcpUnlock();
+
+    recvtime(timeout - elapsed);
+
+    // Withdraw the wake up request if it was not used
+    wait(tcp.sema);
+    if (t->pid == getpid())
+        t->pid = TCP_NO_PID;
+    tcpUnlock();
+
+    return OK;
+}
@@ -0,0 +1,326 @@
+/**
+ * @file udp.c
+ * @provides udpInit, udpBind, udpClose, and udpRecv
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/6/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <icmp.h>
+#include <udp.h>
+#include <slab.h>
+
+/* Global UDP socket table definition */
+struct udpInfo udp;
+
+/* Private/helper functions */
+int udpLookup(ushort port);
+int udpEphemeral(void);
+
+
+/**
+ * Initialize the UDP socket table
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall udpInit(void)
+{
+    int i;
+
+    udp.sema = semcreate(1);
+    udp.nextEphem = UDP_EPHEM_FIRST;
+    udp.noPort = 0;
+    udp.badSum = 0;
+    udp.ringSlab = slabCreate("udp ring",
+                              UDP_RING_LEN * sizeof(struct udpDgram),
+                              1, UDP_MAX_SOCKS);
+
+    for (i = 0; i < UDP_HASH_LEN; i++)
+        udp.hash[i] = UDP_NO_SOCK;
+
+    for (i = 0; i < UDP_MAX_SOCKS; i++)
+    {
+        udp.socks[i].state = UDP_SOCK_FREE;
+        udp.socks[i].next = UDP_NO_SOCK;
+        udp.socks[i].pid = UDP_NO_PID;
+        udp.socks[i].ring = NULL;
+    }
+
+    return OK;
+}
+
+
+/**
+ * Bind a UDP socket to a local port
+ * @param localPort port to receive on, 0 for an unused ephemeral port
+ * @return socket descriptor for success, SYSERR if the port is in use
+ *         or the socket table is full
+ */
+int udpBind(ushort localPort)
+{
+    int sd, port;
+    struct udpDgram *ring;
+    struct udpSock  *sock;
+
+    // Allocate the receive ring before taking the table
+    ring = (struct udpDgram *) slabAlloc(udp.ringSlab);
+    if (ring == NULL)
+        return SYSERR;
+
+    wait(udp.sema);
+
+    if (localPort == 0)
+        port = udpEphemeral();
+    else if (udpLookup(localPort) == UDP_NO_SOCK)
+        port = localPort;
+    else
+        port = SYSERR;
+
+    // Find a free socket
+    for (sd = 0; sd < UDP_MAX_SOCKS; sd++)
+    {
+        if (udp.socks[sd].state == UDP_SOCK_FREE)
+            break;
+    }
+
+    if (port == SYSERR || sd == UDP_MAX_SOCKS)
+    {
+        signal(udp.sema);
+        slabFree(udp.ringSlab, (void *) ring);
+        return SYSERR;
+    }
+
+    sock = &udp.socks[sd];
+    sock->state = UDP_SOCK_BOUND;
+    sock->flags = 0;
+    sock->localPort = port;
+    sock->pid = UDP_NO_PID;
+    sock->ring = ring;
+    sock->head = 0;
+    sock->count = 0;
+    sock->postHead = 0;
+    sock->postCount = 0;
+    sock->postFilled = 0;
+    sock->recvd = 0;
+    sock->drops = 0;
+
+    // Put the socket at the front of its hash chain
+    sock->next = udp.hash[udpHash(port)];
+    udp.hash[udpHash(port)] = sd;
+
+    signal(udp.sema);
+    return sd;
+}
+
+
+/**
+ * Close a UDP socket, dropping any queued datagrams. Buffers still
+ * posted go back to their owner as from udpUnpostBuf, filled or not,
+ * and the process waiting in udpRecvfrom or udpWaitBuf is woken.
+ * @param sd socket descriptor from udpBind
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall udpClose(int sd)
+{
+    int *link, pid;
+    struct udpDgram *ring;
+    struct udpSock  *sock;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS)
+        return SYSERR;
+
+    sock = &udp.socks[sd];
+
+    wait(udp.sema);
+
+    if (sock->state != UDP_SOCK_BOUND)
+    {
+        signal(udp.sema);
+        return SYSERR;
+    }
+
+    // Unlink the socket from its hash chain
+    link = &udp.hash[udpHash(sock->localPort)];
+    while (*link != sd)
+        link = &udp.socks[*link].next;
+    *link = sock->next;
+
+    ring = sock->ring;
+    pid = sock->pid;
+    sock->state = UDP_SOCK_FREE;
+    sock->next = UDP_NO_SOCK;
+    sock->pid = UDP_NO_PID;
+    sock->ring = NULL;
+
+    // The socket no longer owns the posted buffers
+    sock->postHead = 0;
+    sock->postCount = 0;
+    sock->postFilled = 0;
+    sock->flags &= ~UDP_FLAG_POSTED;
+
+    signal(udp.sema);
+
+    // A process blocked in udpRecvfrom or udpWaitBuf finds the socket
+    // closed
+    if (pid != UDP_NO_PID)
+        send(pid, (message) 1);
+
+    slabFree(udp.ringSlab, (void *) ring);
+    return OK;
+}
+
+
+/**
+ * Receive a UDP datagram and queue it on the socket bound to its port,
+ * or copy it straight into the socket's next posted buffer. The
+ * netDaemon never waits on a consumer: when there is no room the
+ * datagram is dropped.
+ * @param pkt received IPv4 packet
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall udpRecv(struct ipgram *pkt)
+{
+    int sd, pid;
+    ushort ipLen, ipHdrLen, udpLen, dataLen;
+    struct udpgram  *udpP = NULL;
+    struct udpSock  *sock = NULL;
+    struct udpDgram *dgram = NULL;
+    struct udpPost  *post = NULL;
+
+    if (pkt == NULL)
+        return SYSERR;
+
+    ipLen = ipGetLen(pkt);
+    ipHdrLen = ipGetHdrLen(pkt);
+    udpP = (struct udpgram *) ((uchar *) pkt + ipHdrLen);
+
+    // Screen out packets with bad UDP headers
+    if (ipLen < ipHdrLen + UDP_HDR_LEN)
+        return SYSERR;
+
+    udpLen = udpGetLen(udpP);
+    if (udpLen < UDP_HDR_LEN || udpLen > ipLen - ipHdrLen)
+        return SYSERR;
+
+    // Screen out packets with a bad checksum; a zero checksum means
+    // the sender did not compute one
+    if (udpP->chksum != 0 &&
+        csumFold(csumPartial((void *) udpP, udpLen,
+                             ipPseudoSum(pkt->src, pkt->dst,
+                                         IPv4_PROTO_UDP, udpLen))) != 0)
+    {
+        udp.badSum++;
+        return SYSERR;
+    }
+
+    dataLen = udpLen - UDP_HDR_LEN;
+
+    wait(udp.sema);
+
+    sd = udpLookup(udpGetDstPort(udpP));
+    if (sd == UDP_NO_SOCK)
+    {
+        udp.noPort++;
+        signal(udp.sema);
+
+        // Nobody is listening, let the sender fail fast
+        icmpSendError(pkt, ICMP_UNREACH_T, ICMP_PORT_UNREACH_C, 0);
+        return OK;
+    }
+
+    sock = &udp.socks[sd];
+    if (sock->flags & UDP_FLAG_POSTED)
+    {
+        if (sock->postFilled >= sock->postCount)
+        {
+            sock->drops++;
+            signal(udp.sema);
+            return OK;
+        }
+
+        // Copy the payload straight from the packet into the oldest
+        // unfilled posted buffer, truncating it to the buffer's size
+        post = &sock->posts[(sock->postHead + sock->postFilled) % UDP_POST_LEN];
+        post->len = (dataLen < post->size) ? dataLen : post->size;
+        post->srcAddr = pkt->src;
+        post->srcPort = udpGetSrcPort(udpP);
+        memcpy((void *) post->buf, (void *) udpP->data, post->len);
+        sock->postFilled++;
+    }
+    else
+    {
+        if (sock->count >= UDP_RING_LEN || dataLen > UDP_MAX_DATA)
+        {
+            sock->drops++;
+            signal(udp.sema);
+            return OK;
+        }
+
+        // Queue the datagram at the tail of the ring
+        dgram = &sock->ring[(sock->head + sock->count) % UDP_RING_LEN];
+        dgram->srcAddr = pkt->src;
+        dgram->srcPort = udpGetSrcPort(udpP);
+        dgram->len = dataLen;
+        memcpy((void *) dgram->data, (void *) udpP->data, dataLen);
+        sock->count++;
+    }
+    sock->recvd++;
+
+    pid = sock->pid;
+    sock->pid = UDP_NO_PID;
+
+    signal(udp.sema);
+
+    // Wake the process waiting on this socket
+    if (pid != UDP_NO_PID)
+        send(pid, (message) 1);
+
+    return OK;
+}
+
+
+/**
+ * Find the socket bound to a local port
+ * Caution: This function doesn't take the UDP semaphore.
+ * @param port local port
+ * @return socket descriptor, UDP_NO_SOCK if the port is not bound
+ */
+int udpLookup(ushort port)
+{
+    int sd;
+
+    for (sd = udp.hash[udpHash(port)]; sd != UDP_NO_SOCK; sd = udp.socks[sd].next)
+    {
+        if (udp.socks[sd].localPort == port)
+            return sd;
+    }
+    return UDP_NO_SOCK;
+}
+
+
+/**
+ * Pick an unbound ephemeral port
+ * Caution: This function doesn't take the UDP semaphore.
+ * @return port number, SYSERR if every ephemeral port is bound
+ */
+int udpEphemeral(void)
+{
+    int i;
+    ushort port;
+
+    for (i = 0; i <= UDP_EPHEM_LAST - UDP_EPHEM_FIRST; i++)
+    {
+        port = udp.nextEphem;
+
+        if (udp.nextEphem == UDP_EPHEM_LAST)
+            udp.nextEphem = UDP_EPHEM_FIRST;
+        else
+            udp.nextEphem++;
+
+        if (udpLookup(port) == UDP_NO_SOCK)
+            return port;
+    }
+    return SYSERR;
+}
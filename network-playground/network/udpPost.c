@@ -0,0 +1,180 @@
+/**
+ * @file udpPost.c
+ * @provides udpPostBuf, udpWaitBuf, and udpUnpostBuf
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/6/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <udp.h>
+
+
+/**
+ * Post a buffer for the next datagram to arrive on a UDP socket. The
+ * netDaemon copies the payload straight from the received packet into
+ * it, skipping the socket's ring. Once a buffer is posted the socket
+ * only receives through udpWaitBuf, until udpUnpostBuf takes the
+ * buffers back; datagrams that arrive while no buffer is posted are
+ * dropped.
+ * @param sd   socket descriptor from udpBind
+ * @param buf  buffer to receive into, owned by the socket until
+ *             udpWaitBuf returns it
+ * @param size size of the buffer in bytes
+ * @return OK for success, SYSERR for syntax error or too many buffers
+ */
+syscall udpPostBuf(int sd, void *buf, ushort size)
+{
+    struct udpSock      *sock = NULL;
+    struct udpPost      *post = NULL;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS || buf == NULL)
+        return SYSERR;
+
+    sock = &udp.socks[sd];
+
+    wait(udp.sema);
+
+    if (sock->state != UDP_SOCK_BOUND || sock->postCount >= UDP_POST_LEN)
+    {
+        signal(udp.sema);
+        return SYSERR;
+    }
+
+    post = &sock->posts[(sock->postHead + sock->postCount) % UDP_POST_LEN];
+    post->buf = (uchar *) buf;
+    post->size = size;
+    post->len = 0;
+    sock->postCount++;
+    sock->flags |= UDP_FLAG_POSTED;
+
+    signal(udp.sema);
+    return OK;
+}
+
+
+/**
+ * Wait for the oldest posted buffer of a UDP socket to be filled and
+ * take it back. Buffers are returned in the order they were posted.
+ * @param sd      socket descriptor from udpBind
+ * @param buf     filled buffer return value
+ * @param srcAddr sender's IPv4 address return value, may be NULL
+ * @param srcPort sender's UDP port return value, may be NULL
+ * @param timeout milliseconds to wait, 0 to poll
+ * @return number of bytes in the buffer, TIMEOUT if nothing arrived in
+ *         time, SYSERR for syntax error, a closed socket or no buffers
+ */
+int udpWaitBuf(int sd, void **buf, ipaddr *srcAddr, ushort *srcPort,
+               int timeout)
+{
+    struct udpSock      *sock = NULL;
+    struct udpPost      *post = NULL;
+    ulong               start, elapsed;
+    int                 n;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS || buf == NULL)
+        return SYSERR;
+
+    sock = &udp.socks[sd];
+    start = netTime();
+
+    while (1)
+    {
+        wait(udp.sema);
+
+        if (sock->state != UDP_SOCK_BOUND || sock->postCount == 0)
+        {
+            signal(udp.sema);
+            return SYSERR;
+        }
+
+        // Hand back the oldest buffer once it is filled
+        if (sock->postFilled > 0)
+        {
+            post = &sock->posts[sock->postHead];
+            *buf = (void *) post->buf;
+            n = post->len;
+            if (srcAddr != NULL)
+                *srcAddr = post->srcAddr;
+            if (srcPort != NULL)
+                *srcPort = post->srcPort;
+
+            sock->postHead = (sock->postHead + 1) % UDP_POST_LEN;
+            sock->postCount--;
+            sock->postFilled--;
+
+            signal(udp.sema);
+            return n;
+        }
+
+        elapsed = netTime() - start;
+        if (elapsed >= timeout)
+        {
+            signal(udp.sema);
+            return TIMEOUT;
+        }
+
+        // Ask the netDaemon for a wake up, then sleep until one arrives
+        recvclr();
+        sock->pid = getpid();
+        signal(udp.sema);
+
+        recvtime(timeout - elapsed);
+
+        // Withdraw the wake up request if it was not used
+        wait(udp.sema);
+        if (sock->pid == getpid())
+            sock->pid = UDP_NO_PID;
+        signal(udp.sema);
+    }
+}
+
+
+/**
+ * Take back every buffer still posted to a UDP socket, filled or not,
+ * and go back to receiving through the socket's ring and udpRecvfrom.
+ * Datagrams in filled buffers that udpWaitBuf did not return are lost.
+ * A process waiting in udpWaitBuf finds no buffers and gets SYSERR.
+ * @param sd   socket descriptor from udpBind
+ * @param bufs receives the buffers in the order they were posted, room
+ *             for UDP_POST_LEN; may be NULL
+ * @return number of buffers taken back, SYSERR for syntax error
+ */
+int udpUnpostBuf(int sd, void **bufs)
+{
+    struct udpSock      *sock = NULL;
+    int                 i, n, pid;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS)
+        return SYSERR;
+
+    sock = &udp.socks[sd];
+
+    wait(udp.sema);
+
+    if (sock->state != UDP_SOCK_BOUND)
+    {
+        signal(udp.sema);
+        return SYSERR;
+    }
+
+    n = sock->postCount;
+    for (i = 0; i < n && bufs != NULL; i++)
+        bufs[i] = (void *) sock->posts[(sock->postHead + i) % UDP_POST_LEN].buf;
+
+    sock->postHead = 0;
+    sock->postCount = 0;
+    sock->postFilled = 0;
+    sock->flags &= ~UDP_FLAG_POSTED;
+    pid = sock->pid;
+    sock->pid = UDP_NO_PID;
+
+    signal(udp.sema);
+
+    if (pid != UDP_NO_PID)
+        send(pid, (message) 1);
+
+    return n;
+}
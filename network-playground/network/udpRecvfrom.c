@@ -0,0 +1,91 @@
+/**
+ * @file udpRecvfrom.c
+ * @provides udpRecvfrom
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/6/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <udp.h>
+
+
+/**
+ * Receive the next datagram queued on a UDP socket, waiting for one
+ * to arrive if the ring is empty. A payload longer than the buffer is
+ * truncated.
+ * @param sd      socket descriptor from udpBind
+ * @param buf     buffer for the payload
+ * @param len     size of the buffer in bytes
+ * @param srcAddr sender's IPv4 address return value, may be NULL
+ * @param srcPort sender's UDP port return value, may be NULL
+ * @param timeout milliseconds to wait, 0 to poll
+ * @return number of bytes received, TIMEOUT if nothing arrived in time,
+ *         SYSERR for syntax error, a closed socket or one that receives
+ *         into posted buffers
+ */
+int udpRecvfrom(int sd, void *buf, ushort len, ipaddr *srcAddr,
+                ushort *srcPort, int timeout)
+{
+    struct udpSock      *sock = NULL;
+    struct udpDgram     *dgram = NULL;
+    ulong               start, elapsed;
+    int                 n;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS || buf == NULL)
+        return SYSERR;
+
+    sock = &udp.socks[sd];
+    start = netTime();
+
+    while (1)
+    {
+        wait(udp.sema);
+
+        if (sock->state != UDP_SOCK_BOUND || (sock->flags & UDP_FLAG_POSTED))
+        {
+            signal(udp.sema);
+            return SYSERR;
+        }
+
+        // Take the oldest datagram off the ring
+        if (sock->count > 0)
+        {
+            dgram = &sock->ring[sock->head];
+            n = (dgram->len < len) ? dgram->len : len;
+            memcpy(buf, (void *) dgram->data, n);
+            if (srcAddr != NULL)
+                *srcAddr = dgram->srcAddr;
+            if (srcPort != NULL)
+                *srcPort = dgram->srcPort;
+
+            sock->head = (sock->head + 1) % UDP_RING_LEN;
+            sock->count--;
+
+            signal(udp.sema);
+            return n;
+        }
+
+        elapsed = netTime() - start;
+        if (elapsed >= timeout)
+        {
+            signal(udp.sema);
+            return TIMEOUT;
+        }
+
+        // Ask the netDaemon for a wake up, then sleep until one arrives
+        recvclr();
+        sock->pid = getpid();
+        signal(udp.sema);
+
+        recvtime(timeout - elapsed);
+
+        // Withdraw the wake up request if it was not used
+        wait(udp.sema);
+        if (sock->pid == getpid())
+            sock->pid = UDP_NO_PID;
+        signal(udp.sema);
+    }
+}
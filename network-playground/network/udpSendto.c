@@ -0,0 +1,93 @@
+/**
+ * @file udpSendto.c
+ * @provides udpSendto
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/6/2016        */
+
+#include <xinu.h>
+#include <network.h>
+#include <udp.h>
+
+
+/**
+ * Send a UDP datagram from a bound socket
+ * @param sd      socket descriptor from udpBind
+ * @param buf     payload to send
+ * @param len     length of the payload in bytes
+ * @param dstAddr destination IPv4 address
+ * @param dstPort destination UDP port
+ * @param tos     precedence, IPv4_TOS_ROUTINE unless the datagram is
+ *                control traffic
+ * @return OK for success, SYSERR for syntax error
+ */
+syscall udpSendto(int sd, void *buf, ushort len, ipaddr dstAddr,
+                  ushort dstPort, uchar tos)
+{
+    struct ethPktBuffer *frame = NULL;
+    struct udpgram      *udpP = NULL;
+    ushort              srcPort, id, udpLen;
+    ulong               sum;
+    syscall             result;
+
+    if (sd < 0 || sd >= UDP_MAX_SOCKS || (buf == NULL && len > 0) ||
+        len > IPv4_MAX_PKT_LEN - IPv4_HDR_LEN - UDP_HDR_LEN)
+        return SYSERR;
+
+    wait(udp.sema);
+    if (udp.socks[sd].state != UDP_SOCK_BOUND)
+    {
+        signal(udp.sema);
+        return SYSERR;
+    }
+    srcPort = udp.socks[sd].localPort;
+    signal(udp.sema);
+    id = ipNextId();
+
+    // Datagrams that fit a frame are built in a driver frame, so the
+    // payload is copied exactly once; ones that ipWrite has to fragment
+    // still go through the heap
+    udpLen = UDP_HDR_LEN + len;
+    if (IPv4_HDR_LEN + udpLen <= ETH_MTU)
+    {
+        frame = netFrameGet();
+        if (frame == NULL)
+            return SYSERR;
+        udpP = (struct udpgram *) ipFramePayload(frame);
+    }
+    else
+    {
+        udpP = (struct udpgram *) malloc(udpLen);
+        if (udpP == NULL)
+            return SYSERR;
+    }
+
+    /* Set up UDP header */
+    udpP->srcPort = htons(srcPort);
+    udpP->dstPort = htons(dstPort);
+    udpP->len = htons(udpLen);
+    udpP->chksum = 0;
+
+    // Copy the payload and sum it in one pass, then add in the header
+    // and the pseudo-header
+    sum = csumPartialCopy((void *) udpP->data, buf, len,
+                          ipPseudoSum(net.ipAddr, dstAddr,
+                                      IPv4_PROTO_UDP, udpLen));
+    udpP->chksum = csumFold(csumPartial((void *) udpP, UDP_HDR_LEN, sum));
+
+    // A computed checksum of zero is sent as all ones
+    if (udpP->chksum == 0)
+        udpP->chksum = 0xFFFF;
+
+    /* Send packet */
+    if (frame != NULL)
+        return ipSend(frame, id, udpLen, IPv4_PROTO_UDP, IPv4_TTL, tos,
+                      dstAddr);
+
+    result = ipWrite((void *) udpP, id, udpLen, IPv4_PROTO_UDP, IPv4_TTL, tos,
+                     dstAddr);
+    free((void *) udpP);
+    return result;
+}
@@ -9,28 +9,42 @@
 
 /* Prototypes for shell commands defined in other files. */
 command xsh_arp(int, char *[]);
+command xsh_capture(int, char *[]);
 command xsh_clear(int, char *[]);
+command xsh_dhcp(int, char *[]);
 command xsh_ethstat(int, char *[]);
 command xsh_exit(int, char *[]);
+command xsh_firewall(int, char *[]);
 command xsh_help(int, char *[]);
 command xsh_kill(int, char *[]);
 command xsh_memstat(int, char *[]);
+command xsh_netbench(int, char *[]);
+command xsh_netstat(int, char *[]);
 command xsh_ping(int, char *[]);
 command xsh_ps(int, char *[]);
+command xsh_shape(int, char *[]);
 command xsh_test(int, char *[]);
+command xsh_traceroute(int, char *[]);
 //hello world!!!
 /* This structure describes commands available to the shell. */
 struct centry commandtab[] = {
     {"arp", TRUE, xsh_arp},
+    {"capture", FALSE, xsh_capture},
     {"clear", TRUE, xsh_clear},
+    {"dhcp", FALSE, xsh_dhcp},
     {"ethstat", FALSE, xsh_ethstat},
     {"exit", TRUE, xsh_exit},
+    {"firewall", FALSE, xsh_firewall},
     {"help", FALSE, xsh_help},
     {"kill", TRUE, xsh_kill},
     {"memstat", FALSE, xsh_memstat},
+    {"netbench", FALSE, xsh_netbench},
+    {"netstat", FALSE, xsh_netstat},
     {"ping", TRUE, xsh_ping},
     {"ps", FALSE, xsh_ps},
+    {"shape", FALSE, xsh_shape},
     {"test", FALSE, xsh_test},
+    {"traceroute", TRUE, xsh_traceroute},
     {"?", FALSE, xsh_help}
 };
 
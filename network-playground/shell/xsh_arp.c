@@ -23,9 +23,9 @@ int arpTablePrint(void);
  */
 command xsh_arp(int nargs, char *args[])
 {
-    uchar tmp_ipAddr[IP_ADDR_LEN];
+    ipaddr ipAddr;
     uchar hwAddr[ETH_ADDR_LEN];
-    int i, j;
+    int i;
     
     // If the user gave no arguments display arp table contents
     if (nargs < 2)
@@ -46,30 +46,15 @@ command xsh_arp(int nargs, char *args[])
     /********************************/
     if (strcmp("-d",args[1]) == 0)
     {
-        if (OK == dot2ip(args[2],tmp_ipAddr))
+        if (OK == dot2ip(args[2], (uchar *) &ipAddr))
         {
             wait(arp.sema);
-            for (i = 0; i < ARP_TABLE_LEN; i++)
-            {
-                // Skip comparision if known invalid
-                if (arp.tbl[i].osFlags == ARP_ENT_INVALID)
-                    continue;
-                
-                // Compare addresses
-                for(j = 0; j < IP_ADDR_LEN; j++)
-                {
-                    // Stop checking if there is a difference
-                    if (tmp_ipAddr[j] != arp.tbl[i].ipAddr[j])
-                        break;
-                }
-                
-                // The address is the same, then invalidate its mac
-                if (j == IP_ADDR_LEN)
-                {
-                    arp.tbl[i].osFlags = ARP_ENT_IP_ONLY;
-                    break;
-                }
-            }
+            
+            // If the address is in the table, then invalidate its mac
+            i = arpFindEntry(ipAddr);
+            if (i != ARP_ENT_NOT_FOUND)
+                arp.tbl[i].osFlags = ARP_ENT_IP_ONLY;
+            
             signal(arp.sema);
         }
         else
@@ -83,9 +68,9 @@ command xsh_arp(int nargs, char *args[])
     /**********************************************************/
     else if (strcmp("-a",args[1]) == 0)
     {
-        if (OK == dot2ip(args[2],tmp_ipAddr))
+        if (OK == dot2ip(args[2], (uchar *) &ipAddr))
         {
-            if(OK == arpResolve(tmp_ipAddr, hwAddr))
+            if(OK == arpResolve(ipAddr, hwAddr))
             {
                 printf("arp: Resolved MAC address: ");
                 for(i = 0; i < ETH_ADDR_LEN-1; i++)
@@ -139,8 +124,8 @@ int arpTablePrint(void)
         
         // Print the IP addr
         for (j = 0; j < IP_ADDR_LEN-1; j++)
-            printf("%d.",arp.tbl[i].ipAddr[j]);
-        printf("%d",arp.tbl[i].ipAddr[IP_ADDR_LEN-1]);
+            printf("%d.", IP_BYTE(arp.tbl[i].ipAddr, j));
+        printf("%d", IP_BYTE(arp.tbl[i].ipAddr, IP_ADDR_LEN-1));
         
         // Print tab spacing
         printf("\t");
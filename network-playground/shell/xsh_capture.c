@@ -0,0 +1,196 @@
+/**
+ * @file     xsh_capture.c
+ * @provides xsh_capture
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <stdlib.h>
+#include <capture.h>
+
+/* Private/helper functions */
+int capturePrint(void);
+int captureReadFilter(void);
+bool captureParseNum(char **pos, ulong *value);
+
+/**
+ * Shell command to capture frames and write them out as a pcap file
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_capture(int nargs, char *args[])
+{
+    int snaplen, count;
+
+    // If the user gave no arguments display the capture state
+    if (nargs < 2)
+        return capturePrint();
+
+    if (strcmp("start", args[1]) == 0 && nargs <= 3)
+    {
+        snaplen = (nargs == 3) ? atoi(args[2]) : 0;
+        if (SYSERR == captureStart(snaplen))
+        {
+            printf("capture: snaplen must be %d to %d bytes\n",
+                   ETH_HEADER_LEN, CAPTURE_SNAPLEN_MAX);
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    if (strcmp("stop", args[1]) == 0 && nargs == 2)
+        return captureStop();
+
+    if (strcmp("filter", args[1]) == 0 && nargs == 2)
+        return captureReadFilter();
+
+    if (strcmp("filter", args[1]) == 0 && nargs == 3 &&
+        strcmp("off", args[2]) == 0)
+        return captureFilter(NULL, 0);
+
+    if (strcmp("dump", args[1]) == 0 && nargs == 2)
+    {
+        printf("capture: writing pcap to TTY1\n");
+        count = captureDump(TTY1);
+        if (count == SYSERR)
+        {
+            printf("capture: nothing captured\n");
+            return SYSERR;
+        }
+        printf("capture: %d frames written\n", count);
+        return OK;
+    }
+
+    // Print helper info about this shell command
+    printf("capture [start [snaplen] | stop | filter [off] | dump]\n");
+    printf("    start  copy received and sent frames into the capture ring,\n");
+    printf("           keeping snaplen bytes of each (default %d); sent\n",
+           CAPTURE_SNAPLEN);
+    printf("           frames are stamped as they join a transmit queue\n");
+    printf("    stop   stop capturing; the ring keeps its frames\n");
+    printf("    filter read a BPF program in 'tcpdump -ddd' format from the\n");
+    printf("           console and capture only the frames it accepts;\n");
+    printf("           'off' captures every frame again\n");
+    printf("    dump   write the ring to TTY1 as a pcap file, following new\n");
+    printf("           frames until capture stops or none come for %d ms,\n",
+           CAPTURE_IDLE);
+    printf("           e.g. 'cat /dev/ttyUSB1 > unit.pcap' on the host\n");
+    printf("           NOTE: the capture state is displayed if no arguments\n");
+    printf("                 are given\n");
+    return OK;
+}
+
+
+/**
+ * Helper function to print the capture state to the console
+ * @return OK for success, SYSERR for syntax error
+ */
+int capturePrint(void)
+{
+    struct captureInfo copy;
+    irqmask im;
+
+    // Take a consistent copy; the counters change as frames arrive
+    im = disable();
+    memcpy((void *) &copy, (void *) &capture, sizeof(copy));
+    restore(im);
+
+    printf("Capture:      %s, %d byte snaplen\n", copy.on ? "on" : "off",
+           copy.snaplen);
+    printf("Frames:       %d captured, %d dropped with the ring full\n",
+           copy.frames, copy.drops);
+    printf("Filter:       %s, %d frames rejected\n",
+           (copy.filter == NULL) ? "none" : "loaded", copy.filtered);
+    printf("Dumped:       %d frames\n", copy.dumped);
+    printf("Ring:         %d of %d bytes waiting\n", copy.head - copy.tail,
+           CAPTURE_RING_LEN);
+
+    return OK;
+}
+
+
+/**
+ * Helper function to read a BPF program in the format 'tcpdump -ddd'
+ * prints from the console: a line with the count of instructions, then
+ * a line of "code jt jf k" for each, in decimal. The program is
+ * verified before it replaces the capture filter.
+ * @return OK for success, SYSERR for syntax error
+ */
+int captureReadFilter(void)
+{
+    struct bpfInsn insns[BPF_MAXINSNS];
+    char line[SHELL_BUFLEN];
+    char *pos;
+    ulong count, code, jt, jf, k;
+    int i;
+
+    printf("Paste 'tcpdump -ddd' output:\n");
+
+    if (fgets(stdin, line, SHELL_BUFLEN) == NULL)
+        return SYSERR;
+    pos = line;
+    if (!captureParseNum(&pos, &count) || count < 1 || count > BPF_MAXINSNS)
+    {
+        printf("capture: expected 1 to %d instructions\n", BPF_MAXINSNS);
+        return SYSERR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (fgets(stdin, line, SHELL_BUFLEN) == NULL)
+            return SYSERR;
+        pos = line;
+        if (!captureParseNum(&pos, &code) || !captureParseNum(&pos, &jt) ||
+            !captureParseNum(&pos, &jf) || !captureParseNum(&pos, &k) ||
+            code > 0xFFFF || jt > 0xFF || jf > 0xFF)
+        {
+            printf("capture: instruction %d is not \"code jt jf k\"\n", i);
+            return SYSERR;
+        }
+        insns[i].code = code;
+        insns[i].jt = jt;
+        insns[i].jf = jf;
+        insns[i].k = k;
+    }
+
+    if (SYSERR == captureFilter(insns, count))
+    {
+        printf("capture: program rejected by the verifier\n");
+        return SYSERR;
+    }
+    printf("capture: %d instruction filter loaded\n", count);
+
+    return OK;
+}
+
+
+/**
+ * Helper function to parse an unsigned decimal number, skipping the
+ * whitespace before it
+ * @param pos   where to start; moved past the number
+ * @param value the number
+ * @return TRUE if a number was found, FALSE otherwise
+ */
+bool captureParseNum(char **pos, ulong *value)
+{
+    char *p = *pos;
+    ulong n = 0;
+
+    while (isWhitespace(*p))
+        p++;
+    if (*p < '0' || *p > '9')
+        return FALSE;
+
+    while (*p >= '0' && *p <= '9')
+        n = n * 10 + (*p++ - '0');
+
+    *pos = p;
+    *value = n;
+    return TRUE;
+}
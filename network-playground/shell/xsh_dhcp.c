@@ -0,0 +1,104 @@
+/**
+ * @file     xsh_dhcp.c
+ * @provides xsh_dhcp
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/10/2016       */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <dhcp.h>
+
+/* Private/helper functions */
+void dhcpPrintAddr(char *name, ipaddr addr);
+
+/* Names of the client states, indexed by state */
+static char *dhcpStates[] = {
+    "INIT", "INIT-REBOOT", "SELECTING", "REQUESTING",
+    "BOUND", "RENEWING", "REBINDING"
+};
+
+/**
+ * Shell command to show the DHCP lease or renew it
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_dhcp(int nargs, char *args[])
+{
+    struct dhcpInfo info;
+
+    if (isbadpid(dhcp.cId))
+    {
+        printf("DHCP client is not running\n");
+        return SYSERR;
+    }
+
+    if (nargs == 2 && strcmp("renew", args[1]) == 0)
+    {
+        wait(dhcp.sema);
+        dhcp.flags |= DHCP_FLAG_RENEW;
+        signal(dhcp.sema);
+        return OK;
+    }
+
+    if (nargs > 1)
+    {
+        // Print helper info about this shell command
+        printf("dhcp [renew]\n");
+        printf("    renew  renew the lease now instead of at T1\n");
+        printf("           NOTE: the lease is displayed if no arguments are given\n");
+        return OK;
+    }
+
+    wait(dhcp.sema);
+    info = dhcp;
+    signal(dhcp.sema);
+
+    printf("State:    %s\n", dhcpStates[info.state]);
+    dhcpPrintAddr("Address:  ", net.ipAddr);
+    dhcpPrintAddr("Netmask:  ", net.netmask);
+    dhcpPrintAddr("Gateway:  ", net.gateway);
+    dhcpPrintAddr("Server:   ", info.lease.server);
+
+    if (info.boundAt == 0)
+        printf("Lease:    none\n");
+    else if (info.expires == 0)
+        printf("Lease:    infinite\n");
+    else
+        printf("Lease:    %d s left, renew in %d s\n",
+               (info.expires > clocktime) ? info.expires - clocktime : 0,
+               (info.t1 > clocktime) ? info.t1 - clocktime : 0);
+
+    if (info.bootMs != 0)
+        printf("Bound:    %d ms after start\n", info.bootMs);
+
+    // The NVRAM driver can only read, so the lease is saved from the
+    // boot loader prompt
+    if (info.boundAt != 0)
+    {
+        printf("To boot from this lease, at the CFE prompt:\n");
+        dhcpPrintAddr("  nvram set " DHCP_NVRAM_IPADDR "=", net.ipAddr);
+        dhcpPrintAddr("  nvram set " DHCP_NVRAM_NETMASK "=", net.netmask);
+        dhcpPrintAddr("  nvram set " DHCP_NVRAM_GATEWAY "=", net.gateway);
+        dhcpPrintAddr("  nvram set " DHCP_NVRAM_SERVER "=", info.lease.server);
+        printf("  nvram commit\n");
+    }
+
+    return OK;
+}
+
+
+/**
+ * Print a labelled IPv4 address in dot-decimal form
+ * @param name label printed before the address
+ * @param addr address to print
+ */
+void dhcpPrintAddr(char *name, ipaddr addr)
+{
+    printf("%s%d.%d.%d.%d\n", name, IP_BYTE(addr, 0), IP_BYTE(addr, 1),
+           IP_BYTE(addr, 2), IP_BYTE(addr, 3));
+}
@@ -0,0 +1,357 @@
+/**
+ * @file     xsh_firewall.c
+ * @provides xsh_firewall
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <stdlib.h>
+#include <firewall.h>
+
+/* Private/helper functions */
+int fwTablePrint(void);
+int fwParseRule(int nargs, char *args[], struct fwRule *rule);
+int fwParsePrefix(char *arg, ipaddr *addr, ipaddr *mask);
+int fwParseRange(char *arg, ushort *lo, ushort *hi);
+int fwParseAction(char *arg);
+void fwFormatPrefix(char *buf, ipaddr addr, ipaddr mask);
+void fwFormatRange(char *buf, ushort lo, ushort hi);
+
+/**
+ * Shell command to print and change the firewall rules
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_firewall(int nargs, char *args[])
+{
+    struct fwRule rule;
+    int action;
+
+    // If the user gave no arguments display the firewall rules
+    if (nargs < 2)
+        return fwTablePrint();
+
+    if (strcmp("-a", args[1]) == 0 && nargs >= 3)
+    {
+        if (SYSERR == fwParseRule(nargs - 2, &args[2], &rule))
+            return SYSERR;
+        if (SYSERR == fwAdd(&rule, -1))
+        {
+            printf("firewall: at most %d rules, or out of memory\n", FW_RULES);
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    if (strcmp("-i", args[1]) == 0 && nargs >= 4)
+    {
+        if (SYSERR == fwParseRule(nargs - 3, &args[3], &rule))
+            return SYSERR;
+        if (SYSERR == fwAdd(&rule, atoi(args[2])))
+        {
+            printf("firewall: at most %d rules, or out of memory\n", FW_RULES);
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    if (strcmp("-d", args[1]) == 0 && nargs == 3)
+    {
+        if (SYSERR == fwRemove(atoi(args[2])))
+        {
+            printf("firewall: no such rule\n");
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    if (strcmp("-F", args[1]) == 0 && nargs == 2)
+        return fwLoad(NULL, 0);
+
+    if (strcmp("-P", args[1]) == 0 && nargs == 3)
+    {
+        action = fwParseAction(args[2]);
+        if (action == SYSERR)
+            return SYSERR;
+        return fwPolicy(action);
+    }
+
+    // Print helper info about this shell command
+    printf("firewall [-a rule | -i N rule | -d N | -F | -P accept|drop]\n");
+    printf("    -a  append a rule\n");
+    printf("    -i  insert a rule before rule N\n");
+    printf("    -d  remove rule N\n");
+    printf("    -F  remove every rule\n");
+    printf("    -P  set the fate of packets no rule matches\n");
+    printf("    rule is: accept|drop [src IP[/len]] [dst IP[/len]]\n");
+    printf("             [tcp|udp|icmp|proto N] [sport P[-P]] [dport P[-P]]\n");
+    printf("             [type T]\n");
+    printf("             ports need tcp or udp, type needs icmp; the first\n");
+    printf("             rule a received packet matches decides its fate\n");
+    printf("           NOTE: firewall rules are displayed if no arguments\n");
+    printf("                 are given\n");
+    return OK;
+}
+
+
+/**
+ * Helper function to print the firewall rules and their counters to the
+ * console
+ * @return OK for success, SYSERR for syntax error
+ */
+int fwTablePrint(void)
+{
+    struct fwRule r;
+    char src[20], dst[20], sport[12], dport[12];
+    irqmask im;
+    int i;
+
+    printf("Policy: %s, %d packets matched no rule, %d dropped\n",
+           (fw.policy == FW_DROP) ? "drop" : "accept", fw.missed, fw.dropped);
+    printf("  #  Action  Source              Destination         Proto  Sport        Dport          Packets       Bytes\n");
+    for (i = 0; i < FW_RULES; i++)
+    {
+        // Take a consistent copy; the table is swapped as rules change
+        im = disable();
+        if (fw.table == NULL || i >= fw.table->count)
+        {
+            restore(im);
+            break;
+        }
+        memcpy((void *) &r, (void *) &fw.table->rules[i], sizeof(r));
+        restore(im);
+
+        fwFormatPrefix(src, r.src, r.srcMask);
+        fwFormatPrefix(dst, r.dst, r.dstMask);
+        fwFormatRange(sport, r.sportLo, r.sportHi);
+        fwFormatRange(dport, r.dportLo, r.dportHi);
+
+        printf("%3d  %-6s  %-18s  %-18s  ", i,
+               (r.action == FW_DROP) ? "drop" : "accept", src, dst);
+        if (r.proto == IPv4_PROTO_TCP)
+            printf("%-5s", "tcp");
+        else if (r.proto == IPv4_PROTO_UDP)
+            printf("%-5s", "udp");
+        else if (r.proto == IPv4_PROTO_ICMP)
+            printf("%-5s", "icmp");
+        else if (r.proto == 0)
+            printf("%-5s", "any");
+        else
+            printf("%-5d", r.proto);
+        printf("  %-11s  %-11s  %9d  %10d\n", sport, dport, r.packets, r.bytes);
+    }
+
+    return OK;
+}
+
+
+/**
+ * Helper function to parse a rule given as arguments
+ * @param nargs count of arguments in args
+ * @param args  the action, then what the rule matches
+ * @param rule  the rule
+ * @return OK for success, SYSERR for syntax error
+ */
+int fwParseRule(int nargs, char *args[], struct fwRule *rule)
+{
+    int i, action;
+
+    bzero((void *) rule, sizeof(struct fwRule));
+    rule->sportHi = FW_PORT_MAX;
+    rule->dportHi = FW_PORT_MAX;
+
+    action = fwParseAction(args[0]);
+    if (action == SYSERR)
+        return SYSERR;
+    rule->action = action;
+
+    for (i = 1; i < nargs; i++)
+    {
+        if (strcmp("tcp", args[i]) == 0)
+            rule->proto = IPv4_PROTO_TCP;
+        else if (strcmp("udp", args[i]) == 0)
+            rule->proto = IPv4_PROTO_UDP;
+        else if (strcmp("icmp", args[i]) == 0)
+            rule->proto = IPv4_PROTO_ICMP;
+        else if (i + 1 >= nargs)
+            break;
+        else if (strcmp("src", args[i]) == 0)
+        {
+            if (SYSERR == fwParsePrefix(args[++i], &rule->src, &rule->srcMask))
+                return SYSERR;
+        }
+        else if (strcmp("dst", args[i]) == 0)
+        {
+            if (SYSERR == fwParsePrefix(args[++i], &rule->dst, &rule->dstMask))
+                return SYSERR;
+        }
+        else if (strcmp("proto", args[i]) == 0)
+            rule->proto = atoi(args[++i]);
+        else if (strcmp("sport", args[i]) == 0)
+        {
+            if (SYSERR == fwParseRange(args[++i], &rule->sportLo, &rule->sportHi))
+                return SYSERR;
+        }
+        else if (strcmp("dport", args[i]) == 0 || strcmp("type", args[i]) == 0)
+        {
+            if (SYSERR == fwParseRange(args[++i], &rule->dportLo, &rule->dportHi))
+                return SYSERR;
+        }
+        else
+            break;
+    }
+
+    if (i < nargs)
+    {
+        printf("firewall: unexpected '%s'\n", args[i]);
+        return SYSERR;
+    }
+
+    if ((rule->sportLo != 0 || rule->sportHi != FW_PORT_MAX) &&
+        rule->proto != IPv4_PROTO_TCP && rule->proto != IPv4_PROTO_UDP)
+    {
+        printf("firewall: ports need tcp or udp\n");
+        return SYSERR;
+    }
+    if ((rule->dportLo != 0 || rule->dportHi != FW_PORT_MAX) &&
+        rule->proto != IPv4_PROTO_TCP && rule->proto != IPv4_PROTO_UDP &&
+        rule->proto != IPv4_PROTO_ICMP)
+    {
+        printf("firewall: ports need tcp or udp, types need icmp\n");
+        return SYSERR;
+    }
+
+    return OK;
+}
+
+
+/**
+ * Helper function to parse an address prefix, e.g. 192.168.1.0/24
+ * @param arg  the prefix; a bare address is a /32
+ * @param addr the address
+ * @param mask its netmask
+ * @return OK for success, SYSERR for syntax error
+ */
+int fwParsePrefix(char *arg, ipaddr *addr, ipaddr *mask)
+{
+    char *slash = NULL;
+    int len = 32;
+
+    for (slash = arg; *slash != '\0' && *slash != '/'; slash++)
+        ;
+    if (*slash == '/')
+    {
+        *slash = '\0';
+        len = atoi(slash + 1);
+    }
+
+    if (len < 0 || len > 32 || SYSERR == dot2ip(arg, (uchar *) addr))
+    {
+        printf("firewall: invalid prefix, example: 192.168.1.0/24\n");
+        return SYSERR;
+    }
+
+    *mask = (len == 0) ? 0 : htonl(0xFFFFFFFF << (32 - len));
+    *addr &= *mask;
+
+    return OK;
+}
+
+
+/**
+ * Helper function to parse a port or type, or a range of them, e.g.
+ * 1024-65535
+ * @param arg the value or range
+ * @param lo  lowest value
+ * @param hi  highest value
+ * @return OK for success, SYSERR for syntax error
+ */
+int fwParseRange(char *arg, ushort *lo, ushort *hi)
+{
+    char *dash = NULL;
+    long first, last;
+
+    for (dash = arg; *dash != '\0' && *dash != '-'; dash++)
+        ;
+    first = atol(arg);
+    last = (*dash == '-') ? atol(dash + 1) : first;
+
+    if (first < 0 || last < first || last > FW_PORT_MAX)
+    {
+        printf("firewall: invalid range, example: 1024-65535\n");
+        return SYSERR;
+    }
+
+    *lo = first;
+    *hi = last;
+
+    return OK;
+}
+
+
+/**
+ * Helper function to parse an action
+ * @param arg "accept" or "drop"
+ * @return FW_ACCEPT or FW_DROP, SYSERR for syntax error
+ */
+int fwParseAction(char *arg)
+{
+    if (strcmp("accept", arg) == 0)
+        return FW_ACCEPT;
+    if (strcmp("drop", arg) == 0)
+        return FW_DROP;
+
+    printf("firewall: action must be accept or drop\n");
+    return SYSERR;
+}
+
+
+/**
+ * Helper function to format an address prefix, "any" if it is empty
+ * @param buf  at least 19 bytes
+ * @param addr address
+ * @param mask its netmask
+ */
+void fwFormatPrefix(char *buf, ipaddr addr, ipaddr mask)
+{
+    ulong host = ntohl(mask);
+    int len = 0;
+
+    if (mask == 0)
+    {
+        sprintf(buf, "any");
+        return;
+    }
+
+    while (host & 0x80000000)
+    {
+        len++;
+        host <<= 1;
+    }
+    sprintf(buf, "%d.%d.%d.%d/%d", IP_BYTE(addr, 0), IP_BYTE(addr, 1),
+            IP_BYTE(addr, 2), IP_BYTE(addr, 3), len);
+}
+
+
+/**
+ * Helper function to format a range of ports or types, "any" if it is
+ * all of them
+ * @param buf at least 12 bytes
+ * @param lo  lowest value
+ * @param hi  highest value
+ */
+void fwFormatRange(char *buf, ushort lo, ushort hi)
+{
+    if (lo == 0 && hi == FW_PORT_MAX)
+        sprintf(buf, "any");
+    else if (lo == hi)
+        sprintf(buf, "%d", lo);
+    else
+        sprintf(buf, "%d-%d", lo, hi);
+}
@@ -0,0 +1,1055 @@
+/**
+ * @file     xsh_netbench.c
+ * @provides xsh_netbench
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/5/2016        */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <network.h>
+#include <udp.h>
+#include <tcp.h>
+#include <dcache.h>
+#include <arp.h>
+#include <bpf.h>
+#include <firewall.h>
+
+#define BENCH_ITERS     10000
+#define BENCH_UDP_ITERS 1000
+#define BENCH_UDP_LEN   32      /* Small datagram payload */
+#define BENCH_UDP_BIG   1400    /* Telemetry sized datagram payload */
+#define BENCH_UDP_PORT  9       /* Discard service */
+#define BENCH_TCP_BYTES (1024 * 1024)
+#define BENCH_TCP_PORT  5001    /* Default port of the sink on the host */
+#define BENCH_TCP_WAIT  5000    /* ms to wait for the handshake */
+#define BENCH_CACHE_BURST  16   /* Frames per ring harvest */
+#define BENCH_CACHE_ROUNDS 100
+#define BENCH_PRIO_FRAMES  4000 /* Bulk datagrams per priority run */
+#define BENCH_PRIO_EVERY   16   /* Bulk datagrams per small datagram */
+#define BENCH_BPF_PROGS    4    /* Filters timed by benchBpf */
+#define BENCH_BPF_FRAMES   3    /* Frames run through each filter */
+#define BENCH_FW_SIZES     4    /* Rule set sizes timed by benchFirewall */
+
+/* Word aligned scratch buffers shared by the benchmarks */
+static ulong benchSrc[(ETH_MTU + 3) / 4];
+static ulong benchDst[(ETH_MTU + 3) / 4];
+
+/* Filters timed by benchBpf, as 'tcpdump -ddd' prints them */
+static struct bpfInsn benchBpfAll[] = {
+    { 0x06, 0, 0, 262144 },
+};
+static struct bpfInsn benchBpfArp[] = {
+    { 0x28, 0, 0, 12 }, { 0x15, 0, 1, 0x806 }, { 0x06, 0, 0, 262144 },
+    { 0x06, 0, 0, 0 },
+};
+static struct bpfInsn benchBpfHost[] = {    /* k of 3 and 5 set to our IP */
+    { 0x28, 0, 0, 12 }, { 0x15, 0, 5, 0x800 }, { 0x20, 0, 0, 26 },
+    { 0x15, 2, 0, 0 }, { 0x20, 0, 0, 30 }, { 0x15, 0, 1, 0 },
+    { 0x06, 0, 0, 262144 }, { 0x06, 0, 0, 0 },
+};
+static struct bpfInsn benchBpfTcp[] = {
+    { 0x28, 0, 0, 12 }, { 0x15, 0, 10, 0x800 }, { 0x30, 0, 0, 23 },
+    { 0x15, 0, 8, 6 }, { 0x28, 0, 0, 20 }, { 0x45, 6, 0, 0x1fff },
+    { 0xb1, 0, 0, 14 }, { 0x48, 0, 0, 14 }, { 0x15, 2, 0, 80 },
+    { 0x48, 0, 0, 16 }, { 0x15, 0, 1, 80 }, { 0x06, 0, 0, 262144 },
+    { 0x06, 0, 0, 0 },
+};
+
+/* Private/helper functions */
+ulong benchCycles(void);
+void benchReport(char *name, int len, ulong ticks, int iters);
+int benchChecksum(void);
+int benchAddrFilter(void);
+int benchUdp(char *dst);
+int benchTcp(char *dst, char *port);
+void benchUdpBuild(struct ipgram *ip, ushort port, ushort len);
+void benchRate(char *name, ulong ticks, int iters);
+int benchCache(void);
+bool benchCacheStale(struct ethergram *eg, ushort id);
+int benchTxPrio(char *dst);
+void benchTxPrioRun(int sd, ipaddr dstAddr, uchar tos);
+int benchBpf(void);
+int benchBpfFrame(struct ethergram *eg, int frame);
+int benchFirewall(void);
+int benchFwCompiled(const struct fwTable *t, const struct ipgram *ip);
+int benchFwLinear(const struct fwRule *rules, int count,
+                  const struct ipgram *ip);
+int filterBytes(uchar *dst, uchar *ourAddr);
+int filterWord(ipaddr dst, ipaddr ourAddr);
+
+
+/**
+ * Shell command that runs network stack microbenchmarks
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_netbench(int nargs, char *args[])
+{
+    if (nargs < 2)
+    {
+        // Print helper info about this shell command
+        printf("netbench [csum|addr|cache|bpf|fw|udp [IP address]|\n");
+        printf("          tcp IP address [port]|txprio IP address]\n");
+        printf("    csum   checksum() vs. netChecksum() and copy-and-checksum\n");
+        printf("    addr   ipRecv destination filter, byte arrays vs. 32-bit words\n");
+        printf("    cache  received frames/second with uncached, per buffer and\n");
+        printf("           batched D-cache maintenance\n");
+        printf("    bpf    capture filter cost per frame for typical filters\n");
+        printf("    fw     firewall packets/second as the rule set grows, compiled\n");
+        printf("           vs. a linear scan of the rules\n");
+        printf("    udp    datagrams/second through ipRecv to a socket, copied or\n");
+        printf("           into posted buffers, and through udpSendto to the\n");
+        printf("           discard port of IP address\n");
+        printf("    tcp    bulk transfer throughput to a sink on IP address,\n");
+        printf("           e.g. 'nc -l %d > /dev/null' on the host\n", BENCH_TCP_PORT);
+        printf("    txprio queueing delay of small datagrams sent routine and\n");
+        printf("           as internetwork control, while bulk datagrams\n");
+        printf("           saturate the link to the discard port of IP address\n");
+        return OK;
+    }
+
+    if (strcmp("csum", args[1]) == 0)
+        return benchChecksum();
+    if (strcmp("addr", args[1]) == 0)
+        return benchAddrFilter();
+    if (strcmp("cache", args[1]) == 0)
+        return benchCache();
+    if (strcmp("bpf", args[1]) == 0)
+        return benchBpf();
+    if (strcmp("fw", args[1]) == 0)
+        return benchFirewall();
+    if (strcmp("udp", args[1]) == 0)
+        return benchUdp((nargs > 2) ? args[2] : NULL);
+    if (strcmp("tcp", args[1]) == 0 && nargs > 2)
+        return benchTcp(args[2], (nargs > 3) ? args[3] : NULL);
+    if (strcmp("txprio", args[1]) == 0 && nargs > 2)
+        return benchTxPrio(args[2]);
+
+    printf("netbench: invalid benchmark\n");
+    return SYSERR;
+}
+
+
+/**
+ * Read the CP0 Count register, which ticks at time_base_freq
+ * @return current Count value
+ */
+ulong benchCycles(void)
+{
+    ulong count;
+
+    asm volatile ("mfc0 %0, $9" : "=r" (count));
+    return count;
+}
+
+
+/**
+ * Print the cost of one operation of a benchmark
+ * @param name  name of the operation
+ * @param len   bytes per operation
+ * @param ticks total Count ticks for all iterations
+ * @param iters number of iterations
+ */
+void benchReport(char *name, int len, ulong ticks, int iters)
+{
+    ulong perOp, mhz;
+
+    perOp = ticks / iters;
+    mhz = platform.time_base_freq / 1000000;
+    if (mhz == 0)
+        mhz = 1;
+
+    printf("  %-22s %5d bytes  %7d ticks  %7d ns\n",
+           name, len, perOp, (perOp * 1000) / mhz);
+}
+
+
+/**
+ * Time checksum(), netChecksum() and csumPartialCopy() over small,
+ * minimum-frame and full-MTU payloads
+ * @return OK for success, SYSERR if the checksums disagree
+ */
+int benchChecksum(void)
+{
+    int lens[] = { IPv4_HDR_LEN, 64, ETH_MTU - IPv4_HDR_LEN };
+    int i, j, len;
+    ulong start, ticks;
+    ushort ref, opt;
+    uchar *src = (uchar *) benchSrc;
+
+    for (i = 0; i < sizeof(benchSrc); i++)
+        src[i] = (uchar) (i * 7 + 3);
+
+    printf("Internet checksum, %d iterations:\n", BENCH_ITERS);
+
+    for (i = 0; i < sizeof(lens) / sizeof(int); i++)
+    {
+        len = lens[i];
+
+        ref = checksum((void *) benchSrc, len);
+        opt = netChecksum((void *) benchSrc, len);
+        if (ref != opt)
+        {
+            printf("netbench: checksum mismatch at %d bytes (%04x != %04x)\n",
+                   len, ref, opt);
+            return SYSERR;
+        }
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+            checksum((void *) benchSrc, len);
+        ticks = benchCycles() - start;
+        benchReport("checksum", len, ticks, BENCH_ITERS);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+            netChecksum((void *) benchSrc, len);
+        ticks = benchCycles() - start;
+        benchReport("netChecksum", len, ticks, BENCH_ITERS);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+        {
+            memcpy((void *) benchDst, (void *) benchSrc, len);
+            checksum((void *) benchDst, len);
+        }
+        ticks = benchCycles() - start;
+        benchReport("memcpy + checksum", len, ticks, BENCH_ITERS);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+            csumPartialCopy((void *) benchDst, (void *) benchSrc, len, 0);
+        ticks = benchCycles() - start;
+        benchReport("csumPartialCopy", len, ticks, BENCH_ITERS);
+    }
+
+    return OK;
+}
+
+
+/**
+ * Time ipRecv's destination filter on a packet for this host, a
+ * broadcast and a packet for another host, comparing the old byte array
+ * loops with single word compares
+ * @return OK for success, SYSERR if the filters disagree
+ */
+int benchAddrFilter(void)
+{
+    char *names[] = { "ours", "broadcast", "other host" };
+    ipaddr dsts[3];
+    uchar ourAddr[IP_ADDR_LEN];
+    struct ipgram *pkt = (struct ipgram *) benchSrc;
+    int i, j, ref, opt;
+    ulong start, ticks;
+
+    IP_STORE(ourAddr, net.ipAddr);
+    dsts[0] = net.ipAddr;
+    dsts[1] = IPv4_ADDR_BCAST;
+
+    // Another host differs from us only in the last octet
+    ourAddr[IP_ADDR_LEN-1] ^= 1;
+    dsts[2] = IP_LOAD(ourAddr);
+    ourAddr[IP_ADDR_LEN-1] ^= 1;
+
+    printf("ipRecv destination filter, %d iterations:\n", BENCH_ITERS);
+
+    for (i = 0; i < 3; i++)
+    {
+        pkt->dst = dsts[i];
+
+        ref = filterBytes((uchar *) &pkt->dst, ourAddr);
+        opt = filterWord(pkt->dst, net.ipAddr);
+        if (ref != opt)
+        {
+            printf("netbench: filter mismatch for %s (%d != %d)\n",
+                   names[i], ref, opt);
+            return SYSERR;
+        }
+
+        printf(" %s:\n", names[i]);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+            filterBytes((uchar *) &pkt->dst, ourAddr);
+        ticks = benchCycles() - start;
+        benchReport("byte loops", IP_ADDR_LEN, ticks, BENCH_ITERS);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_ITERS; j++)
+            filterWord(pkt->dst, net.ipAddr);
+        ticks = benchCycles() - start;
+        benchReport("word compare", IP_ADDR_LEN, ticks, BENCH_ITERS);
+    }
+
+    return OK;
+}
+
+
+/**
+ * ipRecv's destination filter as it was with uchar[4] addresses
+ * @param dst     destination address of the packet
+ * @param ourAddr this host's address
+ * @return 0 to drop, 1 for this host, 2 for broadcast
+ */
+int filterBytes(uchar *dst, uchar *ourAddr)
+{
+    int i;
+
+    if (dst[0] != 0xFF)
+    {
+        for (i = 0; i < IP_ADDR_LEN; i++)
+        {
+            if (dst[i] != ourAddr[i])
+                return 0;
+        }
+        return 1;
+    }
+
+    for (i = 0; i < IP_ADDR_LEN; i++)
+    {
+        if (dst[i] != 0xFF)
+            return 0;
+    }
+    return 2;
+}
+
+
+/**
+ * ipRecv's destination filter with 32-bit addresses
+ * @param dst     destination address of the packet
+ * @param ourAddr this host's address
+ * @return 0 to drop, 1 for this host, 2 for broadcast
+ */
+int filterWord(ipaddr dst, ipaddr ourAddr)
+{
+    if (dst == ourAddr)
+        return 1;
+    if (dst == IPv4_ADDR_BCAST)
+        return 2;
+    return 0;
+}
+
+
+/**
+ * Print the packet rate of a benchmark
+ * @param name  name of the operation
+ * @param ticks total Count ticks for all iterations
+ * @param iters number of packets
+ */
+void benchRate(char *name, ulong ticks, int iters)
+{
+    ulong perOp;
+
+    perOp = ticks / iters;
+    if (perOp == 0)
+        perOp = 1;
+
+    printf("  %-22s %7d ticks/pkt  %7d pkts/s\n",
+           name, perOp, platform.time_base_freq / perOp);
+}
+
+
+/**
+ * Build an IPv4/UDP datagram from ourselves to a local port, as
+ * netDaemon would hand it to ipRecv
+ * @param ip   buffer for the packet, word aligned
+ * @param port destination UDP port
+ * @param len  payload length in bytes
+ */
+void benchUdpBuild(struct ipgram *ip, ushort port, ushort len)
+{
+    struct udpgram *udpP;
+    ushort udpLen;
+    int i;
+
+    udpLen = UDP_HDR_LEN + len;
+    bzero((void *) ip, IPv4_HDR_LEN + UDP_HDR_LEN);
+    ip->ver_ihl = 0x45;
+    ip->len = htons(IPv4_HDR_LEN + udpLen);
+    ip->ttl = IPv4_TTL;
+    ip->proto = IPv4_PROTO_UDP;
+    ip->src = net.ipAddr;
+    ip->dst = net.ipAddr;
+    ip->chksum = netChecksum((void *) ip, IPv4_HDR_LEN);
+
+    udpP = (struct udpgram *) ip->opts;
+    udpP->srcPort = htons(BENCH_UDP_PORT);
+    udpP->dstPort = htons(port);
+    udpP->len = htons(udpLen);
+    for (i = 0; i < len; i++)
+        udpP->data[i] = (uchar) i;
+    udpP->chksum = csumFold(csumPartial((void *) udpP, udpLen,
+                            ipPseudoSum(ip->src, ip->dst,
+                                        IPv4_PROTO_UDP, udpLen)));
+}
+
+
+/**
+ * Time UDP datagrams through the stack. Receive: a datagram for a bound
+ * socket is fed to ipRecv as if netDaemon had read it, then taken off
+ * the socket with udpRecvfrom (copied through the socket's ring) or
+ * udpWaitBuf (copied straight into a posted buffer). Send: datagrams go
+ * to the discard port of dst through udpSendto, ipWrite and the driver.
+ * @param dst dot-decimal address to send to, NULL to skip sending
+ * @return OK for success, SYSERR for syntax error
+ */
+int benchUdp(char *dst)
+{
+    struct ipgram *ip = (struct ipgram *) benchSrc;
+    uchar hwAddr[ETH_ADDR_LEN];
+    ipaddr dstAddr;
+    ulong start, ticks;
+    void *filled;
+    int sd, i, n;
+
+    if (dst != NULL && SYSERR == dot2ip(dst, (uchar *) &dstAddr))
+    {
+        printf("netbench: invalid IP address format, example: 192.168.1.1\n");
+        return SYSERR;
+    }
+
+    bzero(hwAddr, ETH_ADDR_LEN);
+
+    /* Small datagrams, copied through the socket's ring */
+    sd = udpBind(0);
+    if (sd == SYSERR)
+    {
+        printf("netbench: unable to bind a UDP socket\n");
+        return SYSERR;
+    }
+
+    benchUdpBuild(ip, udp.socks[sd].localPort, BENCH_UDP_LEN);
+    printf("UDP, %d byte payloads, %d datagrams:\n", BENCH_UDP_LEN, BENCH_UDP_ITERS);
+
+    start = benchCycles();
+    for (i = 0; i < BENCH_UDP_ITERS; i++)
+    {
+        ipRecv(ip, hwAddr);
+        n = udpRecvfrom(sd, (void *) benchDst, BENCH_UDP_LEN, NULL, NULL, 0);
+        if (n != BENCH_UDP_LEN)
+            break;
+    }
+    ticks = benchCycles() - start;
+    if (i < BENCH_UDP_ITERS)
+    {
+        printf("netbench: datagram %d was not delivered\n", i);
+        udpClose(sd);
+        return SYSERR;
+    }
+    benchRate("ipRecv + udpRecvfrom", ticks, BENCH_UDP_ITERS);
+
+    if (dst != NULL)
+    {
+        start = benchCycles();
+        for (i = 0; i < BENCH_UDP_ITERS; i++)
+            udpSendto(sd, (void *) benchDst, BENCH_UDP_LEN, dstAddr,
+                      BENCH_UDP_PORT, IPv4_TOS_ROUTINE);
+        ticks = benchCycles() - start;
+        benchRate("udpSendto", ticks, BENCH_UDP_ITERS);
+    }
+
+    /* Large datagrams, copied through the socket's ring */
+    benchUdpBuild(ip, udp.socks[sd].localPort, BENCH_UDP_BIG);
+    printf("UDP, %d byte payloads, %d datagrams:\n", BENCH_UDP_BIG, BENCH_UDP_ITERS);
+
+    start = benchCycles();
+    for (i = 0; i < BENCH_UDP_ITERS; i++)
+    {
+        ipRecv(ip, hwAddr);
+        n = udpRecvfrom(sd, (void *) benchDst, BENCH_UDP_BIG, NULL, NULL, 0);
+        if (n != BENCH_UDP_BIG)
+            break;
+    }
+    ticks = benchCycles() - start;
+    udpClose(sd);
+    if (i < BENCH_UDP_ITERS)
+    {
+        printf("netbench: datagram %d was not delivered\n", i);
+        return SYSERR;
+    }
+    benchRate("ipRecv + udpRecvfrom", ticks, BENCH_UDP_ITERS);
+
+    /* Large datagrams, copied straight into a posted buffer */
+    sd = udpBind(0);
+    if (sd == SYSERR)
+    {
+        printf("netbench: unable to bind a UDP socket\n");
+        return SYSERR;
+    }
+    benchUdpBuild(ip, udp.socks[sd].localPort, BENCH_UDP_BIG);
+
+    start = benchCycles();
+    for (i = 0; i < BENCH_UDP_ITERS; i++)
+    {
+        udpPostBuf(sd, (void *) benchDst, BENCH_UDP_BIG);
+        ipRecv(ip, hwAddr);
+        n = udpWaitBuf(sd, &filled, NULL, NULL, 0);
+        if (n != BENCH_UDP_BIG)
+            break;
+    }
+    ticks = benchCycles() - start;
+    udpClose(sd);
+    if (i < BENCH_UDP_ITERS)
+    {
+        printf("netbench: datagram %d was not delivered\n", i);
+        return SYSERR;
+    }
+    benchRate("ipRecv + udpWaitBuf", ticks, BENCH_UDP_ITERS);
+
+    return OK;
+}
+
+
+/**
+ * Time a bulk transfer over TCP: connect to a sink on the host, write
+ * BENCH_TCP_BYTES, and wait until the peer has acknowledged all of it
+ * @param dst  dot-decimal address of the sink
+ * @param port port of the sink, NULL for BENCH_TCP_PORT
+ * @return OK for success, SYSERR for syntax error or a failed transfer
+ */
+int benchTcp(char *dst, char *port)
+{
+    struct tcb *t = NULL;
+    ipaddr dstAddr;
+    ulong start, elapsed, retrans, sent;
+    int sd, n, chunk, pending;
+
+    if (SYSERR == dot2ip(dst, (uchar *) &dstAddr))
+    {
+        printf("netbench: invalid IP address format, example: 192.168.1.1\n");
+        return SYSERR;
+    }
+
+    sd = tcpConnect(dstAddr, (port != NULL) ? atoi(port) : BENCH_TCP_PORT,
+                    BENCH_TCP_WAIT);
+    if (sd < 0)
+    {
+        printf("netbench: unable to connect\n");
+        return SYSERR;
+    }
+    t = &tcp.tcbs[sd];
+
+    for (n = 0; n < sizeof(benchSrc); n++)
+        ((uchar *) benchSrc)[n] = (uchar) n;
+
+    retrans = tcp.retransmits;
+    start = netTime();
+
+    for (sent = 0; sent < BENCH_TCP_BYTES; sent += n)
+    {
+        chunk = sizeof(benchSrc);
+        if (chunk > BENCH_TCP_BYTES - sent)
+            chunk = BENCH_TCP_BYTES - sent;
+        n = tcpWrite(sd, (void *) benchSrc, chunk);
+        if (n <= 0)
+            break;
+    }
+
+    // Wait for the last byte to be acknowledged
+    do
+    {
+        sleep(TCP_TICK);
+        wait(tcp.sema);
+        pending = (t->state == TCP_ESTABLISHED || t->state == TCP_CLOSE_WAIT) ?
+                  t->sndCount : 0;
+        signal(tcp.sema);
+    } while (pending > 0);
+
+    elapsed = netTime() - start;
+    if (elapsed == 0)
+        elapsed = 1;
+
+    printf("TCP, %d bytes to %s:\n", sent, dst);
+    printf("  %7d ms  %7d kbit/s  %d retransmits  rto %d ms  mss %d\n",
+           elapsed, (sent * 8) / elapsed, tcp.retransmits - retrans,
+           t->rto, t->mss);
+
+    tcpClose(sd);
+
+    return (sent == BENCH_TCP_BYTES) ? OK : SYSERR;
+}
+
+
+/**
+ * Time D-cache maintenance plus the header and UDP checksum checks the
+ * stack makes on each received frame. Bursts of frames are written
+ * through KSEG1, as the DMA engine would leave them, into buffers laid
+ * out like the driver's, then parsed and returned: parsed through KSEG1,
+ * parsed in KSEG0 with each whole buffer invalidated as it is returned,
+ * and parsed in KSEG0 with only the lines each frame occupies
+ * invalidated as it is returned.
+ * @return OK for success, SYSERR if a frame was read stale
+ */
+int benchCache(void)
+{
+    char *names[] = { "uncached", "per buffer", "batched" };
+    int lens[] = { BENCH_UDP_LEN, BENCH_UDP_BIG };
+    struct ethPktBuffer *pkts[BENCH_CACHE_BURST];
+    struct ethergram *eg = (struct ethergram *) ((uchar *) benchDst + NET_IP_ALIGN);
+    struct ipgram *ip = (struct ipgram *) benchSrc;
+    struct rxHeader *rxHdr = NULL;
+    uchar *mem = NULL;
+    ulong stride, start, ticks;
+    int i, j, mode, round, frameLen, bad;
+
+    stride = sizeof(struct poolbuf) +
+             roundword(sizeof(struct ethPktBuffer) + ETH_RX_BUF_SIZE);
+    mem = (uchar *) getmem(stride * BENCH_CACHE_BURST);
+    if (mem == (uchar *) SYSERR || mem == NULL)
+    {
+        printf("netbench: out of memory\n");
+        return SYSERR;
+    }
+
+    for (i = 0; i < BENCH_CACHE_BURST; i++)
+    {
+        pkts[i] = (struct ethPktBuffer *) (mem + i * stride +
+                                           sizeof(struct poolbuf));
+        pkts[i]->buf = (uchar *) (pkts[i] + 1);
+        pkts[i]->data = pkts[i]->buf + sizeof(struct rxHeader) + NET_IP_ALIGN;
+        pkts[i]->length = ETH_RX_BUF_SIZE;
+    }
+    // Nothing of the heap's last use may be left dirty over the buffers
+    dcacheWriteback((void *) mem, stride * BENCH_CACHE_BURST);
+
+    bzero((void *) eg, ETHER_SIZE);
+    eg->type = htons(ETYPE_IPv4);
+    bad = 0;
+
+    for (i = 0; i < sizeof(lens) / sizeof(int) && !bad; i++)
+    {
+        frameLen = ETHER_SIZE + IPv4_HDR_LEN + UDP_HDR_LEN + lens[i];
+        printf("D-cache maintenance + parse, %d byte frames, bursts of %d:\n",
+               frameLen, BENCH_CACHE_BURST);
+
+        for (mode = DCACHE_UNCACHED; mode <= DCACHE_BATCHED && !bad; mode++)
+        {
+            ticks = 0;
+            for (round = 0; round < BENCH_CACHE_ROUNDS && !bad; round++)
+            {
+                // A new IP id each round shows up a frame read stale
+                benchUdpBuild(ip, BENCH_UDP_PORT, lens[i]);
+                ip->id = htons(round);
+                ip->chksum = 0;
+                ip->chksum = netChecksum((void *) ip, IPv4_HDR_LEN);
+                memcpy((void *) eg->data, (void *) ip, frameLen - ETHER_SIZE);
+
+                for (j = 0; j < BENCH_CACHE_BURST; j++)
+                {
+                    memcpy(dcacheKseg1(pkts[j]->data), (void *) eg, frameLen);
+                    rxHdr = (struct rxHeader *) dcacheKseg1(pkts[j]->buf);
+                    rxHdr->length = frameLen + ETH_CRC_LEN;
+                }
+
+                start = benchCycles();
+                if (mode == DCACHE_UNCACHED)
+                {
+                    for (j = 0; j < BENCH_CACHE_BURST; j++)
+                        bad |= benchCacheStale(dcacheKseg1(pkts[j]->data), round);
+                }
+                else if (mode == DCACHE_PERBUF)
+                {
+                    for (j = 0; j < BENCH_CACHE_BURST; j++)
+                    {
+                        bad |= benchCacheStale((struct ethergram *) pkts[j]->data,
+                                               round);
+                        dcacheInvalidate((void *) pkts[j]->buf, ETH_RX_BUF_SIZE);
+                    }
+                }
+                else
+                {
+                    for (j = 0; j < BENCH_CACHE_BURST; j++)
+                    {
+                        bad |= benchCacheStale((struct ethergram *) pkts[j]->data,
+                                               round);
+                        dcacheInvalidate((void *) pkts[j]->buf,
+                                         (pkts[j]->data - pkts[j]->buf) +
+                                         frameLen + ETH_CRC_LEN);
+                    }
+                }
+                ticks += benchCycles() - start;
+            }
+
+            if (bad)
+                printf("netbench: %s frame read stale\n", names[mode]);
+            else
+                benchRate(names[mode], ticks,
+                          BENCH_CACHE_BURST * BENCH_CACHE_ROUNDS);
+        }
+    }
+
+    freemem((void *) mem, stride * BENCH_CACHE_BURST);
+
+    return bad ? SYSERR : OK;
+}
+
+
+/**
+ * The checks netDaemon, ipRecv and udpRecv make on a received frame,
+ * without writing to it
+ * @param eg frame to check
+ * @param id IP id the frame should carry
+ * @return TRUE if any of the frame was read stale, FALSE otherwise
+ */
+bool benchCacheStale(struct ethergram *eg, ushort id)
+{
+    struct ipgram *ip = (struct ipgram *) eg->data;
+    struct udpgram *udpP = NULL;
+    ushort udpLen;
+
+    if (etherGetType(eg) != ETYPE_IPv4 || ntohs(ip->id) != id ||
+        netChecksum((void *) ip, IPv4_HDR_LEN) != 0)
+        return TRUE;
+
+    udpP = (struct udpgram *) ip->opts;
+    udpLen = ntohs(udpP->len);
+    if (csumFold(csumPartial((void *) udpP, udpLen,
+                             ipPseudoSum(ip->src, ip->dst,
+                                         IPv4_PROTO_UDP, udpLen))) != 0)
+        return TRUE;
+
+    return FALSE;
+}
+
+
+/**
+ * Measure how long small datagrams wait to reach the TX DMA ring while
+ * bulk routine datagrams keep the link saturated. One run sends the
+ * small ones routine, so they queue behind the bulk ones; the other
+ * sends them as internetwork control, so they jump the queue. Waits are
+ * taken from the histogram of the queue the small datagrams went to;
+ * in the routine run that queue is shared with the bulk datagrams,
+ * which wait just as long.
+ * @param dst dot-decimal address whose discard port gets the datagrams
+ * @return OK for success, SYSERR for syntax error
+ */
+int benchTxPrio(char *dst)
+{
+    ipaddr dstAddr;
+    int sd;
+
+    if (SYSERR == dot2ip(dst, (uchar *) &dstAddr))
+    {
+        printf("netbench: invalid IP address format, example: 192.168.1.1\n");
+        return SYSERR;
+    }
+
+    sd = udpBind(0);
+    if (sd == SYSERR)
+    {
+        printf("netbench: unable to bind a UDP socket\n");
+        return SYSERR;
+    }
+
+    printf("TX queue wait, %d byte datagrams among %d of %d bytes:\n",
+           BENCH_UDP_LEN, BENCH_PRIO_FRAMES, BENCH_UDP_BIG);
+    printf("  %-22s %7s %7s %7s  %7s %7s\n", "small datagrams as",
+           "p50 us", "p99 us", "max us", "sent", "dropped");
+
+    benchTxPrioRun(sd, dstAddr, IPv4_TOS_ROUTINE);
+    benchTxPrioRun(sd, dstAddr, IPv4_TOS_INTCNTRL);
+
+    udpClose(sd);
+
+    return OK;
+}
+
+
+/**
+ * One run of benchTxPrio: saturate the link, then let the queues drain
+ * and print the wait percentiles of the small datagrams' queue
+ * @param sd      bound UDP socket
+ * @param dstAddr destination IPv4 address
+ * @param tos     precedence of the small datagrams
+ */
+void benchTxPrioRun(int sd, ipaddr dstAddr, uchar tos)
+{
+    struct netTxQueue *q = NULL;
+    int i, queue;
+
+    queue = (tos >= IPv4_TOS_INTCNTRL) ? NET_TXQ_HIGH : NET_TXQ_LOW;
+    q = &netTx.queues[queue];
+
+    // Start from empty queues and clean counters
+    sleep(100);
+    netTxClear();
+
+    for (i = 0; i < BENCH_PRIO_FRAMES; i++)
+    {
+        udpSendto(sd, (void *) benchDst, BENCH_UDP_BIG, dstAddr,
+                  BENCH_UDP_PORT, IPv4_TOS_ROUTINE);
+        if (i % BENCH_PRIO_EVERY == 0)
+            udpSendto(sd, (void *) benchDst, BENCH_UDP_LEN, dstAddr,
+                      BENCH_UDP_PORT, tos);
+    }
+
+    // Waits are recorded as frames leave the queue
+    sleep(100);
+
+    printf("  %-22s %7d %7d %7d  %7d %7d\n",
+           (tos >= IPv4_TOS_INTCNTRL) ? "internetwork control" : "routine",
+           netTxLatency(queue, 50), netTxLatency(queue, 99), q->maxWait,
+           q->sent, q->drops);
+}
+
+
+/**
+ * Time the capture filter interpreter: filters tcpdump compiles for
+ * "" (accept all), "arp", "ip host" our address and "tcp port 80", each
+ * over an ARP frame, a UDP datagram and a TCP segment to port 80. Each
+ * filter is also checked to accept just the frames it should.
+ * @return OK for success, SYSERR if a filter gave the wrong answer
+ */
+int benchBpf(void)
+{
+    char *progNames[] = { "accept all", "arp", "ip host", "tcp port 80" };
+    char *frameNames[] = { "ARP", "UDP port 9", "TCP port 80" };
+    struct bpfInsn *insns[] = { benchBpfAll, benchBpfArp, benchBpfHost,
+                                benchBpfTcp };
+    int lens[] = { sizeof(benchBpfAll), sizeof(benchBpfArp),
+                   sizeof(benchBpfHost), sizeof(benchBpfTcp) };
+    // Bit n set if the filter accepts frame n
+    int accepts[] = { 0x7, 0x1, 0x6, 0x4 };
+    struct ethergram *eg = (struct ethergram *) ((uchar *) benchDst + NET_IP_ALIGN);
+    struct bpfProg *prog = NULL;
+    ulong start, ticks, keep = 0;
+    int i, j, frame, frameLen, bad;
+
+    prog = (struct bpfProg *) getmem(sizeof(struct bpfProg));
+    if (prog == (struct bpfProg *) SYSERR || prog == NULL)
+    {
+        printf("netbench: out of memory\n");
+        return SYSERR;
+    }
+
+    benchBpfHost[3].k = ntohl(net.ipAddr);
+    benchBpfHost[5].k = ntohl(net.ipAddr);
+    bad = 0;
+
+    printf("Capture filter, %d iterations:\n", BENCH_ITERS);
+    for (i = 0; i < BENCH_BPF_PROGS && !bad; i++)
+    {
+        if (SYSERR == bpfLoad(prog, insns[i], lens[i] / sizeof(struct bpfInsn)))
+        {
+            printf("netbench: %s rejected by the verifier\n", progNames[i]);
+            bad = 1;
+            break;
+        }
+        printf(" %s, %d instructions:\n", progNames[i], prog->len);
+
+        for (frame = 0; frame < BENCH_BPF_FRAMES; frame++)
+        {
+            frameLen = benchBpfFrame(eg, frame);
+
+            start = benchCycles();
+            for (j = 0; j < BENCH_ITERS; j++)
+                keep = bpfRun(prog, (uchar *) eg, frameLen);
+            ticks = benchCycles() - start;
+            benchReport(frameNames[frame], frameLen, ticks, BENCH_ITERS);
+
+            if ((keep != 0) != ((accepts[i] >> frame) & 1))
+            {
+                printf("netbench: %s %s the %s frame\n", progNames[i],
+                       (keep != 0) ? "accepted" : "rejected", frameNames[frame]);
+                bad = 1;
+            }
+        }
+    }
+
+    freemem((void *) prog, sizeof(struct bpfProg));
+
+    return bad ? SYSERR : OK;
+}
+
+
+/**
+ * Build one of the frames benchBpf filters, from and to ourselves
+ * @param eg    buffer for the frame, aligned as the driver leaves it
+ * @param frame 0 for ARP, 1 for UDP to the discard port, 2 for TCP to
+ *              port 80
+ * @return length of the frame in bytes
+ */
+int benchBpfFrame(struct ethergram *eg, int frame)
+{
+    struct ipgram *ip = (struct ipgram *) eg->data;
+
+    bzero((void *) eg, ETHER_SIZE);
+    if (frame == 0)
+    {
+        eg->type = htons(ETYPE_ARP);
+        bzero((void *) eg->data, ARP_CONST_HDR_LEN + ARP_ADDR_END_OFFSET);
+        return ETHER_SIZE + ARP_CONST_HDR_LEN + ARP_ADDR_END_OFFSET;
+    }
+
+    // A TCP header starts with its ports just as a UDP header does
+    eg->type = htons(ETYPE_IPv4);
+    benchUdpBuild(ip, (frame == 1) ? BENCH_UDP_PORT : 80, BENCH_UDP_LEN);
+    if (frame == 2)
+        ip->proto = IPv4_PROTO_TCP;
+
+    return ETHER_SIZE + IPv4_HDR_LEN + UDP_HDR_LEN + BENCH_UDP_LEN;
+}
+
+
+/**
+ * Time the firewall as its rule set grows from 10 to 1000 rules, for a
+ * datagram no rule matches and one only the last rule matches, with
+ * the lookup fwMatch makes and with a linear scan of the same rules.
+ * Rule i drops UDP from the i-th /24 of 10.0.0.0/8 to port 9 or 53.
+ * The rules are compiled into a private table, so the firewall's own
+ * rules and counters are left alone while it runs.
+ * @return OK for success, SYSERR if out of memory or a lookup gave the
+ *         wrong answer
+ */
+int benchFirewall(void)
+{
+    int sizes[] = { 10, 100, 500, 1000 };
+    struct ipgram *ip = (struct ipgram *) benchSrc;
+    struct fwRule *rules = NULL;
+    struct fwTable *t = NULL;
+    ulong start, ticks, size;
+    int i, j, n, bad, action = 0;
+    ipaddr last;
+
+    n = sizes[BENCH_FW_SIZES - 1];
+    rules = (struct fwRule *) getmem(n * sizeof(struct fwRule));
+    if (rules == (struct fwRule *) SYSERR || rules == NULL)
+    {
+        printf("netbench: out of memory\n");
+        return SYSERR;
+    }
+
+    bzero((void *) rules, n * sizeof(struct fwRule));
+    for (i = 0; i < n; i++)
+    {
+        rules[i].src = htonl(0x0A000000 | (i << 8));
+        rules[i].srcMask = htonl(0xFFFFFF00);
+        rules[i].proto = IPv4_PROTO_UDP;
+        rules[i].sportHi = FW_PORT_MAX;
+        rules[i].dportLo = (i & 1) ? BENCH_UDP_PORT : 53;
+        rules[i].dportHi = rules[i].dportLo;
+        rules[i].action = FW_DROP;
+    }
+
+    printf("Firewall lookup, %d iterations:\n", BENCH_UDP_ITERS);
+    bad = 0;
+
+    for (i = 0; i < BENCH_FW_SIZES && !bad; i++)
+    {
+        n = sizes[i];
+        start = benchCycles();
+        if (SYSERR == fwCompile(rules, n, &t))
+        {
+            printf("netbench: out of memory for %d rules\n", n);
+            bad = 1;
+            break;
+        }
+        ticks = benchCycles() - start;
+        size = t->size;
+        printf(" %d rules, compiled in %d ms to %d bytes:\n", n,
+               ticks / (platform.time_base_freq / 1000), size);
+
+        // From outside 10.0.0.0/8, so no rule matches
+        benchUdpBuild(ip, BENCH_UDP_PORT, BENCH_UDP_LEN);
+        ip->src = htonl(0xAC100001);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_UDP_ITERS; j++)
+            action = benchFwCompiled(t, ip);
+        ticks = benchCycles() - start;
+        benchRate("compiled, no match", ticks, BENCH_UDP_ITERS);
+        bad |= (action != FW_ACCEPT);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_UDP_ITERS; j++)
+            action = benchFwLinear(rules, n, ip);
+        ticks = benchCycles() - start;
+        benchRate("linear, no match", ticks, BENCH_UDP_ITERS);
+        bad |= (action != FW_ACCEPT);
+
+        // From the last rule's prefix, to its port
+        last = rules[n - 1].src | htonl(1);
+        benchUdpBuild(ip, rules[n - 1].dportLo, BENCH_UDP_LEN);
+        ip->src = last;
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_UDP_ITERS; j++)
+            action = benchFwCompiled(t, ip);
+        ticks = benchCycles() - start;
+        benchRate("compiled, last rule", ticks, BENCH_UDP_ITERS);
+        bad |= (action != FW_DROP);
+
+        start = benchCycles();
+        for (j = 0; j < BENCH_UDP_ITERS; j++)
+            action = benchFwLinear(rules, n, ip);
+        ticks = benchCycles() - start;
+        benchRate("linear, last rule", ticks, BENCH_UDP_ITERS);
+        bad |= (action != FW_DROP);
+
+        freemem((void *) t, t->size);
+        t = NULL;
+    }
+
+    if (bad)
+        printf("netbench: a lookup gave the wrong answer\n");
+
+    freemem((void *) rules, sizes[BENCH_FW_SIZES - 1] * sizeof(struct fwRule));
+
+    return bad ? SYSERR : OK;
+}
+
+
+/**
+ * Find a packet's fate in a compiled table as fwMatch does, without
+ * counting it; a packet no rule matches is accepted
+ * @param t  compiled table
+ * @param ip IPv4 packet
+ * @return FW_ACCEPT or FW_DROP
+ */
+int benchFwCompiled(const struct fwTable *t, const struct ipgram *ip)
+{
+    ulong keys[FW_DIMS];
+    int rule;
+
+    fwKeys(ip, keys);
+    rule = fwLookup(t, keys);
+
+    return (rule >= 0) ? t->rules[rule].action : FW_ACCEPT;
+}
+
+
+/**
+ * Find a packet's fate by checking each rule in turn, as fwMatch would
+ * without compiling the rules; a packet no rule matches is accepted
+ * @param rules rules, in match order
+ * @param count count of rules
+ * @param ip    IPv4/UDP packet
+ * @return FW_ACCEPT or FW_DROP
+ */
+int benchFwLinear(const struct fwRule *rules, int count,
+                  const struct ipgram *ip)
+{
+    const struct udpgram *udpP = (const struct udpgram *) ip->opts;
+    ushort sport, dport;
+    int i;
+
+    sport = udpGetSrcPort(udpP);
+    dport = udpGetDstPort(udpP);
+
+    for (i = 0; i < count; i++)
+    {
+        if ((ip->src & rules[i].srcMask) == rules[i].src &&
+            (ip->dst & rules[i].dstMask) == rules[i].dst &&
+            (rules[i].proto == 0 || rules[i].proto == ip->proto) &&
+            sport >= rules[i].sportLo && sport <= rules[i].sportHi &&
+            dport >= rules[i].dportLo && dport <= rules[i].dportHi)
+            return rules[i].action;
+    }
+
+    return FW_ACCEPT;
+}
@@ -0,0 +1,241 @@
+/**
+ * @file     xsh_netstat.c
+ * @provides xsh_netstat
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/11/2016       */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <network.h>
+#include <slab.h>
+#include <dcache.h>
+
+/* Private/helper functions */
+int netPoolPrint(void);
+int netSlabPrint(void);
+int netRxPrint(void);
+int netTxPrint(void);
+
+/* Names of the network buffer pools, indexed by pool */
+static char *netPoolNames[NET_POOLS] = { "rx", "tx", "ctl" };
+
+/* Names of the transmit queues, indexed by queue */
+static char *netTxQueueNames[NET_TXQS] = { "high", "mid", "low" };
+
+/* Names of the D-cache maintenance modes, indexed by mode */
+static char *netCacheModes[] = { "uncached", "per buffer", "batched" };
+
+/**
+ * Shell command to print network stack statistics
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_netstat(int nargs, char *args[])
+{
+    if (nargs < 2)
+    {
+        netPoolPrint();
+        printf("\n");
+        return netSlabPrint();
+    }
+
+    if (strcmp("pools", args[1]) == 0)
+        return netPoolPrint();
+
+    if (strcmp("slabs", args[1]) == 0)
+        return netSlabPrint();
+
+    if (strcmp("rx", args[1]) == 0)
+        return netRxPrint();
+
+    if (strcmp("tx", args[1]) == 0)
+        return netTxPrint();
+
+    // Print helper info about this shell command
+    printf("netstat [pools | slabs | rx | tx]\n");
+    printf("    pools  packet buffer pools: size, use, high-water mark and\n");
+    printf("           requests that found the pool empty\n");
+    printf("    slabs  object caches: object size, slabs taken from the heap,\n");
+    printf("           use, high-water mark, allocations and failures\n");
+    printf("    rx     receive mode, frames taken by interrupt and by polling,\n");
+    printf("           frames dropped by the MAC and ethertype filter and\n");
+    printf("           shed under load, netDaemon rests, and\n");
+    printf("           Rx interrupts per second over the next second\n");
+    printf("    tx     frames sent, completion interrupts asked for and\n");
+    printf("           taken, buffers reclaimed early, Tx interrupts per\n");
+    printf("           second over the next second, and frames sent, dropped\n");
+    printf("           and waiting in each priority queue\n");
+    printf("           NOTE: pools and slabs are displayed if no arguments\n");
+    printf("                 are given\n");
+    return OK;
+}
+
+
+/**
+ * Helper function to print the network buffer pools to the console
+ * @return OK for success, SYSERR for syntax error
+ */
+int netPoolPrint(void)
+{
+    struct netPool pools[NET_POOLS];
+    irqmask im;
+    int i;
+
+    // Take a consistent copy; the counters change under interrupts
+    im = disable();
+    memcpy((void *) pools, (void *) net.pools, sizeof(pools));
+    restore(im);
+
+    printf("Pool  Size  Bufs  In use  High-water  Failed\n");
+    for (i = 0; i < NET_POOLS; i++)
+    {
+        if (pools[i].id == SYSERR)
+        {
+            printf("%-4s  not created\n", netPoolNames[i]);
+            continue;
+        }
+        printf("%-4s  %4d  %4d  %6d  %10d  %6d\n", netPoolNames[i],
+               pools[i].size, pools[i].count, pools[i].inUse,
+               pools[i].highWater, pools[i].fails);
+    }
+
+    return OK;
+}
+
+
+/**
+ * Helper function to print the slab object caches to the console
+ * @return OK for success, SYSERR for syntax error
+ */
+int netSlabPrint(void)
+{
+    struct slabInfo copy;
+    struct slabCache *c = NULL;
+    irqmask im;
+    int i;
+
+    // Take a consistent copy; the counters change under interrupts
+    im = disable();
+    memcpy((void *) &copy, (void *) &slab, sizeof(copy));
+    restore(im);
+
+    printf("Cache      Size  Slabs  Objs  In use  High-water  Allocs  Failed\n");
+    for (i = 0; i < SLAB_MAX_CACHES; i++)
+    {
+        c = &copy.caches[i];
+        if (c->name == NULL)
+            continue;
+        printf("%-9s %5d  %2d/%-2d  %4d  %6d  %10d  %6d  %6d\n", c->name,
+               c->objSize, c->slabs, c->maxSlabs, c->slabs * c->perSlab,
+               c->inUse, c->highWater, c->allocs, c->fails);
+    }
+
+    return OK;
+}
+
+
+/**
+ * Helper function to print receive interrupt and polling counters to the
+ * console. Sleeps a second to measure the interrupt rate.
+ * @return OK for success, SYSERR for syntax error
+ */
+int netRxPrint(void)
+{
+    struct etherPollInfo before, after;
+    struct ether *ethptr = (struct ether *) devtab[ETH0].dvioblk;
+    ulong rxirq;
+    irqmask im;
+
+    im = disable();
+    memcpy((void *) &before, (void *) &ethPoll, sizeof(before));
+    rxirq = ethptr->rxirq;
+    restore(im);
+
+    sleep(1000);
+
+    im = disable();
+    memcpy((void *) &after, (void *) &ethPoll, sizeof(after));
+    rxirq = ethptr->rxirq - rxirq;
+    restore(im);
+
+    if (after.ethptr == NULL)
+        printf("Mode:         interrupt per frame\n");
+    else
+        printf("Mode:         interrupt then poll, %s\n",
+               after.masked ? "polling" : "waiting for interrupt");
+    printf("Rx irqs:      %d total, %d/s\n", ethptr->rxirq, rxirq);
+    printf("Irq frames:   %d\n", after.irqFrames);
+    printf("Polls:        %d, %d frames\n", after.polls, after.polledFrames);
+    printf("Rearms:       %d\n", after.rearms);
+    printf("D-cache:      %s, %d lines invalidated for %d frames\n",
+           netCacheModes[dcache.mode], dcache.rxLines, dcache.rxFrames);
+    printf("Filter:       %d accepted, dropped %d runt, %d other MAC,\n",
+           net.rxAccepted, net.rxDrops[NET_DROP_RUNT],
+           net.rxDrops[NET_DROP_MAC]);
+    printf("              %d multicast, %d ethertype\n",
+           net.rxDrops[NET_DROP_MCAST], net.rxDrops[NET_DROP_ETYPE]);
+    printf("Shed:         %d echo, %d ARP, %d new, %d session\n",
+           net.rxShed[NET_CLASS_ECHO], net.rxShed[NET_CLASS_ARP],
+           net.rxShed[NET_CLASS_NEW], net.rxShed[NET_CLASS_SESSION]);
+    printf("Rests:        %d, input queue %d of %d\n", net.rxRests,
+           ethptr->icount, ETH_IBLEN);
+    printf("Frames/s:     %d by irq, %d by poll\n",
+           after.irqFrames - before.irqFrames,
+           after.polledFrames - before.polledFrames);
+
+    return OK;
+}
+
+
+/**
+ * Helper function to print transmit completion counters to the console.
+ * Sleeps a second to measure the interrupt rate.
+ * @return OK for success, SYSERR for syntax error
+ */
+int netTxPrint(void)
+{
+    struct etherTxInfo before, after;
+    struct netTxQueue *q = NULL;
+    struct ether *ethptr = (struct ether *) devtab[ETH0].dvioblk;
+    ulong txirq;
+    irqmask im;
+    int i;
+
+    im = disable();
+    memcpy((void *) &before, (void *) &ethTx, sizeof(before));
+    txirq = ethptr->txirq;
+    restore(im);
+
+    sleep(1000);
+
+    im = disable();
+    memcpy((void *) &after, (void *) &ethTx, sizeof(after));
+    txirq = ethptr->txirq - txirq;
+    restore(im);
+
+    printf("Frames:       %d posted, %d with IOC\n", after.posted, after.iocs);
+    printf("Tx irqs:      %d total, %d/s\n", ethptr->txirq, txirq);
+    printf("Reclaimed:    %d buffers in %d calls\n", after.reclaimed,
+           after.reclaims);
+    printf("D-cache:      %s, %d lines written back for %d frames\n",
+           netCacheModes[dcache.mode], dcache.txLines, dcache.txFrames);
+    printf("Frames/s:     %d, %d with IOC\n", after.posted - before.posted,
+           after.iocs - before.iocs);
+    printf("Ring limit:   %d frames\n", after.limit);
+
+    printf("\nQueue    Sent  Dropped  Queued  Max  p50 us  p99 us  Max us\n");
+    for (i = 0; i < NET_TXQS; i++)
+    {
+        q = &netTx.queues[i];
+        printf("%-5s %7d  %7d  %6d  %3d  %6d  %6d  %6d\n",
+               netTxQueueNames[i], q->sent, q->drops, q->count, q->maxDepth,
+               netTxLatency(i, 50), netTxLatency(i, 99), q->maxWait);
+    }
+
+    return OK;
+}
@@ -72,15 +72,15 @@ command xsh_ping(int nargs, char *args[])
         for (i = 0; i < ICMP_PINGS; i++)
         {
             // Get time before
-            msBefore = ctr_mS;
+            msBefore = netTime();
             sBefore = clocktime;
             
             // Send an ICMP request to the address we are pinging
             //bytesRecvd = icmpSendRequest(tmp_ipAddr, hwAddr, foundid, i+1);
-            bytesRecvd = icmpSendRequest(tmp_ipAddr, foundid, i+1);
+            bytesRecvd = icmpSendRequest(IP_LOAD(tmp_ipAddr), foundid, i+1);
             
             // Get time after
-            msAfter = ctr_mS;
+            msAfter = netTime();
             sntCnt++;
             if( SYSERR == bytesRecvd)
             {
@@ -95,7 +95,7 @@ command xsh_ping(int nargs, char *args[])
                 
                 wait(icmpTbl[foundid].sema);
                 printf(":  bytes=%d time=%dms TTL=%d (Sent time %d(s), Recvd time %d(s))\n",
-                      bytesRecvd, msBefore - msAfter, icmpTbl[foundid].ttl,
+                      bytesRecvd, msAfter - msBefore, icmpTbl[foundid].ttl,
                       sBefore, icmpTbl[foundid].recvdTime);
                 signal(icmpTbl[foundid].sema);
                 
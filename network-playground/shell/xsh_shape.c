@@ -0,0 +1,107 @@
+/**
+ * @file     xsh_shape.c
+ * @provides xsh_shape
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/14/2016       */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <stdlib.h>
+#include <shape.h>
+
+/* Private/helper functions */
+int shapeTablePrint(void);
+
+/**
+ * Shell command to print and change the traffic shaping rules
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_shape(int nargs, char *args[])
+{
+    ipaddr dst, mask;
+    ulong burst;
+
+    // If the user gave no arguments display the shaping rules
+    if (nargs < 2)
+        return shapeTablePrint();
+
+    if (nargs >= 4 && (OK != dot2ip(args[2], (uchar *) &dst) ||
+                       OK != dot2ip(args[3], (uchar *) &mask)))
+    {
+        printf("shape: invalid IP address format, example: 192.168.1.1\n");
+        return SYSERR;
+    }
+
+    if (strcmp("-a", args[1]) == 0 && (nargs == 5 || nargs == 6))
+    {
+        burst = (nargs == 6) ? atoi(args[5]) : SHAPE_BURST_DEFAULT;
+        if (SYSERR == shapeAdd(dst, mask, atoi(args[4]), burst))
+        {
+            printf("shape: rate must be 1 to %d kbit/s, burst %d to %d bytes,\n",
+                   SHAPE_RATE_MAX, SHAPE_BURST_MIN, SHAPE_BURST_MAX);
+            printf("       and at most %d rules\n", SHAPE_RULES);
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    if (strcmp("-d", args[1]) == 0 && nargs == 4)
+    {
+        if (SYSERR == shapeRemove(dst, mask))
+        {
+            printf("shape: no rule for that prefix\n");
+            return SYSERR;
+        }
+        return OK;
+    }
+
+    // Print helper info about this shell command
+    printf("shape [-a IP mask kbit/s [burst] | -d IP mask]\n");
+    printf("    -a  cap traffic to the prefix at kbit/s, with bursts of up\n");
+    printf("        to burst bytes (default %d); frames over the rate\n",
+           SHAPE_BURST_DEFAULT);
+    printf("        are held back, up to %d per rule\n", SHAPE_QLEN);
+    printf("    -d  stop shaping the prefix\n");
+    printf("           NOTE: shaping rules are displayed if no arguments\n");
+    printf("                 are given\n");
+    return OK;
+}
+
+
+/**
+ * Helper function to print the shaping rules and their counters to the
+ * console
+ * @return OK for success, SYSERR for syntax error
+ */
+int shapeTablePrint(void)
+{
+    struct shapeRule r;
+    irqmask im;
+    int i;
+
+    printf("Prefix           Mask             kbit/s  Burst  Held  Passed  Delayed  Dropped      Bytes\n");
+    for (i = 0; i < SHAPE_RULES; i++)
+    {
+        // Take a consistent copy; the counters change as frames are sent
+        im = disable();
+        memcpy((void *) &r, (void *) &shape.rules[i], sizeof(r));
+        restore(im);
+
+        if (r.rate == 0)
+            continue;
+
+        printf("%3d.%3d.%3d.%3d  %3d.%3d.%3d.%3d  %6d  %5d  %4d  %6d  %7d  %7d  %9d\n",
+               IP_BYTE(r.dst, 0), IP_BYTE(r.dst, 1), IP_BYTE(r.dst, 2),
+               IP_BYTE(r.dst, 3), IP_BYTE(r.mask, 0), IP_BYTE(r.mask, 1),
+               IP_BYTE(r.mask, 2), IP_BYTE(r.mask, 3), r.rate, r.burst / 8,
+               r.count, r.passed, r.delayed, r.dropped, r.bytes);
+    }
+
+    return OK;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file     xsh_traceroute.c
+ * @provides xsh_traceroute
+ *
+ */
+/* Author: Drew Vanderwiel, Jiayi Xin  */
+/* Class:  COSC4300         */
+/* Date:   12/3/2016        */
+
+
+#include <xinu.h>
+#include <string.h>
+#include <icmp.h>
+
+#define TRACE_MAX_HOPS  30
+#define TRACE_TIMEOUT   3000    /* ms to wait for the probes of one hop */
+
+/* Private/helper functions */
+int traceWait(ushort id);
+
+
+/**
+ * Shell command for tracing the route to an IPv4 address. All probes
+ * for a hop are sent at once and their answers are collected together.
+ * @param nargs count of arguments in args
+ * @param args array of arguments
+ * @return OK for success, SYSERR for syntax error
+ */
+command xsh_traceroute(int nargs, char *args[])
+{
+    uchar tmp_ipAddr[IP_ADDR_LEN];
+    ipaddr hopAddr = IPv4_ADDR_ANY;
+    ushort foundid, i, j;
+    int ttl, done, answered;
+    struct icmpProbe *probe;
+
+    if (nargs < 2)
+    {
+        // Print helper info about this shell command
+        printf("traceroute [IP address]\n");
+        return OK;
+    }
+
+    if (SYSERR == dot2ip(args[1], tmp_ipAddr))
+    {
+        printf("traceroute: invalid IP address format, example: 192.168.1.1\n");
+        return SYSERR;
+    }
+
+    foundid = ICMP_TBL_LEN;
+
+    // Find an invalid (free) ICMP table entry
+    for (i = 0; i < ICMP_TBL_LEN; i++)
+    {
+        wait(icmpTbl[i].sema);
+        if(icmpTbl[i].flag == ICMP_ENTRY_INVALID)
+        {
+            foundid = i;
+            icmpTbl[i].flag = ICMP_PROBES_SENT;
+            signal(icmpTbl[i].sema);
+            break;
+        }
+        signal(icmpTbl[i].sema);
+    }
+
+    if (foundid == ICMP_TBL_LEN)
+    {
+        printf("traceroute: internal error\n");
+        return SYSERR;
+    }
+
+    printf("\nTracing route to ");
+    for (j = 0; j < IP_ADDR_LEN-1; j++)
+        printf("%d.", tmp_ipAddr[j]);
+    printf("%d", tmp_ipAddr[IP_ADDR_LEN-1]);
+    printf(" over a maximum of %d hops:\n\n", TRACE_MAX_HOPS);
+
+    done = 0;
+    for (ttl = 1; ttl <= TRACE_MAX_HOPS && !done; ttl++)
+    {
+        // Drop wake ups left over from the previous hop
+        recvclr();
+
+        // Send every probe for this hop before waiting on any of them
+        for (i = 0; i < ICMP_MAX_PROBES; i++)
+            icmpSendProbe(IP_LOAD(tmp_ipAddr), foundid, ttl * ICMP_MAX_PROBES + i, ttl);
+
+        traceWait(foundid);
+
+        // Print the round trip time of each probe
+        printf("%3d", ttl);
+        answered = 0;
+        wait(icmpTbl[foundid].sema);
+        for (i = 0; i < ICMP_MAX_PROBES; i++)
+        {
+            probe = &icmpTbl[foundid].probes[i];
+            if (probe->flag != ICMP_GOT_RPLY)
+            {
+                printf("     *   ");
+                continue;
+            }
+
+            printf("  %4d ms", probe->rtt);
+            if (!answered)
+            {
+                hopAddr = probe->ipAddr;
+                answered = 1;
+            }
+
+            // Stop once the destination answers or reports an error
+            if (probe->type != ICMP_TIMEX_T)
+                done = 1;
+        }
+        signal(icmpTbl[foundid].sema);
+
+        // Print the address of the hop
+        if (answered)
+        {
+            printf("  ");
+            for (j = 0; j < IP_ADDR_LEN-1; j++)
+                printf("%d.", IP_BYTE(hopAddr, j));
+            printf("%d\n", IP_BYTE(hopAddr, IP_ADDR_LEN-1));
+        }
+        else
+        {
+            printf("  Request timed out.\n");
+        }
+    }
+
+    // Free the ICMP table entry
+    wait(icmpTbl[foundid].sema);
+    icmpTbl[foundid].flag = ICMP_ENTRY_INVALID;
+    signal(icmpTbl[foundid].sema);
+
+    printf("\nTrace complete.\n");
+
+    return OK;
+}
+
+
+/**
+ * Wait until every probe of the current hop is answered or the hop
+ * times out. The netDaemon sends a message for each answer it records.
+ * @param id ICMP table entry used for the trace
+ * @return OK when all probes were answered, TIMEOUT otherwise
+ */
+int traceWait(ushort id)
+{
+    int i, pending;
+    ulong start, elapsed;
+
+    start = netTime();
+    while (1)
+    {
+        pending = 0;
+        wait(icmpTbl[id].sema);
+        for (i = 0; i < ICMP_MAX_PROBES; i++)
+        {
+            if (icmpTbl[id].probes[i].flag == ICMP_RQST_SENT)
+                pending++;
+        }
+        signal(icmpTbl[id].sema);
+
+        if (pending == 0)
+            return OK;
+
+        elapsed = netTime() - start;
+        if (elapsed >= TRACE_TIMEOUT)
+            return TIMEOUT;
+
+        recvtime(TRACE_TIMEOUT - elapsed);
+    }
+}